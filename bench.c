@@ -0,0 +1,354 @@
+/*
+ * bench.c
+ *
+ * Throughput of every conversion in conv_rgb_yuv.h for each resolution,
+ * implementation (scalar, SSE4.1, AVX2, threaded) and cache state.
+ */
+
+#define _GNU_SOURCE
+
+#include "conv_rgb_yuv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define read_cycles() __rdtsc()
+#else
+#define read_cycles() 0ull
+#endif
+
+/*
+ * Written between cold-cache runs to evict the frame from every level:
+ * SCRUB_FACTOR times the last-level cache, no less than SCRUB_SIZE.
+ */
+#define SCRUB_FACTOR    4
+#define SCRUB_SIZE      (64 << 20)
+
+/* Every conversion runs through a csc_plan, the swaps on one buffer */
+struct conversion {
+    const char *name;
+    int src, dst;
+    int in_place;
+};
+
+#define CONV(name, src, dst) \
+    { #name, CSC_FORMAT_##src, CSC_FORMAT_##dst, 0 }
+#define SWAP(name, src, dst) \
+    { #name, CSC_FORMAT_##src, CSC_FORMAT_##dst, 1 }
+
+static const struct conversion conversions[] = {
+    CONV(rgb_to_yuv420sp, RGB24, NV12),
+    CONV(bgr_to_yvu420sp, BGR24, NV21),
+    CONV(yuv420sp_to_rgb, NV12, RGB24),
+    CONV(yvu420sp_to_bgr, NV21, BGR24),
+    CONV(rgb_to_yuv420p, RGB24, I420),
+    CONV(bgr_to_yvu420p, BGR24, YV12),
+    CONV(yuv420p_to_rgb, I420, RGB24),
+    CONV(yvu420p_to_bgr, YV12, BGR24),
+    SWAP(convert_yuv420sp_yvu420sp, NV12, NV21),
+    SWAP(convert_rgb_bgr, RGB24, BGR24),
+    SWAP(convert_yuv420p_yvu420p, I420, YV12),
+    CONV(yuv420p_to_yuv420sp, I420, NV12),
+    CONV(yvu420p_to_yvu420sp, YV12, NV21),
+    CONV(yuv420sp_to_yuv420p, NV12, I420),
+    CONV(yvu420sp_to_yvu420p, NV21, YV12),
+    CONV(rgb_to_yvu420sp, RGB24, NV21),
+    CONV(bgr_to_yuv420sp, BGR24, NV12),
+    CONV(rgb_to_yvu420p, RGB24, YV12),
+    CONV(bgr_to_yuv420p, BGR24, I420),
+    CONV(yvu420sp_to_rgb, NV21, RGB24),
+    CONV(yuv420sp_to_bgr, NV12, BGR24),
+    CONV(yvu420p_to_rgb, YV12, RGB24),
+    CONV(yuv420p_to_bgr, I420, BGR24),
+    CONV(yuv420p_to_yvu420sp, I420, NV21),
+    CONV(yvu420p_to_yuv420sp, YV12, NV12),
+    CONV(yuv420sp_to_yvu420p, NV12, YV12),
+    CONV(yvu420sp_to_yuv420p, NV21, I420),
+    CONV(yuv420sp_to_yvu420sp, NV12, NV21),
+    CONV(yvu420sp_to_yuv420sp, NV21, NV12),
+    CONV(yuv420p_to_yvu420p, I420, YV12),
+    CONV(yvu420p_to_yuv420p, YV12, I420),
+    CONV(rgba_to_yuv420sp, RGBA32, NV12),
+    CONV(bgra_to_yuv420p, BGRA32, I420),
+    CONV(yuv420sp_to_rgba, NV12, RGBA32),
+    CONV(yuv420p_to_bgra, I420, BGRA32),
+    CONV(yuyv_to_yuv420sp, YUYV, NV12),
+    CONV(uyvy_to_yuv420p, UYVY, I420),
+    CONV(yuyv_to_rgb, YUYV, RGB24),
+    CONV(p010_to_yuv420sp, P010, NV12),
+    CONV(p010_to_rgb, P010, RGB24),
+    CONV(rgb_to_p010, RGB24, P010),
+    CONV(i010_to_rgb48, I010, RGB48),
+};
+
+static const struct {
+    const char *name;
+    unsigned short width, height;
+} resolutions[] = {
+    { "qcif",   176,  144  },
+    { "cif",    352,  288  },
+    { "vga",    640,  480  },
+    { "720p",   1280, 720  },
+    { "1080p",  1920, 1080 },
+    { "4k",     3840, 2160 },
+    { "8k",     7680, 4320 },
+};
+
+enum variant {
+    VARIANT_SCALAR,
+    VARIANT_SSE41,
+    VARIANT_AVX2,
+    VARIANT_MT,
+};
+
+static const char *variant_names[] = { "scalar", "sse41", "avx2", "mt" };
+
+enum output {
+    OUTPUT_TABLE,
+    OUTPUT_CSV,
+    OUTPUT_JSON,
+};
+
+struct result {
+    double mpix_s, ns_pix, cycles_pix, gb_s;
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned char *scrub;
+static size_t scrub_size;
+
+static size_t llc_scrub_size(void) {
+    long size = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (size <= 0)
+        size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (size <= 0 || (size_t) size * SCRUB_FACTOR < SCRUB_SIZE)
+        return SCRUB_SIZE;
+
+    return (size_t) size * SCRUB_FACTOR;
+}
+
+static void evict_caches(void) {
+    for (size_t i = 0; i < scrub_size; i += 64)
+        scrub[i]++;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return x < y ? -1 : x > y;
+}
+
+/* Median time and TSC cycles of one call, repeated for at least min_time */
+static void measure(const struct conversion *c, csc_ctx *ctx, int cold,
+        unsigned short width, unsigned short height,
+        unsigned char *src, unsigned char *dst,
+        double min_time, struct result *r) {
+    enum { MAX_RUNS = 1000, MIN_RUNS = 3 };
+    static double times[MAX_RUNS], cycles[MAX_RUNS];
+    double total = 0;
+    int n = 0;
+
+    csc_opts opts = { .ctx = ctx };
+    csc_plan *plan = csc_plan_create(c->src, c->dst, width, height, &opts);
+    csc_frame src_frame, dst_frame;
+    size_t src_size = csc_frame_init(&src_frame, c->src, src, width, height);
+    size_t dst_size = csc_frame_init(&dst_frame, c->dst,
+            c->in_place ? src : dst, width, height);
+
+    /* warm up, also faults in the destination pages */
+    csc_plan_execute(plan, &src_frame, &dst_frame);
+
+    while (n < MAX_RUNS && (n < MIN_RUNS || total < min_time)) {
+        if (cold)
+            evict_caches();
+
+        unsigned long long c0 = read_cycles();
+        double t0 = now_seconds();
+        csc_plan_execute(plan, &src_frame, &dst_frame);
+        double t = now_seconds() - t0;
+        cycles[n] = read_cycles() - c0;
+        times[n++] = t;
+        total += t;
+    }
+
+    csc_plan_destroy(plan);
+
+    qsort(times, n, sizeof(double), cmp_double);
+    qsort(cycles, n, sizeof(double), cmp_double);
+
+    double pixels = (double) width * height;
+    double bytes = c->in_place ? 2.0 * src_size : (double) src_size + dst_size;
+    double t = times[n / 2] > 0 ? times[n / 2] : 1e-9;
+
+    r->mpix_s = pixels / t / 1e6;
+    r->ns_pix = t * 1e9 / pixels;
+    r->cycles_pix = cycles[n / 2] / pixels;
+    r->gb_s = bytes / t / 1e9;
+}
+
+static void print_header(enum output output) {
+    if (output == OUTPUT_CSV)
+        printf("conversion,resolution,width,height,variant,threads,cache,"
+                "mpix_s,ns_pix,cycles_pix,gb_s\n");
+    else if (output == OUTPUT_JSON)
+        printf("[\n");
+    else
+        printf("%-26s %-6s %-7s %-5s %10s %8s %10s %8s\n", "conversion",
+                "res", "variant", "cache", "MPixel/s", "ns/pix",
+                "cycles/pix", "GB/s");
+}
+
+static void print_result(enum output output, int first,
+        const struct conversion *c, int res, enum variant v,
+        unsigned int threads, int cold, const struct result *r) {
+    const char *cache = cold ? "cold" : "hot";
+
+    if (output == OUTPUT_CSV)
+        printf("%s,%s,%u,%u,%s,%u,%s,%.2f,%.3f,%.3f,%.3f\n", c->name,
+                resolutions[res].name, resolutions[res].width,
+                resolutions[res].height, variant_names[v], threads, cache,
+                r->mpix_s, r->ns_pix, r->cycles_pix, r->gb_s);
+    else if (output == OUTPUT_JSON)
+        printf("%s  {\"conversion\": \"%s\", \"resolution\": \"%s\", "
+                "\"width\": %u, \"height\": %u, \"variant\": \"%s\", "
+                "\"threads\": %u, \"cache\": \"%s\", \"mpix_s\": %.2f, "
+                "\"ns_pix\": %.3f, \"cycles_pix\": %.3f, \"gb_s\": %.3f}",
+                first ? "" : ",\n", c->name, resolutions[res].name,
+                resolutions[res].width, resolutions[res].height,
+                variant_names[v], threads, cache, r->mpix_s, r->ns_pix,
+                r->cycles_pix, r->gb_s);
+    else
+        printf("%-26s %-6s %-7s %-5s %10.2f %8.3f %10.3f %8.3f\n", c->name,
+                resolutions[res].name, variant_names[v], cache, r->mpix_s,
+                r->ns_pix, r->cycles_pix, r->gb_s);
+    fflush(stdout);
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-o table|csv|json] [-c conversion] [-r resolution]\n"
+           "          [-v scalar|sse41|avx2|mt] [-j threads] [-t seconds]\n"
+           "\t-c, -r and -v select by substring and may be given once each,\n"
+           "\t-j sets the threads of the mt variant (default: online CPUs),\n"
+           "\t-t is the minimum time per case (default: 0.1).\n"
+           "cycles/pix counts TSC ticks on x86 and is 0 elsewhere.\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    enum output output = OUTPUT_TABLE;
+    const char *conv_filter = "", *res_filter = "", *variant_filter = "";
+    unsigned int threads = 0;
+    double min_time = 0.1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        const char *arg = argv[++i];
+        switch (argv[i - 1][1]) {
+        case 'o':
+            if (strcmp(arg, "csv") == 0)
+                output = OUTPUT_CSV;
+            else if (strcmp(arg, "json") == 0)
+                output = OUTPUT_JSON;
+            else
+                output = OUTPUT_TABLE;
+            break;
+        case 'c':
+            conv_filter = arg;
+            break;
+        case 'r':
+            res_filter = arg;
+            break;
+        case 'v':
+            variant_filter = arg;
+            break;
+        case 'j':
+            threads = atoi(arg);
+            break;
+        case 't':
+            min_time = atof(arg);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t max_size = (size_t) 7680 * 4320 * 6;   /* RGB48 */
+    unsigned char *src = (unsigned char *) malloc(max_size);
+    unsigned char *dst = (unsigned char *) malloc(max_size);
+    scrub_size = llc_scrub_size();
+    scrub = (unsigned char *) calloc(1, scrub_size);
+    csc_ctx *ctx = csc_ctx_create(threads);
+    if (src == NULL || dst == NULL || scrub == NULL || ctx == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    srand(1);
+    for (size_t i = 0; i < max_size; ++i)
+        src[i] = rand();
+
+    int best = csc_get_simd_level();
+    int first = 1;
+    print_header(output);
+
+    for (size_t c = 0; c < sizeof(conversions) / sizeof(conversions[0]); ++c) {
+        if (strstr(conversions[c].name, conv_filter) == NULL)
+            continue;
+
+        for (size_t res = 0;
+                res < sizeof(resolutions) / sizeof(resolutions[0]); ++res) {
+            if (strstr(resolutions[res].name, res_filter) == NULL)
+                continue;
+
+            for (int v = VARIANT_SCALAR; v <= VARIANT_MT; ++v) {
+                if (strstr(variant_names[v], variant_filter) == NULL)
+                    continue;
+
+                int level = v == VARIANT_SCALAR ? CSC_SIMD_NONE :
+                        v == VARIANT_SSE41 ? CSC_SIMD_SSE41 :
+                        v == VARIANT_AVX2 ? CSC_SIMD_AVX2 : best;
+                if (v != VARIANT_MT && level > best)
+                    continue;
+                csc_set_simd_level(level);
+
+                csc_ctx *run_ctx = v == VARIANT_MT ? ctx : NULL;
+                for (int cold = 0; cold <= 1; ++cold) {
+                    struct result r;
+                    measure(&conversions[c], run_ctx, cold,
+                            resolutions[res].width, resolutions[res].height,
+                            src, dst, min_time, &r);
+                    print_result(output, first, &conversions[c], res, v,
+                            csc_ctx_threads(run_ctx), cold, &r);
+                    first = 0;
+                }
+            }
+        }
+    }
+
+    if (output == OUTPUT_JSON)
+        printf("\n]\n");
+
+    csc_set_simd_level(best);
+    csc_ctx_destroy(ctx);
+    free(scrub);
+    free(dst);
+    free(src);
+
+    return EXIT_SUCCESS;
+}
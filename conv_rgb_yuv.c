@@ -6,12 +6,21 @@
  */
 
 #include "conv_rgb_yuv.h"
+#include "conv_rgb_yuv_mt.h"
+#include "conv_rgb_yuv_simd.h"
 
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define CSC_X86 1
+#endif
+
 /*
- * BT.601-6 (NTSC)
+ * BT.601-6 (NTSC), limited range
  *
  * YUV --> RGB
  *      R = (298Y + 411V - 57344)>>8
@@ -21,80 +30,912 @@
  *      Y = ( 66R + 129G +  25B)>>8 + 16
  *      U = (-38R -  74G + 112B)>>8 + 128
  *      V = (112R -  94G -  18B)>>8 + 128
+ *
+ * BT.709 and BT.2020 use the same form with their Kr/Kb weights. Limited
+ * range scales Y to 219 and UV to 224 levels, full range uses all 256 and
+ * drops the +16. Decoder offsets fold in the Y/UV offsets and rounding.
+ */
+
+/* Tables by matrix and range, each for the four packed/chroma orders */
+enum {
+    ORDER_RGB_UV,
+    ORDER_BGR_VU,
+    ORDER_RGB_VU,
+    ORDER_BGR_UV,
+};
+
+#define ENC_COEFS(yr, yg, yb, ur, ug, ub, vr, vg, vb, y_off) { \
+    { { yr, yg, yb }, { { ur, ug, ub }, { vr, vg, vb } }, y_off }, \
+    { { yb, yg, yr }, { { vb, vg, vr }, { ub, ug, ur } }, y_off }, \
+    { { yr, yg, yb }, { { vr, vg, vb }, { ur, ug, ub } }, y_off }, \
+    { { yb, yg, yr }, { { ub, ug, ur }, { vb, vg, vr } }, y_off }, \
+}
+
+static const struct csc_enc_coefs enc_coefs[3][2][4] = {
+    [CSC_MATRIX_BT601] = {
+        [CSC_RANGE_LIMITED] = ENC_COEFS(66, 129, 25,
+                -38, -74, 112, 112, -94, -18, 16),
+        [CSC_RANGE_FULL]    = ENC_COEFS(77, 150, 29,
+                -43, -85, 128, 128, -107, -21, 0),
+    },
+    [CSC_MATRIX_BT709] = {
+        [CSC_RANGE_LIMITED] = ENC_COEFS(47, 157, 16,
+                -26, -86, 112, 112, -102, -10, 16),
+        [CSC_RANGE_FULL]    = ENC_COEFS(54, 184, 18,
+                -29, -99, 128, 128, -116, -12, 0),
+    },
+    [CSC_MATRIX_BT2020] = {
+        [CSC_RANGE_LIMITED] = ENC_COEFS(58, 149, 13,
+                -31, -81, 112, 112, -103, -9, 16),
+        [CSC_RANGE_FULL]    = ENC_COEFS(67, 174, 15,
+                -36, -92, 128, 128, -118, -10, 0),
+    },
+};
+
+/* U and V weights for R, G, B, then the R, G, B offsets */
+#define DEC_COEFS(ky, ur, ug, ub, vr, vg, vb, or, og, ob) { \
+    { ky, { { ur, ug, ub }, { vr, vg, vb } }, { or, og, ob } }, \
+    { ky, { { vb, vg, vr }, { ub, ug, ur } }, { ob, og, or } }, \
+    { ky, { { vr, vg, vb }, { ur, ug, ub } }, { or, og, ob } }, \
+    { ky, { { ub, ug, ur }, { vb, vg, vr } }, { ob, og, or } }, \
+}
+
+static const struct csc_dec_coefs dec_coefs[3][2][4] = {
+    [CSC_MATRIX_BT601] = {
+        [CSC_RANGE_LIMITED] = DEC_COEFS(298, 0, -101, 519, 411, -211, 0,
+                -57344, 34739, -71117),
+        [CSC_RANGE_FULL]    = DEC_COEFS(256, 0, -88, 454, 359, -183, 0,
+                -45824, 34816, -57984),
+    },
+    [CSC_MATRIX_BT709] = {
+        [CSC_RANGE_LIMITED] = DEC_COEFS(298, 0, -55, 541, 459, -136, 0,
+                -63392, 19808, -73888),
+        [CSC_RANGE_FULL]    = DEC_COEFS(256, 0, -48, 475, 403, -120, 0,
+                -51456, 21632, -60672),
+    },
+    [CSC_MATRIX_BT2020] = {
+        [CSC_RANGE_LIMITED] = DEC_COEFS(298, 0, -48, 548, 430, -167, 0,
+                -59680, 22880, -74784),
+        [CSC_RANGE_FULL]    = DEC_COEFS(256, 0, -42, 482, 377, -146, 0,
+                -48128, 24192, -61568),
+    },
+};
+
+/* -1 until first used, any thread may set it while others convert */
+static atomic_int simd_level = -1;
+
+/* cpuid based, __builtin_cpu_supports also checks the OS saves YMM state */
+static int detect_simd_level(void) {
+#ifdef CSC_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return CSC_SIMD_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return CSC_SIMD_SSE41;
+#endif
+    return CSC_SIMD_NONE;
+}
+
+int csc_get_simd_level(void) {
+    int level = atomic_load_explicit(&simd_level, memory_order_relaxed);
+    if (level >= 0)
+        return level;
+
+    /* a csc_set_simd_level() in the meantime wins over detection */
+    int unset = -1;
+    level = detect_simd_level();
+    if (!atomic_compare_exchange_strong(&simd_level, &unset, level))
+        level = unset;
+
+    return level;
+}
+
+int csc_set_simd_level(int level) {
+    int supported = detect_simd_level();
+    level = level < CSC_SIMD_NONE ? CSC_SIMD_NONE :
+            level > supported ? supported : level;
+    atomic_store(&simd_level, level);
+
+    return level;
+}
+
+const struct csc_simd_kernels *csc_simd_kernels(void) {
+    switch (csc_get_simd_level()) {
+#ifdef CSC_X86
+    case CSC_SIMD_AVX2:
+        return &csc_simd_kernels_avx2;
+    case CSC_SIMD_SSE41:
+        return &csc_simd_kernels_sse41;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+enum plane_layout {
+    LAYOUT_PACKED,  /* RGB/BGR */
+    LAYOUT_PACKED32, /* RGBA/BGRA/ARGB/ABGR */
+    LAYOUT_SP,      /* Y plane + interleaved chroma plane */
+    LAYOUT_P,       /* Y plane + two chroma planes */
+    LAYOUT_PACKED422, /* YUYV/UYVY */
+    LAYOUT_SP16,    /* P010, 16-bit LAYOUT_SP */
+    LAYOUT_P16,     /* I010, 16-bit LAYOUT_P */
+    LAYOUT_PACKED48, /* RGB48 */
+};
+
+/* Bytes per pixel of the packed layouts, 0 for YUV */
+static unsigned int packed_bpp(enum plane_layout layout) {
+    switch (layout) {
+    case LAYOUT_PACKED:
+        return 3;
+    case LAYOUT_PACKED32:
+        return 4;
+    case LAYOUT_PACKED48:
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+/* Bytes per pixel of the first plane */
+static unsigned int pixel_bytes(enum plane_layout layout) {
+    switch (layout) {
+    case LAYOUT_SP:
+    case LAYOUT_P:
+        return 1;
+    case LAYOUT_PACKED422:
+    case LAYOUT_SP16:
+    case LAYOUT_P16:
+        return 2;
+    default:
+        return packed_bpp(layout);
+    }
+}
+
+/* Planes of a contiguous buffer as laid out by the plain API */
+static void tight_frame(csc_frame *frame, enum plane_layout layout,
+        const unsigned char *buf, size_t width, size_t height) {
+    unsigned char *data = (unsigned char *) buf;
+
+    memset(frame, 0, sizeof(*frame));
+    frame->data[0] = data;
+    switch (layout) {
+    case LAYOUT_PACKED:
+        frame->stride[0] = width * 3;
+        break;
+    case LAYOUT_PACKED32:
+        frame->stride[0] = width * 4;
+        break;
+    case LAYOUT_SP:
+        frame->stride[0] = width;
+        frame->data[1]   = data + width * height;
+        frame->stride[1] = width;
+        break;
+    case LAYOUT_P:
+        frame->stride[0] = width;
+        frame->data[1]   = data + width * height;
+        frame->stride[1] = width / 2;
+        frame->data[2]   = data + width * height * 5 / 4;
+        frame->stride[2] = width / 2;
+        break;
+    case LAYOUT_PACKED422:
+        frame->stride[0] = width * 2;
+        break;
+    case LAYOUT_SP16:
+        frame->stride[0] = width * 2;
+        frame->data[1]   = data + width * height * 2;
+        frame->stride[1] = width * 2;
+        break;
+    case LAYOUT_P16:
+        frame->stride[0] = width * 2;
+        frame->data[1]   = data + width * height * 2;
+        frame->stride[1] = width;
+        frame->data[2]   = data + width * height * 5 / 2;
+        frame->stride[2] = width;
+        break;
+    case LAYOUT_PACKED48:
+        frame->stride[0] = width * 6;
+        break;
+    }
+}
+
+static int frame_valid(const csc_frame *frame, enum plane_layout layout,
+        size_t width) {
+    if (frame == NULL || frame->data[0] == NULL)
+        return 0;
+
+    if (packed_bpp(layout) == 0 &&
+            (frame->matrix < CSC_MATRIX_BT601 ||
+            frame->matrix > CSC_MATRIX_BT2020 ||
+            frame->range < CSC_RANGE_LIMITED ||
+            frame->range > CSC_RANGE_FULL))
+        return 0;
+
+    switch (layout) {
+    case LAYOUT_PACKED:
+        return frame->stride[0] >= width * 3u;
+    case LAYOUT_PACKED32:
+        return frame->stride[0] >= width * 4u;
+    case LAYOUT_SP:
+        return frame->data[1] != NULL &&
+                frame->stride[0] >= width && frame->stride[1] >= width;
+    case LAYOUT_P:
+        return frame->data[1] != NULL && frame->data[2] != NULL &&
+                frame->stride[0] >= width &&
+                frame->stride[1] >= width / 2u &&
+                frame->stride[2] >= width / 2u;
+    case LAYOUT_PACKED422:
+        return frame->stride[0] >= width * 2u;
+    case LAYOUT_SP16:
+        return frame->data[1] != NULL &&
+                frame->stride[0] >= width * 2u &&
+                frame->stride[1] >= width * 2u;
+    case LAYOUT_P16:
+        return frame->data[1] != NULL && frame->data[2] != NULL &&
+                frame->stride[0] >= width * 2u &&
+                frame->stride[1] >= width / 2u * 2 &&
+                frame->stride[2] >= width / 2u * 2;
+    case LAYOUT_PACKED48:
+        return frame->stride[0] >= width * 6u;
+    }
+
+    return 0;
+}
+
+/* frame moved to pixel (x, y), chroma to the sample covering that pixel */
+static csc_frame frame_at(const csc_frame *frame, enum plane_layout layout,
+        unsigned int x, unsigned int y) {
+    csc_frame at = *frame;
+
+    switch (layout) {
+    case LAYOUT_PACKED:
+        at.data[0] += frame->stride[0] * y + x * 3;
+        break;
+    case LAYOUT_PACKED32:
+        at.data[0] += frame->stride[0] * y + x * 4;
+        break;
+    case LAYOUT_SP:
+        at.data[0] += frame->stride[0] * y + x;
+        at.data[1] += frame->stride[1] * (y / 2) + x / 2 * 2;
+        break;
+    case LAYOUT_P:
+        at.data[0] += frame->stride[0] * y + x;
+        at.data[1] += frame->stride[1] * (y / 2) + x / 2;
+        at.data[2] += frame->stride[2] * (y / 2) + x / 2;
+        break;
+    case LAYOUT_PACKED422:
+        at.data[0] += frame->stride[0] * y + x / 2 * 4;
+        break;
+    case LAYOUT_SP16:
+        at.data[0] += frame->stride[0] * y + x * 2;
+        at.data[1] += frame->stride[1] * (y / 2) + x / 2 * 4;
+        break;
+    case LAYOUT_P16:
+        at.data[0] += frame->stride[0] * y + x * 2;
+        at.data[1] += frame->stride[1] * (y / 2) + x / 2 * 2;
+        at.data[2] += frame->stride[2] * (y / 2) + x / 2 * 2;
+        break;
+    case LAYOUT_PACKED48:
+        at.data[0] += frame->stride[0] * y + x * 6;
+        break;
+    }
+
+    return at;
+}
+
+/* Bytes of a contiguous frame, see tight_frame() */
+static size_t frame_size(enum plane_layout layout,
+        size_t width, size_t height) {
+    switch (layout) {
+    case LAYOUT_SP:
+    case LAYOUT_P:
+        return width * height * 3 / 2;
+    case LAYOUT_SP16:
+    case LAYOUT_P16:
+        return width * height * 3;
+    default:
+        return width * height * pixel_bytes(layout);
+    }
+}
+
+#define CACHE_LINE  64
+
+/* Bytes of scratch to set aside for size, so every part is aligned */
+static size_t scratch_lines(size_t size) {
+    return (size + CACHE_LINE - 1) & ~(size_t) (CACHE_LINE - 1);
+}
+
+/*
+ * The size bytes at the top of the job's scratch, the ones below it left
+ * to the row function the job's rows wrap
+ */
+static unsigned char *job_scratch(const struct csc_job *job, size_t size) {
+    return csc_scratch() + job->scratch - size;
+}
+
+/* Ask for rows [h, h + n) of frame ahead of use, without claiming the LLC */
+static void prefetch_rows(const csc_frame *frame, enum plane_layout layout,
+        unsigned int width, unsigned int h, unsigned int n) {
+    size_t row = (size_t) width * pixel_bytes(layout);
+    int interleaved = layout == LAYOUT_SP || layout == LAYOUT_SP16;
+
+    for (unsigned int p = 0; p < 3 && frame->data[p] != NULL; ++p) {
+        unsigned int r0 = p == 0 ? h : h / 2, r1 = p == 0 ? h + n : h / 2 + 1;
+        size_t size = p == 0 || interleaved ? row : row / 2;
+        for (unsigned int r = r0; r < r1; ++r) {
+            const unsigned char *line = frame->data[p] + frame->stride[p] * r;
+            for (size_t x = 0; x < size; x += CACHE_LINE)
+                __builtin_prefetch(line + x, 0, 0);
+        }
+    }
+}
+
+/* The row pair stream_rows() converts into */
+static size_t stream_scratch(enum plane_layout layout, unsigned int width) {
+    return scratch_lines(frame_size(layout, width, 2));
+}
+
+/*
+ * Frames larger than the last-level cache: each row pair is converted
+ * into a scratch buffer that stays in L1 and written out with
+ * non-temporal stores, while the next pair of the source is prefetched,
+ * so neither the output nor the source evicts the working set of other
+ * threads and processes. job->inner does the converting.
+ */
+static void stream_rows(const struct csc_job *job, unsigned int h0,
+        unsigned int h1) {
+    const struct csc_simd_kernels *simd = csc_simd_kernels();
+    enum plane_layout src_layout = job->src_layout;
+    enum plane_layout dst_layout = job->dst_layout;
+    size_t row = (size_t) job->width * pixel_bytes(dst_layout);
+    int interleaved = dst_layout == LAYOUT_SP || dst_layout == LAYOUT_SP16;
+    size_t own = stream_scratch(dst_layout, job->width);
+
+    struct csc_job pair = *job;
+    pair.rows = job->inner;
+    pair.scratch = job->scratch - own;
+    tight_frame(&pair.dst, dst_layout, job_scratch(job, own), job->width, 2);
+
+    for (unsigned int h = h0; h < h1; h += 2) {
+        unsigned int n = h1 - h < 2 ? h1 - h : 2;
+        if (h + 2 < h1)
+            prefetch_rows(&job->src, src_layout, job->width, h + 2,
+                    h1 - h - 2 < 2 ? h1 - h - 2 : 2);
+
+        pair.src = frame_at(&job->src, src_layout, 0, h);
+        pair.height = n;
+        job->inner(&pair, 0, n);
+
+        csc_frame out = frame_at(&job->dst, dst_layout, 0, h);
+        for (unsigned int p = 0; p < 3 && out.data[p] != NULL; ++p) {
+            size_t size = p == 0 || interleaved ? row : row / 2;
+            for (unsigned int r = 0; r < (p == 0 ? n : 1); ++r) {
+                unsigned char *to = out.data[p] + out.stride[p] * r;
+                const unsigned char *from = pair.dst.data[p] +
+                        pair.dst.stride[p] * r;
+                if (simd != NULL)
+                    simd->stream_row(to, from, size);
+                else
+                    memcpy(to, from, size);
+            }
+        }
+    }
+}
+
+/* Stream whole frames that do not fit the cache, unless in place */
+static void stream_job(struct csc_job *job,
+        enum plane_layout src_layout, enum plane_layout dst_layout) {
+    if (job->src.data[0] == job->dst.data[0] ||
+            frame_size(src_layout, job->width, job->height) +
+            frame_size(dst_layout, job->width, job->height) <=
+            csc_cache_size())
+        return;
+
+    job->inner = job->rows;
+    job->rows = stream_rows;
+    job->src_layout = src_layout;
+    job->dst_layout = dst_layout;
+    job->scratch += stream_scratch(dst_layout, job->width);
+}
+
+static void run_tight(csc_ctx *ctx, csc_rows_fn rows,
+        enum plane_layout src_layout, const unsigned char *src,
+        enum plane_layout dst_layout, unsigned char *dst,
+        unsigned int width, unsigned int height) {
+    struct csc_job job = { .rows = rows, .width = width, .height = height };
+    tight_frame(&job.src, src_layout, src, width, height);
+    tight_frame(&job.dst, dst_layout, dst, width, height);
+    csc_run(ctx, &job);
+}
+
+/*
+ * Scratch of the row function from src_layout to dst_layout: the Y and
+ * chroma line of simd_from_422() packed 4:2:2 goes to RGB through
  */
+static size_t rows_scratch(enum plane_layout src_layout,
+        enum plane_layout dst_layout, unsigned int width) {
+    if (src_layout != LAYOUT_PACKED422 || packed_bpp(dst_layout) == 0)
+        return 0;
+
+    return scratch_lines((size_t) width * 2);
+}
+
+static int frames_job(struct csc_job *job, csc_rows_fn rows,
+        enum plane_layout src_layout, const csc_frame *src,
+        enum plane_layout dst_layout, const csc_frame *dst,
+        unsigned int width, unsigned int height) {
+    if (!frame_valid(src, src_layout, width) ||
+            !frame_valid(dst, dst_layout, width))
+        return -1;
+
+    *job = (struct csc_job) { .rows = rows, .src = *src, .dst = *dst,
+            .width = width, .height = height,
+            .scratch = rows_scratch(src_layout, dst_layout, width) };
+
+    return 0;
+}
+
+static int run_frames(csc_ctx *ctx, csc_rows_fn rows,
+        enum plane_layout src_layout, const csc_frame *src,
+        enum plane_layout dst_layout, const csc_frame *dst,
+        unsigned int width, unsigned int height) {
+    struct csc_job job;
+    if (frames_job(&job, rows, src_layout, src, dst_layout, dst,
+            width, height) != 0)
+        return -1;
+
+    return csc_run(ctx, &job);
+}
+
+static void simd_to_yuv420sp(const struct csc_simd_kernels *simd,
+        const struct csc_enc_coefs *k, const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *row = src->data[0] + src->stride[0] * h;
+        unsigned char *y = dst->data[0] + dst->stride[0] * h;
+        simd->enc_sp_row(k, row, y, dst->data[1] + dst->stride[1] * h / 2,
+                job->width);
+        simd->enc_y_row(k, row + src->stride[0], y + dst->stride[0],
+                job->width);
+    }
+}
+
+static void simd_to_yuv420p(const struct csc_simd_kernels *simd,
+        const struct csc_enc_coefs *k, const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *row = src->data[0] + src->stride[0] * h;
+        unsigned char *y = dst->data[0] + dst->stride[0] * h;
+        simd->enc_p_row(k, row, y, dst->data[1] + dst->stride[1] * h / 2,
+                dst->data[2] + dst->stride[2] * h / 2, job->width);
+        simd->enc_y_row(k, row + src->stride[0], y + dst->stride[0],
+                job->width);
+    }
+}
+
+static void simd_from_yuv420sp(const struct csc_simd_kernels *simd,
+        const struct csc_dec_coefs *k, const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *y = src->data[0] + src->stride[0] * h;
+        unsigned char *row = dst->data[0] + dst->stride[0] * h;
+        simd->dec_sp_rows(k, y, y + src->stride[0],
+                src->data[1] + src->stride[1] * h / 2,
+                row, row + dst->stride[0], job->width);
+    }
+}
+
+static void simd_from_yuv420p(const struct csc_simd_kernels *simd,
+        const struct csc_dec_coefs *k, const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *y = src->data[0] + src->stride[0] * h;
+        unsigned char *row = dst->data[0] + dst->stride[0] * h;
+        simd->dec_p_rows(k, y, y + src->stride[0],
+                src->data[1] + src->stride[1] * h / 2,
+                src->data[2] + src->stride[2] * h / 2,
+                row, row + dst->stride[0], job->width);
+    }
+}
+
+static void simd_to_yuv420sp4(const struct csc_simd_kernels *simd,
+        const struct csc_enc_coefs *k, unsigned int first,
+        const struct csc_job *job, unsigned int h0, unsigned int h1) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *row = src->data[0] + src->stride[0] * h;
+        unsigned char *y = dst->data[0] + dst->stride[0] * h;
+        simd->enc_sp_row4(k, first, row, y,
+                dst->data[1] + dst->stride[1] * h / 2, job->width);
+        simd->enc_y_row4(k, first, row + src->stride[0], y + dst->stride[0],
+                job->width);
+    }
+}
+
+static void simd_to_yuv420p4(const struct csc_simd_kernels *simd,
+        const struct csc_enc_coefs *k, unsigned int first,
+        const struct csc_job *job, unsigned int h0, unsigned int h1) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *row = src->data[0] + src->stride[0] * h;
+        unsigned char *y = dst->data[0] + dst->stride[0] * h;
+        simd->enc_p_row4(k, first, row, y,
+                dst->data[1] + dst->stride[1] * h / 2,
+                dst->data[2] + dst->stride[2] * h / 2, job->width);
+        simd->enc_y_row4(k, first, row + src->stride[0], y + dst->stride[0],
+                job->width);
+    }
+}
+
+static void simd_from_yuv420sp4(const struct csc_simd_kernels *simd,
+        const struct csc_dec_coefs *k, unsigned int first,
+        const struct csc_job *job, unsigned int h0, unsigned int h1) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *y = src->data[0] + src->stride[0] * h;
+        unsigned char *row = dst->data[0] + dst->stride[0] * h;
+        simd->dec_sp_rows4(k, first, y, y + src->stride[0],
+                src->data[1] + src->stride[1] * h / 2,
+                row, row + dst->stride[0], job->width);
+    }
+}
+
+static void simd_from_yuv420p4(const struct csc_simd_kernels *simd,
+        const struct csc_dec_coefs *k, unsigned int first,
+        const struct csc_job *job, unsigned int h0, unsigned int h1) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *y = src->data[0] + src->stride[0] * h;
+        unsigned char *row = dst->data[0] + dst->stride[0] * h;
+        simd->dec_p_rows4(k, first, y, y + src->stride[0],
+                src->data[1] + src->stride[1] * h / 2,
+                src->data[2] + src->stride[2] * h / 2,
+                row, row + dst->stride[0], job->width);
+    }
+}
 
 static unsigned int clip_value(int value, int min, int max) {
     return value < min ? min : value > max ? max : value;
 }
 
-static void rgb_to_yuv_pixel(int r, int g, int b,
+static inline void rgb_to_yuv_pixel(const struct csc_enc_coefs *k,
+        int r, int g, int b,
         unsigned char *y, unsigned char *u, unsigned char *v) {
     int shift = 8;
-    int offset0 = 16, offset1 = 128;
-    int c0 = 66, c1 = 129, c2 = 25, c3 = -38, c4 = -74,
-        c5 = 112, c6 = 112, c7 = -94, c8 = -18;
+    int offset1 = 128;
 
-    int y_val = ((c0 * r + c1 * g + c2 * c2) >> shift) + offset0;
+    int y_val = ((k->y[0] * r + k->y[1] * g + k->y[2] * b) >> shift) +
+            k->y_off;
     *y = clip_value(y_val, 0, 255);
 
     if (u != NULL && v != NULL) {
-        int u_val = ((c3 * r + c4 * g + c5 * b) >> shift) + offset1;
-        int v_val = ((c6 * r + c7 * g + c8 * b) >> shift) + offset1;
+        int u_val = ((k->c[0][0] * r + k->c[0][1] * g + k->c[0][2] * b) >>
+                shift) + offset1;
+        int v_val = ((k->c[1][0] * r + k->c[1][1] * g + k->c[1][2] * b) >>
+                shift) + offset1;
         *u = clip_value(u_val, 0, 255);
         *v = clip_value(v_val, 0, 255);
     }
 }
 
-static void yuv_to_rgb_pixel(int y, int u, int v,
+static inline void yuv_to_rgb_pixel(const struct csc_dec_coefs *k,
+        int y, int u, int v,
         unsigned char *r, unsigned char *g, unsigned char *b) {
     int shift = 8;
-    int offset1 = -57344, offset2 = 34739, offset3 = -71117;
-    int c0 = 298, c1 = 411, c2 = -101, c3 = -211, c4 = 519;
 
-    int r_val = (c0 * y + c1 * v + offset1) >> shift;
-    int g_val = (c0 * y + c2 * u + c3 * v + offset2) >> shift;
-    int b_val = (c0 * y + c4 * u + offset3) >> shift;
+    int r_val = (k->y * y + k->c[0][0] * u + k->c[1][0] * v + k->off[0]) >>
+            shift;
+    int g_val = (k->y * y + k->c[0][1] * u + k->c[1][1] * v + k->off[1]) >>
+            shift;
+    int b_val = (k->y * y + k->c[0][2] * u + k->c[1][2] * v + k->off[2]) >>
+            shift;
     *r = clip_value(r_val, 0, 255);
     *g = clip_value(g_val, 0, 255);
     *b = clip_value(b_val, 0, 255);
 }
 
+/*
+ * Scalar 2x2 kernels, specialised per format by the ENC_ROWS/DEC_ROWS
+ * instances below. bpp is 3 or 4 and r, g, b (and a, -1 when there is no
+ * alpha byte to fill) are the byte offsets of the channels in a packed
+ * pixel. For interleaved chroma (planar 0) u and v are the offsets
+ * of the samples within a pair, for planar chroma the plane index. Every
+ * instance passes constants, k included, so neither the layout nor the
+ * matrix costs anything at run time.
+ */
+static inline __attribute__((always_inline)) void enc_rows(
+        const struct csc_job *job, const struct csc_enc_coefs *k,
+        unsigned int h0, unsigned int h1,
+        int bpp, int r, int g, int b, int planar, int u, int v) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    unsigned int width = job->width;
+    size_t cstep = planar ? 1 : 2;
+
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *restrict p0 = src->data[0] + src->stride[0] * h;
+        const unsigned char *restrict p1 = p0 + src->stride[0];
+        unsigned char *restrict y0 = dst->data[0] + dst->stride[0] * h;
+        unsigned char *restrict y1 = y0 + dst->stride[0];
+        unsigned char *restrict u_row, *restrict v_row;
+        if (planar) {
+            u_row = dst->data[u] + dst->stride[u] * h / 2;
+            v_row = dst->data[v] + dst->stride[v] * h / 2;
+        } else {
+            u_row = dst->data[1] + dst->stride[1] * h / 2 + u;
+            v_row = dst->data[1] + dst->stride[1] * h / 2 + v;
+        }
+
+        for (unsigned int w = 0; w < width; w += 2) {
+            const unsigned char *p = p0 + w * bpp;
+            rgb_to_yuv_pixel(k, p[r], p[g], p[b], y0 + w,
+                    u_row + w / 2 * cstep, v_row + w / 2 * cstep);
+            rgb_to_yuv_pixel(k, p[r + bpp], p[g + bpp], p[b + bpp],
+                    y0 + w + 1, NULL, NULL);
+
+            p = p1 + w * bpp;
+            rgb_to_yuv_pixel(k, p[r], p[g], p[b], y1 + w, NULL, NULL);
+            rgb_to_yuv_pixel(k, p[r + bpp], p[g + bpp], p[b + bpp],
+                    y1 + w + 1, NULL, NULL);
+        }
+    }
+}
+
+static inline __attribute__((always_inline)) void dec_rows(
+        const struct csc_job *job, const struct csc_dec_coefs *k,
+        unsigned int h0, unsigned int h1,
+        int bpp, int a, int r, int g, int b, int planar, int u, int v) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    unsigned int width = job->width;
+    size_t cstep = planar ? 1 : 2;
+
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *restrict y0 = src->data[0] + src->stride[0] * h;
+        const unsigned char *restrict y1 = y0 + src->stride[0];
+        const unsigned char *restrict u_row, *restrict v_row;
+        if (planar) {
+            u_row = src->data[u] + src->stride[u] * h / 2;
+            v_row = src->data[v] + src->stride[v] * h / 2;
+        } else {
+            u_row = src->data[1] + src->stride[1] * h / 2 + u;
+            v_row = src->data[1] + src->stride[1] * h / 2 + v;
+        }
+        unsigned char *restrict d0 = dst->data[0] + dst->stride[0] * h;
+        unsigned char *restrict d1 = d0 + dst->stride[0];
+
+        for (unsigned int w = 0; w < width; w += 2) {
+            // 四个像素点共用一个UV
+            int cu = u_row[w / 2 * cstep];
+            int cv = v_row[w / 2 * cstep];
+            unsigned char *d = d0 + w * bpp;
+            yuv_to_rgb_pixel(k, y0[w], cu, cv, d + r, d + g, d + b);
+            yuv_to_rgb_pixel(k, y0[w + 1], cu, cv, d + r + bpp, d + g + bpp,
+                    d + b + bpp);
+            if (a >= 0)
+                d[a] = d[a + bpp] = 255;
+
+            d = d1 + w * bpp;
+            yuv_to_rgb_pixel(k, y1[w], cu, cv, d + r, d + g, d + b);
+            yuv_to_rgb_pixel(k, y1[w + 1], cu, cv, d + r + bpp, d + g + bpp,
+                    d + b + bpp);
+            if (a >= 0)
+                d[a] = d[a + bpp] = 255;
+        }
+    }
+}
+
+/*
+ * One row function per format: SIMD kernels when available, else scalar.
+ * The SIMD kernels take the table in the format's own byte order. The
+ * scalar code is expanded once per matrix and range with the RGB/UV table
+ * and reorders through r, g, b, u and v.
+ */
+#define SCALAR_ROWS(fn, table, frame, job, ...) \
+    switch ((frame).matrix * 2 + (frame).range) { \
+    case 0: fn(job, &table[0][0][ORDER_RGB_UV], __VA_ARGS__); break; \
+    case 1: fn(job, &table[0][1][ORDER_RGB_UV], __VA_ARGS__); break; \
+    case 2: fn(job, &table[1][0][ORDER_RGB_UV], __VA_ARGS__); break; \
+    case 3: fn(job, &table[1][1][ORDER_RGB_UV], __VA_ARGS__); break; \
+    case 4: fn(job, &table[2][0][ORDER_RGB_UV], __VA_ARGS__); break; \
+    case 5: fn(job, &table[2][1][ORDER_RGB_UV], __VA_ARGS__); break; \
+    }
+
+#define ENC_ROWS(name, order, r, g, b, planar, u, v) \
+static void name##_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    const struct csc_enc_coefs *k = \
+            enc_coefs[job->dst.matrix][job->dst.range]; \
+    const struct csc_simd_kernels *simd = csc_simd_kernels(); \
+    if (simd != NULL && planar) \
+        simd_to_yuv420p(simd, &k[order], job, h0, h1); \
+    else if (simd != NULL) \
+        simd_to_yuv420sp(simd, &k[order], job, h0, h1); \
+    else \
+        SCALAR_ROWS(enc_rows, enc_coefs, job->dst, \
+                job, h0, h1, 3, r, g, b, planar, u, v); \
+}
+
+#define DEC_ROWS(name, order, r, g, b, planar, u, v) \
+static void name##_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    const struct csc_dec_coefs *k = \
+            dec_coefs[job->src.matrix][job->src.range]; \
+    const struct csc_simd_kernels *simd = csc_simd_kernels(); \
+    if (simd != NULL && planar) \
+        simd_from_yuv420p(simd, &k[order], job, h0, h1); \
+    else if (simd != NULL) \
+        simd_from_yuv420sp(simd, &k[order], job, h0, h1); \
+    else \
+        SCALAR_ROWS(dec_rows, dec_coefs, job->src, \
+                job, h0, h1, 3, -1, r, g, b, planar, u, v); \
+}
+
+/* 4-byte pixels, the colour bytes at first..first + 2 */
+#define ENC4_ROWS(name, order, first, r, g, b, planar, u, v) \
+static void name##_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    const struct csc_enc_coefs *k = \
+            enc_coefs[job->dst.matrix][job->dst.range]; \
+    const struct csc_simd_kernels *simd = csc_simd_kernels(); \
+    if (simd != NULL && planar) \
+        simd_to_yuv420p4(simd, &k[order], first, job, h0, h1); \
+    else if (simd != NULL) \
+        simd_to_yuv420sp4(simd, &k[order], first, job, h0, h1); \
+    else \
+        SCALAR_ROWS(enc_rows, enc_coefs, job->dst, \
+                job, h0, h1, 4, r, g, b, planar, u, v); \
+}
+
+#define DEC4_ROWS(name, order, first, r, g, b, planar, u, v) \
+static void name##_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    const struct csc_dec_coefs *k = \
+            dec_coefs[job->src.matrix][job->src.range]; \
+    const struct csc_simd_kernels *simd = csc_simd_kernels(); \
+    if (simd != NULL && planar) \
+        simd_from_yuv420p4(simd, &k[order], first, job, h0, h1); \
+    else if (simd != NULL) \
+        simd_from_yuv420sp4(simd, &k[order], first, job, h0, h1); \
+    else \
+        SCALAR_ROWS(dec_rows, dec_coefs, job->src, \
+                job, h0, h1, 4, (first) == 0 ? 3 : 0, r, g, b, \
+                planar, u, v); \
+}
+
+static void convert_rgb_bgr_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    unsigned int row_size = job->width * 3;
+    const struct csc_simd_kernels *simd = csc_simd_kernels();
+
+    for (unsigned int h = h0; h < h1; ++h) {
+        unsigned char *rgb_or_bgr = job->dst.data[0] + job->dst.stride[0] * h;
+        if (simd != NULL) {
+            simd->swap_rgb_row(rgb_or_bgr, job->width);
+            continue;
+        }
+        for (unsigned int i = 0; i < row_size; i += 3) {
+            unsigned char c = *(rgb_or_bgr + i);
+            *(rgb_or_bgr + i) = *(rgb_or_bgr + i + 2);
+            *(rgb_or_bgr + i + 2) = c;
+        }
+    }
+}
+
+unsigned int convert_rgb_bgr_mt(csc_ctx *ctx, unsigned char *rgb_or_bgr,
+        unsigned short width, unsigned short height) {
+    run_tight(ctx, convert_rgb_bgr_rows, LAYOUT_PACKED, rgb_or_bgr,
+            LAYOUT_PACKED, rgb_or_bgr, width, height);
+
+    return width * height * 3;
+}
+
 unsigned int convert_rgb_bgr(unsigned char *rgb_or_bgr,
         unsigned short width, unsigned short height) {
-    unsigned int rgb_size = width * height * 3;
-    for (unsigned int i = 0; i < rgb_size; i += 3) {
-        unsigned char c = *(rgb_or_bgr + i);
-        *(rgb_or_bgr + i) = *(rgb_or_bgr + i + 2);
-        *(rgb_or_bgr + i + 2) = c;
+    return convert_rgb_bgr_mt(NULL, rgb_or_bgr, width, height);
+}
+
+int convert_rgb_bgr_frame(csc_ctx *ctx, const csc_frame *frame,
+        unsigned short width, unsigned short height) {
+    return run_frames(ctx, convert_rgb_bgr_rows, LAYOUT_PACKED, frame,
+            LAYOUT_PACKED, frame, width, height);
+}
+
+static void convert_yuv420sp_yvu420sp_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    unsigned int row_size = job->width;
+    const struct csc_simd_kernels *simd = csc_simd_kernels();
+
+    for (unsigned int h = h0; h < h1; h += 2) {
+        unsigned char *uv = job->dst.data[1] + job->dst.stride[1] * h / 2;
+        if (simd != NULL) {
+            simd->swap_pairs_row(uv, row_size / 2);
+            continue;
+        }
+        for (unsigned int i = 0; i < row_size; i += 2) {
+            unsigned char c = *(uv + i);
+            *(uv + i) = *(uv + i + 1);
+            *(uv + i + 1) = c;
+        }
     }
+}
 
-    return width * height * 3;
+unsigned int convert_yuv420sp_yvu420sp_mt(csc_ctx *ctx,
+        unsigned char *yuv420sp_or_yvu420sp,
+        unsigned short width, unsigned short height) {
+    run_tight(ctx, convert_yuv420sp_yvu420sp_rows,
+            LAYOUT_SP, yuv420sp_or_yvu420sp,
+            LAYOUT_SP, yuv420sp_or_yvu420sp, width, height);
+
+    return width * height * 3 / 2;
 }
 
 unsigned int convert_yuv420sp_yvu420sp(unsigned char *yuv420sp_or_yvu420sp,
         unsigned short width, unsigned short height) {
-    unsigned int y_size = width * height;
-    unsigned int uv_size = width * height / 2;
+    return convert_yuv420sp_yvu420sp_mt(NULL, yuv420sp_or_yvu420sp,
+            width, height);
+}
+
+int convert_yuv420sp_yvu420sp_frame(csc_ctx *ctx, const csc_frame *frame,
+        unsigned short width, unsigned short height) {
+    return run_frames(ctx, convert_yuv420sp_yvu420sp_rows, LAYOUT_SP, frame,
+            LAYOUT_SP, frame, width, height);
+}
+
+static void convert_yuv420p_yvu420p_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    unsigned int row_size = job->width / 2;
+    const struct csc_simd_kernels *simd = csc_simd_kernels();
 
-    for (unsigned int i = 0; i < uv_size; i += 2) {
-        unsigned char c = *(yuv420sp_or_yvu420sp + y_size + i);
-        *(yuv420sp_or_yvu420sp + y_size + i) = *(yuv420sp_or_yvu420sp + y_size + i + 1);
-        *(yuv420sp_or_yvu420sp + y_size + i + 1) = c;
+    for (unsigned int h = h0; h < h1; h += 2) {
+        unsigned char *u = job->dst.data[1] + job->dst.stride[1] * h / 2;
+        unsigned char *v = job->dst.data[2] + job->dst.stride[2] * h / 2;
+        if (simd != NULL) {
+            simd->swap_rows(u, v, row_size);
+            continue;
+        }
+        for (unsigned int i = 0; i < row_size; ++i) {
+            char c = u[i];
+            u[i] = v[i];
+            v[i] = c;
+        }
     }
+}
+
+unsigned int convert_yuv420p_yvu420p_mt(csc_ctx *ctx,
+        unsigned char *yuv420p_or_yvu420p,
+        unsigned short width, unsigned short height) {
+    run_tight(ctx, convert_yuv420p_yvu420p_rows,
+            LAYOUT_P, yuv420p_or_yvu420p,
+            LAYOUT_P, yuv420p_or_yvu420p, width, height);
 
     return width * height * 3 / 2;
 }
 
 unsigned int convert_yuv420p_yvu420p(unsigned char *yuv420p_or_yvu420p,
         unsigned short width, unsigned short height) {
-    unsigned int uv_len = width * height / 4;
-    unsigned char *u = yuv420p_or_yvu420p + width * height;
-    unsigned char *v = yuv420p_or_yvu420p + width * height * 5 / 4;
-    for (unsigned int i = 0; i < uv_len; ++i) {
-        char c = u[i];
-        u[i] = v[i];
-        v[i] = c;
-    }
+    return convert_yuv420p_yvu420p_mt(NULL, yuv420p_or_yvu420p,
+            width, height);
+}
+
+int convert_yuv420p_yvu420p_frame(csc_ctx *ctx, const csc_frame *frame,
+        unsigned short width, unsigned short height) {
+    return run_frames(ctx, convert_yuv420p_yvu420p_rows, LAYOUT_P, frame,
+            LAYOUT_P, frame, width, height);
+}
+
+ENC_ROWS(rgb_to_yuv420sp, ORDER_RGB_UV, 0, 1, 2, 0, 0, 1)
+
+unsigned int rgb_to_yuv420sp_mt(csc_ctx *ctx, const unsigned char *rgb,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size) {
+    if (buf_size < width * height * 3 / 2)
+        return 0;
+
+    run_tight(ctx, rgb_to_yuv420sp_rows, LAYOUT_PACKED, rgb,
+            LAYOUT_SP, yuv420sp_buf, width, height);
 
     return width * height * 3 / 2;
 }
@@ -102,44 +943,25 @@ unsigned int convert_yuv420p_yvu420p(unsigned char *yuv420p_or_yvu420p,
 unsigned int rgb_to_yuv420sp(const unsigned char *rgb,
         unsigned short width, unsigned short height,
         unsigned char *yuv420sp_buf, unsigned int buf_size) {
+    return rgb_to_yuv420sp_mt(NULL, rgb, width, height, yuv420sp_buf, buf_size);
+}
+
+int rgb_to_yuv420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, rgb_to_yuv420sp_rows, LAYOUT_PACKED, src,
+            LAYOUT_SP, dst, width, height);
+}
+
+ENC_ROWS(bgr_to_yvu420sp, ORDER_BGR_VU, 2, 1, 0, 0, 1, 0)
+
+unsigned int bgr_to_yvu420sp_mt(csc_ctx *ctx, const unsigned char *bgr,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size) {
     if (buf_size < width * height * 3 / 2)
         return 0;
 
-    for (unsigned int h = 0; h < height; h += 2) {
-        for (unsigned int w = 0; w < width; w += 2) {
-            unsigned int rgb_offset = (width * h + w) * 3;
-            unsigned int y_offset   = width * h + w;
-            unsigned int uv_offset  = width * height + width * h / 2 + w;
-            int r = *(rgb + rgb_offset);
-            int g = *(rgb + rgb_offset + 1);
-            int b = *(rgb + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b,
-                    yuv420sp_buf + y_offset,
-                    yuv420sp_buf + uv_offset,
-                    yuv420sp_buf + uv_offset + 1);
-
-            rgb_offset  += 3;
-            y_offset    += 1;
-            r = *(rgb + rgb_offset);
-            g = *(rgb + rgb_offset + 1);
-            b = *(rgb + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b, yuv420sp_buf + y_offset, NULL, NULL);
-
-            rgb_offset  = (width * (h + 1) + w) * 3;
-            y_offset    = width * (h + 1) + w;
-            r = *(rgb + rgb_offset);
-            g = *(rgb + rgb_offset + 1);
-            b = *(rgb + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b, yuv420sp_buf + y_offset, NULL, NULL);
-
-            rgb_offset  += 3;
-            y_offset    += 1;
-            r = *(rgb + rgb_offset);
-            g = *(rgb + rgb_offset + 1);
-            b = *(rgb + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b, yuv420sp_buf + y_offset, NULL, NULL);
-        }
-    }
+    run_tight(ctx, bgr_to_yvu420sp_rows, LAYOUT_PACKED, bgr,
+            LAYOUT_SP, yvu420sp_buf, width, height);
 
     return width * height * 3 / 2;
 }
@@ -147,44 +969,25 @@ unsigned int rgb_to_yuv420sp(const unsigned char *rgb,
 unsigned int bgr_to_yvu420sp(const unsigned char *bgr,
         unsigned short width, unsigned short height,
         unsigned char *yvu420sp_buf, unsigned int buf_size) {
+    return bgr_to_yvu420sp_mt(NULL, bgr, width, height, yvu420sp_buf, buf_size);
+}
+
+int bgr_to_yvu420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, bgr_to_yvu420sp_rows, LAYOUT_PACKED, src,
+            LAYOUT_SP, dst, width, height);
+}
+
+ENC_ROWS(rgb_to_yuv420p, ORDER_RGB_UV, 0, 1, 2, 1, 1, 2)
+
+unsigned int rgb_to_yuv420p_mt(csc_ctx *ctx, const unsigned char *rgb,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size) {
     if (buf_size < width * height * 3 / 2)
         return 0;
 
-    for (unsigned int h = 0; h < height; h += 2) {
-        for (unsigned int w = 0; w < width; w += 2) {
-            unsigned int rgb_offset = (width * h + w) * 3;
-            unsigned int y_offset   = width * h + w;
-            unsigned int uv_offset  = width * height + width * h / 2 + w;
-            int b = *(bgr + rgb_offset);
-            int g = *(bgr + rgb_offset + 1);
-            int r = *(bgr + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b,
-                    yvu420sp_buf + y_offset,
-                    yvu420sp_buf + uv_offset + 1,
-                    yvu420sp_buf + uv_offset);
-
-            rgb_offset  += 3;
-            y_offset    += 1;
-            b = *(bgr + rgb_offset);
-            g = *(bgr + rgb_offset + 1);
-            r = *(bgr + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b, yvu420sp_buf + y_offset, NULL, NULL);
-
-            rgb_offset  = (width * (h + 1) + w) * 3;
-            y_offset    = width * (h + 1) + w;
-            b = *(bgr + rgb_offset);
-            g = *(bgr + rgb_offset + 1);
-            r = *(bgr + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b, yvu420sp_buf + y_offset, NULL, NULL);
-
-            rgb_offset  += 3;
-            y_offset    += 1;
-            b = *(bgr + rgb_offset);
-            g = *(bgr + rgb_offset + 1);
-            r = *(bgr + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b, yvu420sp_buf + y_offset, NULL, NULL);
-        }
-    }
+    run_tight(ctx, rgb_to_yuv420p_rows, LAYOUT_PACKED, rgb,
+            LAYOUT_P, yuv420p_buf, width, height);
 
     return width * height * 3 / 2;
 }
@@ -192,45 +995,25 @@ unsigned int bgr_to_yvu420sp(const unsigned char *bgr,
 unsigned int rgb_to_yuv420p(const unsigned char *rgb,
         unsigned short width, unsigned short height,
         unsigned char *yuv420p_buf, unsigned int buf_size) {
+    return rgb_to_yuv420p_mt(NULL, rgb, width, height, yuv420p_buf, buf_size);
+}
+
+int rgb_to_yuv420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, rgb_to_yuv420p_rows, LAYOUT_PACKED, src,
+            LAYOUT_P, dst, width, height);
+}
+
+ENC_ROWS(bgr_to_yvu420p, ORDER_BGR_VU, 2, 1, 0, 1, 2, 1)
+
+unsigned int bgr_to_yvu420p_mt(csc_ctx *ctx, const unsigned char *bgr,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size) {
     if (buf_size < width * height * 3 / 2)
         return 0;
 
-    for (unsigned int h = 0; h < height; h += 2) {
-        for (unsigned int w = 0; w < width; w += 2) {
-            unsigned int rgb_offset = (width * h + w) * 3;
-            unsigned int y_offset   = width * h + w;
-            unsigned int u_offset  = width * height + (width * h / 2 + w) / 2;
-            unsigned int v_offset  = width * height * 5 / 4 + (width * h / 2 + w) / 2;
-            int r = *(rgb + rgb_offset);
-            int g = *(rgb + rgb_offset + 1);
-            int b = *(rgb + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b,
-                    yuv420p_buf + y_offset,
-                    yuv420p_buf + u_offset,
-                    yuv420p_buf + v_offset);
-
-            rgb_offset  += 3;
-            y_offset    += 1;
-            r = *(rgb + rgb_offset);
-            g = *(rgb + rgb_offset + 1);
-            b = *(rgb + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b, yuv420p_buf + y_offset, NULL, NULL);
-
-            rgb_offset  = (width * (h + 1) + w) * 3;
-            y_offset    = width * (h + 1) + w;
-            r = *(rgb + rgb_offset);
-            g = *(rgb + rgb_offset + 1);
-            b = *(rgb + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b, yuv420p_buf + y_offset, NULL, NULL);
-
-            rgb_offset  += 3;
-            y_offset    += 1;
-            r = *(rgb + rgb_offset);
-            g = *(rgb + rgb_offset + 1);
-            b = *(rgb + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b, yuv420p_buf + y_offset, NULL, NULL);
-        }
-    }
+    run_tight(ctx, bgr_to_yvu420p_rows, LAYOUT_PACKED, bgr,
+            LAYOUT_P, yvu420p_buf, width, height);
 
     return width * height * 3 / 2;
 }
@@ -238,319 +1021,3125 @@ unsigned int rgb_to_yuv420p(const unsigned char *rgb,
 unsigned int bgr_to_yvu420p(const unsigned char *bgr,
         unsigned short width, unsigned short height,
         unsigned char *yvu420p_buf, unsigned int buf_size) {
-    if (buf_size < width * height * 3 / 2)
-        return 0;
-
-    for (unsigned int h = 0; h < height; h += 2) {
-        for (unsigned int w = 0; w < width; w += 2) {
-            unsigned int rgb_offset = (width * h + w) * 3;
-            unsigned int y_offset   = width * h + w;
-            unsigned int v_offset   = width * height + (width * h / 2 + w) / 2;
-            unsigned int u_offset   = width * height * 5 / 4 +
-                                      (width * h / 2 + w) / 2;
-            int b = *(bgr + rgb_offset);
-            int g = *(bgr + rgb_offset + 1);
-            int r = *(bgr + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b,
-                    yvu420p_buf + y_offset,
-                    yvu420p_buf + u_offset,
-                    yvu420p_buf + v_offset);
-
-            rgb_offset  += 3;
-            y_offset    += 1;
-            b = *(bgr + rgb_offset);
-            g = *(bgr + rgb_offset + 1);
-            r = *(bgr + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b, yvu420p_buf + y_offset, NULL, NULL);
-
-            rgb_offset  = (width * (h + 1) + w) * 3;
-            y_offset    = width * (h + 1) + w;
-            b = *(bgr + rgb_offset);
-            g = *(bgr + rgb_offset + 1);
-            r = *(bgr + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b, yvu420p_buf + y_offset, NULL, NULL);
-
-            rgb_offset  += 3;
-            y_offset    += 1;
-            b = *(bgr + rgb_offset);
-            g = *(bgr + rgb_offset + 1);
-            r = *(bgr + rgb_offset + 2);
-            rgb_to_yuv_pixel(r, g, b, yvu420p_buf + y_offset, NULL, NULL);
-        }
-    }
+    return bgr_to_yvu420p_mt(NULL, bgr, width, height, yvu420p_buf, buf_size);
+}
 
-    return width * height * 3 / 2;
+int bgr_to_yvu420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, bgr_to_yvu420p_rows, LAYOUT_PACKED, src,
+            LAYOUT_P, dst, width, height);
 }
 
-unsigned int yuv420sp_to_rgb(const unsigned char *yuv420sp,
+DEC_ROWS(yuv420sp_to_rgb, ORDER_RGB_UV, 0, 1, 2, 0, 0, 1)
+
+unsigned int yuv420sp_to_rgb_mt(csc_ctx *ctx, const unsigned char *yuv420sp,
         unsigned short width, unsigned short height,
         unsigned char *rgb_buf, unsigned int buf_size) {
     if (buf_size < width * height * 3)
         return 0;
 
-    for (int h = 0; h < height; h += 2) {
-        for (int w = 0; w < width; w += 2) {
-            // 四个像素点共用一个UV
-            unsigned int uv_offset   = width * height + width * h / 2 + w;
-            int u = yuv420sp[uv_offset];
-            int v = yuv420sp[uv_offset + 1];
-
-            // 1-1
-            unsigned int y_offset    = width * h + w;
-            unsigned int rgb_offset  = (width * h + w) * 3;
-            int y = yuv420sp[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    rgb_buf + rgb_offset,
-                    rgb_buf + rgb_offset + 1,
-                    rgb_buf + rgb_offset + 2);
-
-            // 1-2
-            y_offset    += 1;
-            rgb_offset  += 3;
-            y = yuv420sp[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    rgb_buf + rgb_offset,
-                    rgb_buf + rgb_offset + 1,
-                    rgb_buf + rgb_offset + 2);
-
-            // 2-1
-            y_offset    = width * (h + 1) + w;
-            rgb_offset  = (width * (h + 1) + w) * 3;
-            y = yuv420sp[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    rgb_buf + rgb_offset,
-                    rgb_buf + rgb_offset + 1,
-                    rgb_buf + rgb_offset + 2);
-
-            // 2-2
-            y_offset    += 1;
-            rgb_offset  += 3;
-            y = yuv420sp[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    rgb_buf + rgb_offset,
-                    rgb_buf + rgb_offset + 1,
-                    rgb_buf + rgb_offset + 2);
-        }
-    }
+    run_tight(ctx, yuv420sp_to_rgb_rows, LAYOUT_SP, yuv420sp,
+            LAYOUT_PACKED, rgb_buf, width, height);
 
     return width * height * 3;
 }
 
-unsigned int yvu420sp_to_bgr(const unsigned char *yvu420sp,
+unsigned int yuv420sp_to_rgb(const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *rgb_buf, unsigned int buf_size) {
+    return yuv420sp_to_rgb_mt(NULL, yuv420sp, width, height, rgb_buf, buf_size);
+}
+
+int yuv420sp_to_rgb_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, yuv420sp_to_rgb_rows, LAYOUT_SP, src,
+            LAYOUT_PACKED, dst, width, height);
+}
+
+DEC_ROWS(yvu420sp_to_bgr, ORDER_BGR_VU, 2, 1, 0, 0, 1, 0)
+
+unsigned int yvu420sp_to_bgr_mt(csc_ctx *ctx, const unsigned char *yvu420sp,
         unsigned short width, unsigned short height,
         unsigned char *bgr_buf, unsigned int buf_size) {
     if (buf_size < width * height * 3)
         return 0;
 
-    for (int h = 0; h < height; h += 2) {
-        for (int w = 0; w < width; w += 2) {
-            // 四个像素点共用一个UV
-            unsigned int uv_offset   = width * height + width * h / 2 + w;
-            int v = yvu420sp[uv_offset];
-            int u = yvu420sp[uv_offset + 1];
-
-            // 1-1
-            unsigned int y_offset    = width * h + w;
-            unsigned int rgb_offset  = (width * h + w) * 3;
-            int y = yvu420sp[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    bgr_buf + rgb_offset + 2,
-                    bgr_buf + rgb_offset + 1,
-                    bgr_buf + rgb_offset);
-
-            // 1-2
-            y_offset    += 1;
-            rgb_offset  += 3;
-            y = yvu420sp[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    bgr_buf + rgb_offset + 2,
-                    bgr_buf + rgb_offset + 1,
-                    bgr_buf + rgb_offset);
-
-            // 2-1
-            y_offset    = width * (h + 1) + w;
-            rgb_offset  = (width * (h + 1) + w) * 3;
-            y = yvu420sp[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    bgr_buf + rgb_offset + 2,
-                    bgr_buf + rgb_offset + 1,
-                    bgr_buf + rgb_offset);
-
-            // 2-2
-            y_offset    += 1;
-            rgb_offset  += 3;
-            y = yvu420sp[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    bgr_buf + rgb_offset + 2,
-                    bgr_buf + rgb_offset + 1,
-                    bgr_buf + rgb_offset);
-        }
-    }
+    run_tight(ctx, yvu420sp_to_bgr_rows, LAYOUT_SP, yvu420sp,
+            LAYOUT_PACKED, bgr_buf, width, height);
 
     return width * height * 3;
 }
 
-unsigned int yuv420p_to_rgb(const unsigned char *yuv420p,
+unsigned int yvu420sp_to_bgr(const unsigned char *yvu420sp,
         unsigned short width, unsigned short height,
-        unsigned char *rgb_buf, unsigned int buf_size) {
-    if (buf_size < width * height * 3)
-        return 0;
-
-    for (int h = 0; h < height; h += 2) {
-        for (int w = 0; w < width; w += 2) {
-            // 四个像素点共用一个UV
-            unsigned int uv_offset   = (width * h / 2 + w) / 2;
-            unsigned int u_offset    = width * height + uv_offset;
-            unsigned int v_offset    = width * height * 5 / 4 + uv_offset;
-            int u = yuv420p[u_offset];
-            int v = yuv420p[v_offset];
-
-            // 1-1
-            unsigned y_offset    = width * h + w;
-            unsigned int rgb_offset  = (width * h + w) * 3;
-            int y = yuv420p[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    rgb_buf + rgb_offset,
-                    rgb_buf + rgb_offset + 1,
-                    rgb_buf + rgb_offset + 2);
-
-            // 1-2
-            y_offset    += 1;
-            rgb_offset  += 3;
-            y = yuv420p[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    rgb_buf + rgb_offset,
-                    rgb_buf + rgb_offset + 1,
-                    rgb_buf + rgb_offset + 2);
-
-            // 2-1
-            y_offset    = width * (h + 1) + w;
-            rgb_offset  = (width * (h + 1) + w) * 3;
-            y = yuv420p[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    rgb_buf + rgb_offset,
-                    rgb_buf + rgb_offset + 1,
-                    rgb_buf + rgb_offset + 2);
-
-            // 2-2
-            y_offset    += 1;
-            rgb_offset  += 3;
-            y = yuv420p[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    rgb_buf + rgb_offset,
-                    rgb_buf + rgb_offset + 1,
-                    rgb_buf + rgb_offset + 2);
-        }
-    }
+        unsigned char *bgr_buf, unsigned int buf_size) {
+    return yvu420sp_to_bgr_mt(NULL, yvu420sp, width, height, bgr_buf, buf_size);
+}
+
+int yvu420sp_to_bgr_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, yvu420sp_to_bgr_rows, LAYOUT_SP, src,
+            LAYOUT_PACKED, dst, width, height);
+}
+
+DEC_ROWS(yuv420p_to_rgb, ORDER_RGB_UV, 0, 1, 2, 1, 1, 2)
+
+unsigned int yuv420p_to_rgb_mt(csc_ctx *ctx, const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *rgb_buf, unsigned int buf_size) {
+    if (buf_size < width * height * 3)
+        return 0;
+
+    run_tight(ctx, yuv420p_to_rgb_rows, LAYOUT_P, yuv420p,
+            LAYOUT_PACKED, rgb_buf, width, height);
 
     return width * height * 3;
 }
 
-unsigned int yvu420p_to_bgr(const unsigned char *yvu420p,
+unsigned int yuv420p_to_rgb(const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *rgb_buf, unsigned int buf_size) {
+    return yuv420p_to_rgb_mt(NULL, yuv420p, width, height, rgb_buf, buf_size);
+}
+
+int yuv420p_to_rgb_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, yuv420p_to_rgb_rows, LAYOUT_P, src,
+            LAYOUT_PACKED, dst, width, height);
+}
+
+DEC_ROWS(yvu420p_to_bgr, ORDER_BGR_VU, 2, 1, 0, 1, 2, 1)
+
+unsigned int yvu420p_to_bgr_mt(csc_ctx *ctx, const unsigned char *yvu420p,
         unsigned short width, unsigned short height,
         unsigned char *bgr_buf, unsigned int buf_size) {
     if (buf_size < width * height * 3)
         return 0;
 
-    for (int h = 0; h < height; h += 2) {
-        for (int w = 0; w < width; w += 2) {
-            // 四个像素点共用一个UV
-            unsigned int uv_offset   = (width * h / 2 + w) / 2;
-            unsigned int v_offset    = width * height + uv_offset;
-            unsigned int u_offset    = width * height * 5 / 4 + uv_offset;
-            int v = yvu420p[v_offset];
-            int u = yvu420p[u_offset];
-
-            // 1-1
-            unsigned int y_offset    = width * h + w;
-            unsigned int rgb_offset  = (width * h + w) * 3;
-            int y = yvu420p[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    bgr_buf + rgb_offset + 2,
-                    bgr_buf + rgb_offset + 1,
-                    bgr_buf + rgb_offset);
-
-            // 1-2
-            y_offset    += 1;
-            rgb_offset  += 3;
-            y = yvu420p[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    bgr_buf + rgb_offset + 2,
-                    bgr_buf + rgb_offset + 1,
-                    bgr_buf + rgb_offset);
-
-            // 2-1
-            y_offset    = width * (h + 1) + w;
-            rgb_offset  = (width * (h + 1) + w) * 3;
-            y = yvu420p[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    bgr_buf + rgb_offset + 2,
-                    bgr_buf + rgb_offset + 1,
-                    bgr_buf + rgb_offset);
-
-            // 2-2
-            y_offset    += 1;
-            rgb_offset  += 3;
-            y = yvu420p[y_offset];
-            yuv_to_rgb_pixel(y, u, v,
-                    bgr_buf + rgb_offset + 2,
-                    bgr_buf + rgb_offset + 1,
-                    bgr_buf + rgb_offset);
-        }
-    }
+    run_tight(ctx, yvu420p_to_bgr_rows, LAYOUT_P, yvu420p,
+            LAYOUT_PACKED, bgr_buf, width, height);
 
     return width * height * 3;
 }
 
-unsigned int yuv420p_to_yuv420sp(const unsigned char *yuv420p,
+unsigned int yvu420p_to_bgr(const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *bgr_buf, unsigned int buf_size) {
+    return yvu420p_to_bgr_mt(NULL, yvu420p, width, height, bgr_buf, buf_size);
+}
+
+int yvu420p_to_bgr_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, yvu420p_to_bgr_rows, LAYOUT_P, src,
+            LAYOUT_PACKED, dst, width, height);
+}
+
+ENC_ROWS(rgb_to_yvu420sp, ORDER_RGB_VU, 0, 1, 2, 0, 1, 0)
+
+unsigned int rgb_to_yvu420sp_mt(csc_ctx *ctx, const unsigned char *rgb,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size) {
+    if (buf_size < width * height * 3 / 2)
+        return 0;
+
+    run_tight(ctx, rgb_to_yvu420sp_rows, LAYOUT_PACKED, rgb,
+            LAYOUT_SP, yvu420sp_buf, width, height);
+
+    return width * height * 3 / 2;
+}
+
+unsigned int rgb_to_yvu420sp(const unsigned char *rgb,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size) {
+    return rgb_to_yvu420sp_mt(NULL, rgb, width, height, yvu420sp_buf, buf_size);
+}
+
+int rgb_to_yvu420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, rgb_to_yvu420sp_rows, LAYOUT_PACKED, src,
+            LAYOUT_SP, dst, width, height);
+}
+
+ENC_ROWS(bgr_to_yuv420sp, ORDER_BGR_UV, 2, 1, 0, 0, 0, 1)
+
+unsigned int bgr_to_yuv420sp_mt(csc_ctx *ctx, const unsigned char *bgr,
         unsigned short width, unsigned short height,
         unsigned char *yuv420sp_buf, unsigned int buf_size) {
     if (buf_size < width * height * 3 / 2)
         return 0;
 
-    unsigned int y_size = width * height;
-    memcpy(yuv420sp_buf, yuv420p, y_size);
+    run_tight(ctx, bgr_to_yuv420sp_rows, LAYOUT_PACKED, bgr,
+            LAYOUT_SP, yuv420sp_buf, width, height);
 
-    unsigned int uv_size    = width * height / 2;
-    unsigned int u_offset   = width * height;
-    unsigned int v_offset   = width * height * 5 / 4;
+    return width * height * 3 / 2;
+}
 
-    for (unsigned int i = 0; i < uv_size; i += 2) {
-        yuv420sp_buf[y_size + i]     = yuv420p[u_offset++];
-        yuv420sp_buf[y_size + i + 1] = yuv420p[v_offset++];
-    }
+unsigned int bgr_to_yuv420sp(const unsigned char *bgr,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size) {
+    return bgr_to_yuv420sp_mt(NULL, bgr, width, height, yuv420sp_buf, buf_size);
+}
+
+int bgr_to_yuv420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, bgr_to_yuv420sp_rows, LAYOUT_PACKED, src,
+            LAYOUT_SP, dst, width, height);
+}
+
+ENC_ROWS(rgb_to_yvu420p, ORDER_RGB_VU, 0, 1, 2, 1, 2, 1)
+
+unsigned int rgb_to_yvu420p_mt(csc_ctx *ctx, const unsigned char *rgb,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size) {
+    if (buf_size < width * height * 3 / 2)
+        return 0;
+
+    run_tight(ctx, rgb_to_yvu420p_rows, LAYOUT_PACKED, rgb,
+            LAYOUT_P, yvu420p_buf, width, height);
 
     return width * height * 3 / 2;
 }
 
-unsigned int yuv420sp_to_yuv420p(const unsigned char *yuv420sp,
+unsigned int rgb_to_yvu420p(const unsigned char *rgb,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size) {
+    return rgb_to_yvu420p_mt(NULL, rgb, width, height, yvu420p_buf, buf_size);
+}
+
+int rgb_to_yvu420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, rgb_to_yvu420p_rows, LAYOUT_PACKED, src,
+            LAYOUT_P, dst, width, height);
+}
+
+ENC_ROWS(bgr_to_yuv420p, ORDER_BGR_UV, 2, 1, 0, 1, 1, 2)
+
+unsigned int bgr_to_yuv420p_mt(csc_ctx *ctx, const unsigned char *bgr,
         unsigned short width, unsigned short height,
         unsigned char *yuv420p_buf, unsigned int buf_size) {
     if (buf_size < width * height * 3 / 2)
         return 0;
 
-    unsigned int y_size = width * height;
-    memcpy(yuv420p_buf, yuv420sp, y_size);
+    run_tight(ctx, bgr_to_yuv420p_rows, LAYOUT_PACKED, bgr,
+            LAYOUT_P, yuv420p_buf, width, height);
+
+    return width * height * 3 / 2;
+}
+
+unsigned int bgr_to_yuv420p(const unsigned char *bgr,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size) {
+    return bgr_to_yuv420p_mt(NULL, bgr, width, height, yuv420p_buf, buf_size);
+}
+
+int bgr_to_yuv420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, bgr_to_yuv420p_rows, LAYOUT_PACKED, src,
+            LAYOUT_P, dst, width, height);
+}
+
+DEC_ROWS(yvu420sp_to_rgb, ORDER_RGB_VU, 0, 1, 2, 0, 1, 0)
+
+unsigned int yvu420sp_to_rgb_mt(csc_ctx *ctx, const unsigned char *yvu420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *rgb_buf, unsigned int buf_size) {
+    if (buf_size < width * height * 3)
+        return 0;
+
+    run_tight(ctx, yvu420sp_to_rgb_rows, LAYOUT_SP, yvu420sp,
+            LAYOUT_PACKED, rgb_buf, width, height);
+
+    return width * height * 3;
+}
+
+unsigned int yvu420sp_to_rgb(const unsigned char *yvu420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *rgb_buf, unsigned int buf_size) {
+    return yvu420sp_to_rgb_mt(NULL, yvu420sp, width, height, rgb_buf, buf_size);
+}
+
+int yvu420sp_to_rgb_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, yvu420sp_to_rgb_rows, LAYOUT_SP, src,
+            LAYOUT_PACKED, dst, width, height);
+}
+
+DEC_ROWS(yuv420sp_to_bgr, ORDER_BGR_UV, 2, 1, 0, 0, 0, 1)
+
+unsigned int yuv420sp_to_bgr_mt(csc_ctx *ctx, const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *bgr_buf, unsigned int buf_size) {
+    if (buf_size < width * height * 3)
+        return 0;
+
+    run_tight(ctx, yuv420sp_to_bgr_rows, LAYOUT_SP, yuv420sp,
+            LAYOUT_PACKED, bgr_buf, width, height);
+
+    return width * height * 3;
+}
+
+unsigned int yuv420sp_to_bgr(const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *bgr_buf, unsigned int buf_size) {
+    return yuv420sp_to_bgr_mt(NULL, yuv420sp, width, height, bgr_buf, buf_size);
+}
+
+int yuv420sp_to_bgr_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, yuv420sp_to_bgr_rows, LAYOUT_SP, src,
+            LAYOUT_PACKED, dst, width, height);
+}
+
+DEC_ROWS(yvu420p_to_rgb, ORDER_RGB_VU, 0, 1, 2, 1, 2, 1)
+
+unsigned int yvu420p_to_rgb_mt(csc_ctx *ctx, const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *rgb_buf, unsigned int buf_size) {
+    if (buf_size < width * height * 3)
+        return 0;
+
+    run_tight(ctx, yvu420p_to_rgb_rows, LAYOUT_P, yvu420p,
+            LAYOUT_PACKED, rgb_buf, width, height);
+
+    return width * height * 3;
+}
+
+unsigned int yvu420p_to_rgb(const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *rgb_buf, unsigned int buf_size) {
+    return yvu420p_to_rgb_mt(NULL, yvu420p, width, height, rgb_buf, buf_size);
+}
+
+int yvu420p_to_rgb_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, yvu420p_to_rgb_rows, LAYOUT_P, src,
+            LAYOUT_PACKED, dst, width, height);
+}
+
+DEC_ROWS(yuv420p_to_bgr, ORDER_BGR_UV, 2, 1, 0, 1, 1, 2)
+
+unsigned int yuv420p_to_bgr_mt(csc_ctx *ctx, const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *bgr_buf, unsigned int buf_size) {
+    if (buf_size < width * height * 3)
+        return 0;
+
+    run_tight(ctx, yuv420p_to_bgr_rows, LAYOUT_P, yuv420p,
+            LAYOUT_PACKED, bgr_buf, width, height);
+
+    return width * height * 3;
+}
+
+unsigned int yuv420p_to_bgr(const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *bgr_buf, unsigned int buf_size) {
+    return yuv420p_to_bgr_mt(NULL, yuv420p, width, height, bgr_buf, buf_size);
+}
+
+int yuv420p_to_bgr_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, yuv420p_to_bgr_rows, LAYOUT_P, src,
+            LAYOUT_PACKED, dst, width, height);
+}
+
+static void copy_y_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+
+    for (unsigned int h = h0; h < h1; ++h)
+        memcpy(dst->data[0] + dst->stride[0] * h,
+                src->data[0] + src->stride[0] * h, job->width);
+}
+
+/*
+ * Chroma between the layouts: first and second are the planar planes of
+ * the first and second byte of each interleaved pair, so one instance
+ * also covers the orders with U and V exchanged.
+ */
+static inline __attribute__((always_inline)) void p_to_sp_rows(
+        const struct csc_job *job, unsigned int h0, unsigned int h1,
+        int first, int second) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    unsigned int width = job->width;
+
+    copy_y_rows(job, h0, h1);
+
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *u = src->data[first] +
+                src->stride[first] * h / 2;
+        const unsigned char *v = src->data[second] +
+                src->stride[second] * h / 2;
+        unsigned char *uv = dst->data[1] + dst->stride[1] * h / 2;
+        for (unsigned int i = 0; i < width; i += 2) {
+            uv[i]     = *u++;
+            uv[i + 1] = *v++;
+        }
+    }
+}
+
+static inline __attribute__((always_inline)) void sp_to_p_rows(
+        const struct csc_job *job, unsigned int h0, unsigned int h1,
+        int first, int second) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    unsigned int width = job->width;
+
+    copy_y_rows(job, h0, h1);
 
-    unsigned int uv_size    = width * height / 2;
-    unsigned int u_offset   = width * height;
-    unsigned int v_offset   = width * height * 5 / 4;
-    for (unsigned int i = 0; i < uv_size; i += 2) {
-        yuv420p_buf[u_offset++] = yuv420sp[y_size + i];
-        yuv420p_buf[v_offset++] = yuv420sp[y_size + i + 1];
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *uv = src->data[1] + src->stride[1] * h / 2;
+        unsigned char *u = dst->data[first] + dst->stride[first] * h / 2;
+        unsigned char *v = dst->data[second] + dst->stride[second] * h / 2;
+        for (unsigned int i = 0; i < width; i += 2) {
+            *u++ = uv[i];
+            *v++ = uv[i + 1];
+        }
     }
+}
+
+static void yuv420p_to_yuv420sp_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    p_to_sp_rows(job, h0, h1, 1, 2);
+}
+
+unsigned int yuv420p_to_yuv420sp_mt(csc_ctx *ctx, const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size) {
+    if (buf_size < width * height * 3 / 2)
+        return 0;
+
+    run_tight(ctx, yuv420p_to_yuv420sp_rows, LAYOUT_P, yuv420p,
+            LAYOUT_SP, yuv420sp_buf, width, height);
+
+    return width * height * 3 / 2;
+}
+
+unsigned int yuv420p_to_yuv420sp(const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size) {
+    return yuv420p_to_yuv420sp_mt(NULL, yuv420p, width, height,
+            yuv420sp_buf, buf_size);
+}
+
+int yuv420p_to_yuv420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, yuv420p_to_yuv420sp_rows, LAYOUT_P, src,
+            LAYOUT_SP, dst, width, height);
+}
+
+static void yuv420sp_to_yuv420p_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    sp_to_p_rows(job, h0, h1, 1, 2);
+}
+
+unsigned int yuv420sp_to_yuv420p_mt(csc_ctx *ctx, const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size) {
+    if (buf_size < width * height * 3 / 2)
+        return 0;
+
+    run_tight(ctx, yuv420sp_to_yuv420p_rows, LAYOUT_SP, yuv420sp,
+            LAYOUT_P, yuv420p_buf, width, height);
 
     return width * height * 3 / 2;
 }
 
+unsigned int yuv420sp_to_yuv420p(const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size) {
+    return yuv420sp_to_yuv420p_mt(NULL, yuv420sp, width, height,
+            yuv420p_buf, buf_size);
+}
+
+int yuv420sp_to_yuv420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, yuv420sp_to_yuv420p_rows, LAYOUT_SP, src,
+            LAYOUT_P, dst, width, height);
+}
+
+unsigned int yvu420p_to_yvu420sp_mt(csc_ctx *ctx, const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size) {
+    return yuv420p_to_yuv420sp_mt(ctx, yvu420p, width, height,
+            yvu420sp_buf, buf_size);
+}
+
 unsigned int yvu420p_to_yvu420sp(const unsigned char *yvu420p,
         unsigned short width, unsigned short height,
         unsigned char *yvu420sp_buf, unsigned int buf_size) {
     return yuv420p_to_yuv420sp(yvu420p, width, height, yvu420sp_buf, buf_size);
 }
 
+int yvu420p_to_yvu420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return yuv420p_to_yuv420sp_frame(ctx, src, dst, width, height);
+}
+
+unsigned int yvu420sp_to_yvu420p_mt(csc_ctx *ctx, const unsigned char *yvu420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size) {
+    return yuv420sp_to_yuv420p_mt(ctx, yvu420sp, width, height,
+            yvu420p_buf, buf_size);
+}
+
 unsigned int yvu420sp_to_yvu420p(const unsigned char *yvu420sp,
         unsigned short width, unsigned short height,
         unsigned char *yvu420p_buf, unsigned int buf_size) {
     return yuv420sp_to_yuv420p(yvu420sp, width, height, yvu420p_buf, buf_size);
 }
+
+int yvu420sp_to_yvu420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return yuv420sp_to_yuv420p_frame(ctx, src, dst, width, height);
+}
+
+static void yuv420p_to_yvu420sp_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    p_to_sp_rows(job, h0, h1, 2, 1);
+}
+
+unsigned int yuv420p_to_yvu420sp_mt(csc_ctx *ctx, const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size) {
+    if (buf_size < width * height * 3 / 2)
+        return 0;
+
+    run_tight(ctx, yuv420p_to_yvu420sp_rows, LAYOUT_P, yuv420p,
+            LAYOUT_SP, yvu420sp_buf, width, height);
+
+    return width * height * 3 / 2;
+}
+
+unsigned int yuv420p_to_yvu420sp(const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size) {
+    return yuv420p_to_yvu420sp_mt(NULL, yuv420p, width, height,
+            yvu420sp_buf, buf_size);
+}
+
+int yuv420p_to_yvu420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, yuv420p_to_yvu420sp_rows, LAYOUT_P, src,
+            LAYOUT_SP, dst, width, height);
+}
+
+unsigned int yvu420p_to_yuv420sp_mt(csc_ctx *ctx, const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size) {
+    return yuv420p_to_yvu420sp_mt(ctx, yvu420p, width, height,
+            yuv420sp_buf, buf_size);
+}
+
+unsigned int yvu420p_to_yuv420sp(const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size) {
+    return yuv420p_to_yvu420sp(yvu420p, width, height, yuv420sp_buf, buf_size);
+}
+
+int yvu420p_to_yuv420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return yuv420p_to_yvu420sp_frame(ctx, src, dst, width, height);
+}
+
+static void yuv420sp_to_yvu420p_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    sp_to_p_rows(job, h0, h1, 2, 1);
+}
+
+unsigned int yuv420sp_to_yvu420p_mt(csc_ctx *ctx, const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size) {
+    if (buf_size < width * height * 3 / 2)
+        return 0;
+
+    run_tight(ctx, yuv420sp_to_yvu420p_rows, LAYOUT_SP, yuv420sp,
+            LAYOUT_P, yvu420p_buf, width, height);
+
+    return width * height * 3 / 2;
+}
+
+unsigned int yuv420sp_to_yvu420p(const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size) {
+    return yuv420sp_to_yvu420p_mt(NULL, yuv420sp, width, height,
+            yvu420p_buf, buf_size);
+}
+
+int yuv420sp_to_yvu420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, yuv420sp_to_yvu420p_rows, LAYOUT_SP, src,
+            LAYOUT_P, dst, width, height);
+}
+
+unsigned int yvu420sp_to_yuv420p_mt(csc_ctx *ctx, const unsigned char *yvu420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size) {
+    return yuv420sp_to_yvu420p_mt(ctx, yvu420sp, width, height,
+            yuv420p_buf, buf_size);
+}
+
+unsigned int yvu420sp_to_yuv420p(const unsigned char *yvu420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size) {
+    return yuv420sp_to_yvu420p(yvu420sp, width, height, yuv420p_buf, buf_size);
+}
+
+int yvu420sp_to_yuv420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return yuv420sp_to_yvu420p_frame(ctx, src, dst, width, height);
+}
+
+static void yuv420sp_to_yvu420sp_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    unsigned int width = job->width;
+
+    copy_y_rows(job, h0, h1);
+
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *uv = src->data[1] + src->stride[1] * h / 2;
+        unsigned char *vu = dst->data[1] + dst->stride[1] * h / 2;
+        for (unsigned int i = 0; i < width; i += 2) {
+            vu[i]     = uv[i + 1];
+            vu[i + 1] = uv[i];
+        }
+    }
+}
+
+unsigned int yuv420sp_to_yvu420sp_mt(csc_ctx *ctx,
+        const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size) {
+    if (buf_size < width * height * 3 / 2)
+        return 0;
+
+    run_tight(ctx, yuv420sp_to_yvu420sp_rows, LAYOUT_SP, yuv420sp,
+            LAYOUT_SP, yvu420sp_buf, width, height);
+
+    return width * height * 3 / 2;
+}
+
+unsigned int yuv420sp_to_yvu420sp(const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size) {
+    return yuv420sp_to_yvu420sp_mt(NULL, yuv420sp, width, height,
+            yvu420sp_buf, buf_size);
+}
+
+int yuv420sp_to_yvu420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, yuv420sp_to_yvu420sp_rows, LAYOUT_SP, src,
+            LAYOUT_SP, dst, width, height);
+}
+
+unsigned int yvu420sp_to_yuv420sp_mt(csc_ctx *ctx,
+        const unsigned char *yvu420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size) {
+    return yuv420sp_to_yvu420sp_mt(ctx, yvu420sp, width, height,
+            yuv420sp_buf, buf_size);
+}
+
+unsigned int yvu420sp_to_yuv420sp(const unsigned char *yvu420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size) {
+    return yuv420sp_to_yvu420sp(yvu420sp, width, height,
+            yuv420sp_buf, buf_size);
+}
+
+int yvu420sp_to_yuv420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return yuv420sp_to_yvu420sp_frame(ctx, src, dst, width, height);
+}
+
+static void yuv420p_to_yvu420p_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+
+    copy_y_rows(job, h0, h1);
+
+    for (unsigned int h = h0; h < h1; h += 2)
+        for (int p = 1; p < 3; ++p)
+            memcpy(dst->data[3 - p] + dst->stride[3 - p] * h / 2,
+                    src->data[p] + src->stride[p] * h / 2, job->width / 2);
+}
+
+unsigned int yuv420p_to_yvu420p_mt(csc_ctx *ctx, const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size) {
+    if (buf_size < width * height * 3 / 2)
+        return 0;
+
+    run_tight(ctx, yuv420p_to_yvu420p_rows, LAYOUT_P, yuv420p,
+            LAYOUT_P, yvu420p_buf, width, height);
+
+    return width * height * 3 / 2;
+}
+
+unsigned int yuv420p_to_yvu420p(const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size) {
+    return yuv420p_to_yvu420p_mt(NULL, yuv420p, width, height,
+            yvu420p_buf, buf_size);
+}
+
+int yuv420p_to_yvu420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return run_frames(ctx, yuv420p_to_yvu420p_rows, LAYOUT_P, src,
+            LAYOUT_P, dst, width, height);
+}
+
+unsigned int yvu420p_to_yuv420p_mt(csc_ctx *ctx, const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size) {
+    return yuv420p_to_yvu420p_mt(ctx, yvu420p, width, height,
+            yuv420p_buf, buf_size);
+}
+
+unsigned int yvu420p_to_yuv420p(const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size) {
+    return yuv420p_to_yvu420p(yvu420p, width, height, yuv420p_buf, buf_size);
+}
+
+int yvu420p_to_yuv420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height) {
+    return yuv420p_to_yvu420p_frame(ctx, src, dst, width, height);
+}
+
+/* vertical box sums are taken this many bytes at a time */
+#define BOX_BLOCK   16
+
+/*
+ * Box average rows of count elements of ch interleaved bytes each, from
+ * 1 << shift source rows stride apart. The vertical sums go through acc
+ * in fixed-size blocks so they vectorize, the horizontal pass then walks
+ * acc linearly. shift and ch are constants in every instance.
+ */
+static inline __attribute__((always_inline)) void box_row_n(
+        const unsigned char *restrict src, size_t stride, unsigned int count,
+        size_t ch, size_t shift, unsigned char *restrict dst,
+        unsigned short *restrict acc) {
+    size_t n = (size_t) 1 << shift, len = count * n * ch, i = 0;
+
+    for (; i + BOX_BLOCK <= len; i += BOX_BLOCK) {
+        unsigned short sum[BOX_BLOCK];
+        for (size_t k = 0; k < BOX_BLOCK; ++k)
+            sum[k] = src[i + k];
+        for (size_t r = 1; r < n; ++r)
+            for (size_t k = 0; k < BOX_BLOCK; ++k)
+                sum[k] += src[r * stride + i + k];
+        for (size_t k = 0; k < BOX_BLOCK; ++k)
+            acc[i + k] = sum[k];
+    }
+    for (; i < len; ++i) {
+        acc[i] = src[i];
+        for (size_t r = 1; r < n; ++r)
+            acc[i] += src[r * stride + i];
+    }
+
+    for (size_t x = 0; x < count * ch; x += ch, acc += n * ch) {
+        for (size_t c = 0; c < ch; ++c) {
+            unsigned int sum = 1 << (2 * shift - 1);
+            for (size_t j = 0; j < n; ++j)
+                sum += acc[j * ch + c];
+            dst[x + c] = sum >> (2 * shift);
+        }
+    }
+}
+
+#define BOX_ROW_CH(ch) \
+    switch (shift) { \
+    case 1: box_row_n(src, stride, count, ch, 1, dst, acc); break; \
+    case 2: box_row_n(src, stride, count, ch, 2, dst, acc); break; \
+    case 3: box_row_n(src, stride, count, ch, 3, dst, acc); break; \
+    }
+
+static void box_row(const unsigned char *src, size_t stride,
+        unsigned int count, unsigned int ch, unsigned int shift,
+        unsigned char *dst, unsigned short *acc) {
+    if (ch == 1)
+        BOX_ROW_CH(1)
+    else if (ch == 2)
+        BOX_ROW_CH(2)
+    else if (ch == 3)
+        BOX_ROW_CH(3)
+    else
+        BOX_ROW_CH(4)
+}
+
+/* A two-row frame and the column sums of box_row() */
+static size_t scale_scratch(enum plane_layout layout, unsigned int width,
+        unsigned int shift) {
+    return scratch_lines(frame_size(layout, width, 2)) +
+            scratch_lines((size_t) width * (1 << shift) * 4 *
+            sizeof(unsigned short));
+}
+
+/*
+ * Scale the source rows behind output rows [h0, h1) into a two-row
+ * scratch frame, one output row pair at a time, and hand each pair to the
+ * full-size row function. The large frame is read once, the SIMD kernels
+ * and matrix selection are reused as they are.
+ */
+static void scale_rows(const struct csc_job *job, unsigned int h0,
+        unsigned int h1, enum plane_layout layout, csc_rows_fn rows) {
+    unsigned int n = 1 << job->shift, width = job->width;
+    unsigned int bpp = packed_bpp(layout);
+    size_t row = bpp != 0 ? width * bpp : width;
+    size_t size = scratch_lines(frame_size(layout, width, 2));
+    unsigned char *buf = job_scratch(job, scale_scratch(layout, width,
+            job->shift));
+    unsigned short *acc = (unsigned short *) (buf + size);
+
+    struct csc_job pair = *job;
+    tight_frame(&pair.src, layout, buf, width, 2);
+    pair.src.matrix = job->src.matrix;
+    pair.src.range = job->src.range;
+    pair.height = 2;
+    pair.shift = 0;
+
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const csc_frame *src = &job->src;
+        if (bpp != 0) {
+            for (unsigned int r = 0; r < 2; ++r)
+                box_row(src->data[0] + src->stride[0] * (h + r) * n,
+                        src->stride[0], width, bpp, job->shift,
+                        pair.src.data[0] + row * r, acc);
+        } else {
+            for (unsigned int r = 0; r < 2; ++r)
+                box_row(src->data[0] + src->stride[0] * (h + r) * n,
+                        src->stride[0], width, 1, job->shift,
+                        pair.src.data[0] + row * r, acc);
+            if (layout == LAYOUT_SP)
+                box_row(src->data[1] + src->stride[1] * h / 2 * n,
+                        src->stride[1], width / 2, 2, job->shift,
+                        pair.src.data[1], acc);
+            else
+                for (unsigned int p = 1; p < 3; ++p)
+                    box_row(src->data[p] + src->stride[p] * h / 2 * n,
+                            src->stride[p], width / 2, 1, job->shift,
+                            pair.src.data[p], acc);
+        }
+
+        for (unsigned int p = 0; p < 3; ++p)
+            if (job->dst.data[p] != NULL)
+                pair.dst.data[p] = job->dst.data[p] +
+                        job->dst.stride[p] * (p == 0 ? h : h / 2);
+        rows(&pair, 0, 2);
+    }
+}
+
+#define SCALED_ROWS(name, layout) \
+static void name##_scaled_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    scale_rows(job, h0, h1, layout, name##_rows); \
+}
+
+SCALED_ROWS(rgb_to_yuv420sp, LAYOUT_PACKED)
+SCALED_ROWS(bgr_to_yvu420sp, LAYOUT_PACKED)
+SCALED_ROWS(rgb_to_yuv420p, LAYOUT_PACKED)
+SCALED_ROWS(bgr_to_yvu420p, LAYOUT_PACKED)
+SCALED_ROWS(yuv420sp_to_rgb, LAYOUT_SP)
+SCALED_ROWS(yvu420sp_to_bgr, LAYOUT_SP)
+SCALED_ROWS(yuv420p_to_rgb, LAYOUT_P)
+SCALED_ROWS(yvu420p_to_bgr, LAYOUT_P)
+SCALED_ROWS(rgb_to_yvu420sp, LAYOUT_PACKED)
+SCALED_ROWS(bgr_to_yuv420sp, LAYOUT_PACKED)
+SCALED_ROWS(rgb_to_yvu420p, LAYOUT_PACKED)
+SCALED_ROWS(bgr_to_yuv420p, LAYOUT_PACKED)
+SCALED_ROWS(yvu420sp_to_rgb, LAYOUT_SP)
+SCALED_ROWS(yuv420sp_to_bgr, LAYOUT_SP)
+SCALED_ROWS(yvu420p_to_rgb, LAYOUT_P)
+SCALED_ROWS(yuv420p_to_bgr, LAYOUT_P)
+
+static int scaled_job(struct csc_job *job, csc_rows_fn rows,
+        enum plane_layout src_layout, const csc_frame *src,
+        enum plane_layout dst_layout, const csc_frame *dst,
+        unsigned int width, unsigned int height, unsigned int factor) {
+    unsigned int shift = factor == 2 ? 1 : factor == 4 ? 2 :
+            factor == 8 ? 3 : 0;
+    unsigned int out_width = (width >> shift) & ~1u;
+    unsigned int out_height = (height >> shift) & ~1u;
+
+    if (shift == 0 || out_width == 0 || out_height == 0 ||
+            !frame_valid(src, src_layout, width) ||
+            !frame_valid(dst, dst_layout, out_width))
+        return -1;
+
+    *job = (struct csc_job) { .rows = rows, .src = *src, .dst = *dst,
+            .width = out_width, .height = out_height, .shift = shift,
+            .scratch = scale_scratch(src_layout, out_width, shift) };
+
+    return 0;
+}
+
+static int run_scaled(csc_ctx *ctx, csc_rows_fn rows,
+        enum plane_layout src_layout, const csc_frame *src,
+        enum plane_layout dst_layout, const csc_frame *dst,
+        unsigned int width, unsigned int height, unsigned int factor) {
+    struct csc_job job;
+    if (scaled_job(&job, rows, src_layout, src, dst_layout, dst,
+            width, height, factor) != 0)
+        return -1;
+
+    return csc_run(ctx, &job);
+}
+
+int rgb_to_yuv420sp_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, rgb_to_yuv420sp_scaled_rows, LAYOUT_PACKED, src,
+            LAYOUT_SP, dst, width, height, factor);
+}
+
+int bgr_to_yvu420sp_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, bgr_to_yvu420sp_scaled_rows, LAYOUT_PACKED, src,
+            LAYOUT_SP, dst, width, height, factor);
+}
+
+int rgb_to_yuv420p_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, rgb_to_yuv420p_scaled_rows, LAYOUT_PACKED, src,
+            LAYOUT_P, dst, width, height, factor);
+}
+
+int bgr_to_yvu420p_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, bgr_to_yvu420p_scaled_rows, LAYOUT_PACKED, src,
+            LAYOUT_P, dst, width, height, factor);
+}
+
+int yuv420sp_to_rgb_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, yuv420sp_to_rgb_scaled_rows, LAYOUT_SP, src,
+            LAYOUT_PACKED, dst, width, height, factor);
+}
+
+int yvu420sp_to_bgr_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, yvu420sp_to_bgr_scaled_rows, LAYOUT_SP, src,
+            LAYOUT_PACKED, dst, width, height, factor);
+}
+
+int yuv420p_to_rgb_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, yuv420p_to_rgb_scaled_rows, LAYOUT_P, src,
+            LAYOUT_PACKED, dst, width, height, factor);
+}
+
+int yvu420p_to_bgr_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, yvu420p_to_bgr_scaled_rows, LAYOUT_P, src,
+            LAYOUT_PACKED, dst, width, height, factor);
+}
+
+int rgb_to_yvu420sp_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, rgb_to_yvu420sp_scaled_rows, LAYOUT_PACKED, src,
+            LAYOUT_SP, dst, width, height, factor);
+}
+
+int bgr_to_yuv420sp_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, bgr_to_yuv420sp_scaled_rows, LAYOUT_PACKED, src,
+            LAYOUT_SP, dst, width, height, factor);
+}
+
+int rgb_to_yvu420p_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, rgb_to_yvu420p_scaled_rows, LAYOUT_PACKED, src,
+            LAYOUT_P, dst, width, height, factor);
+}
+
+int bgr_to_yuv420p_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, bgr_to_yuv420p_scaled_rows, LAYOUT_PACKED, src,
+            LAYOUT_P, dst, width, height, factor);
+}
+
+int yvu420sp_to_rgb_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, yvu420sp_to_rgb_scaled_rows, LAYOUT_SP, src,
+            LAYOUT_PACKED, dst, width, height, factor);
+}
+
+int yuv420sp_to_bgr_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, yuv420sp_to_bgr_scaled_rows, LAYOUT_SP, src,
+            LAYOUT_PACKED, dst, width, height, factor);
+}
+
+int yvu420p_to_rgb_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, yvu420p_to_rgb_scaled_rows, LAYOUT_P, src,
+            LAYOUT_PACKED, dst, width, height, factor);
+}
+
+int yuv420p_to_bgr_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor) {
+    return run_scaled(ctx, yuv420p_to_bgr_scaled_rows, LAYOUT_P, src,
+            LAYOUT_PACKED, dst, width, height, factor);
+}
+
+/*
+ * Bilinear resize taps: output sample i of out lies between source
+ * samples a and b of in, f / 256 of the way to b, with the centres of
+ * the first and last samples lined up.
+ */
+struct tap {
+    unsigned int a, b, f;
+};
+
+static struct tap resize_tap(unsigned int i, unsigned int out,
+        unsigned int in) {
+    /* (i + 0.5) * in / out - 0.5 in 1/256ths, without overflow */
+    unsigned long long q = (2ull * i + 1) * in, d = 2ull * out;
+    unsigned long long pos = q / d * 256 + q % d * 256 / d;
+    pos = pos > 128 ? pos - 128 : 0;
+
+    struct tap t = { pos >> 8, (pos >> 8) + 1, pos & 255 };
+    if (t.b >= in)
+        t = (struct tap) { in - 1, in - 1, 0 };
+
+    return t;
+}
+
+static inline __attribute__((always_inline)) void resize_row_n(
+        const unsigned char *row, unsigned int ch, const struct tap *taps,
+        unsigned int count, unsigned char *dst) {
+    for (unsigned int x = 0; x < count; ++x, dst += ch) {
+        const unsigned char *a = row + taps[x].a * ch;
+        const unsigned char *b = row + taps[x].b * ch;
+        for (unsigned int c = 0; c < ch; ++c)
+            dst[c] = csc_lerp(a[c], b[c], taps[x].f);
+    }
+}
+
+/* count samples of ch interleaved channels across a row */
+static void resize_row(const unsigned char *row, unsigned int ch,
+        const struct tap *taps, unsigned int count, unsigned char *dst) {
+    if (ch == 1)
+        resize_row_n(row, 1, taps, count, dst);
+    else
+        resize_row_n(row, 2, taps, count, dst);
+}
+
+/* count bytes of plane rows t.a and t.b blended into tmp, or row t.a */
+static const unsigned char *lerp_rows(const struct csc_simd_kernels *simd,
+        const unsigned char *plane, size_t stride, struct tap t,
+        unsigned int count, unsigned char *tmp) {
+    const unsigned char *a = plane + stride * t.a;
+    if (t.f == 0)
+        return a;
+
+    const unsigned char *b = plane + stride * t.b;
+    if (simd != NULL)
+        simd->lerp_row(a, b, t.f, tmp, count);
+    else
+        csc_lerp_tail(a, b, t.f, tmp, 0, count);
+
+    return tmp;
+}
+
+/* The resized row pair and one blended source row of resize_rows() */
+static size_t resize_scratch(enum plane_layout layout, unsigned int width,
+        unsigned int in_width) {
+    return scratch_lines(frame_size(layout, width, 2)) +
+            scratch_lines((size_t) in_width + 1);
+}
+
+/*
+ * The taps of the width output columns and the width / 2 chroma ones,
+ * then of the height rows and the height / 2 chroma rows
+ */
+static struct tap *resize_taps(unsigned int width, unsigned int height,
+        unsigned int in_width, unsigned int in_height) {
+    size_t count = (size_t) width + width / 2 + height + height / 2;
+    struct tap *taps = malloc(count * sizeof(*taps));
+    if (taps == NULL)
+        return NULL;
+
+    struct tap *t = taps;
+    for (unsigned int x = 0; x < width; ++x)
+        *t++ = resize_tap(x, width, in_width);
+    for (unsigned int x = 0; x < width / 2; ++x)
+        *t++ = resize_tap(x, width / 2, (in_width + 1) / 2);
+    for (unsigned int y = 0; y < height; ++y)
+        *t++ = resize_tap(y, height, in_height);
+    for (unsigned int y = 0; y < height / 2; ++y)
+        *t++ = resize_tap(y, height / 2, (in_height + 1) / 2);
+
+    return taps;
+}
+
+/*
+ * Resample the in_width x in_height 4:2:0 source behind output rows
+ * [h0, h1) into a two-row scratch frame, one output row pair at a time,
+ * and hand each pair to job->inner like scale_rows(). Every plane row is
+ * blended vertically at the source width with SIMD, then sampled across
+ * to the output width, so nothing larger than a row is written on the
+ * way.
+ */
+static void resize_rows(const struct csc_job *job, unsigned int h0,
+        unsigned int h1) {
+    const struct csc_simd_kernels *simd = csc_simd_kernels();
+    enum plane_layout layout = job->src_layout;
+    unsigned int width = job->width, in_width = job->in_width;
+    unsigned int ch = layout == LAYOUT_SP ? 2 : 1;
+    unsigned int planes = layout == LAYOUT_SP ? 2 : 3;
+    const struct tap *taps = job->taps, *ctaps = taps + width;
+    const struct tap *rtaps = ctaps + width / 2;
+    const struct tap *crtaps = rtaps + job->height;
+    size_t own = resize_scratch(layout, width, in_width);
+    unsigned char *buf = job_scratch(job, own);
+    unsigned char *tmp = buf + scratch_lines(frame_size(layout, width, 2));
+
+    struct csc_job pair = *job;
+    pair.rows = job->inner;
+    pair.scratch = job->scratch - own;
+    tight_frame(&pair.src, layout, buf, width, 2);
+    pair.src.matrix = job->src.matrix;
+    pair.src.range = job->src.range;
+    pair.height = 2;
+
+    const csc_frame *src = &job->src;
+    for (unsigned int h = h0; h < h1; h += 2) {
+        for (unsigned int r = 0; r < 2; ++r)
+            resize_row(lerp_rows(simd, src->data[0], src->stride[0],
+                    rtaps[h + r], in_width, tmp), 1, taps, width,
+                    pair.src.data[0] + pair.src.stride[0] * r);
+
+        for (unsigned int p = 1; p < planes; ++p)
+            resize_row(lerp_rows(simd, src->data[p], src->stride[p],
+                    crtaps[h / 2], (in_width + 1) / 2 * ch, tmp), ch,
+                    ctaps, width / 2, pair.src.data[p]);
+
+        for (unsigned int p = 0; p < 3; ++p)
+            if (job->dst.data[p] != NULL)
+                pair.dst.data[p] = job->dst.data[p] +
+                        job->dst.stride[p] * (p == 0 ? h : h / 2);
+        job->inner(&pair, 0, 2);
+    }
+}
+
+/*
+ * With the top rows of the source in, the output row pairs from h on can
+ * be converted up to the row returned.
+ */
+static unsigned int resize_ready(const struct csc_job *job, unsigned int h,
+        unsigned int rows) {
+    if (rows >= job->in_height)
+        return job->height;
+
+    const struct tap *rtaps = job->taps + job->width + job->width / 2;
+    const struct tap *crtaps = rtaps + job->height;
+    for (; h < job->height; h += 2)
+        if (rtaps[h + 1].b >= rows || crtaps[h / 2].b * 2 + 1 >= rows)
+            break;
+
+
+    return h;
+}
+
+static int resized_job(struct csc_job *job, csc_rows_fn rows,
+        enum plane_layout src_layout, const csc_frame *src,
+        enum plane_layout dst_layout, const csc_frame *dst,
+        unsigned int width, unsigned int height,
+        unsigned int out_width, unsigned int out_height,
+        const struct tap *taps) {
+    if (!frame_valid(src, src_layout, width) ||
+            !frame_valid(dst, dst_layout, out_width) ||
+            src->data[0] == dst->data[0])
+        return -1;
+
+    *job = (struct csc_job) { .rows = resize_rows, .src = *src, .dst = *dst,
+            .width = out_width, .height = out_height, .inner = rows,
+            .src_layout = src_layout, .dst_layout = dst_layout,
+            .in_width = width, .in_height = height, .taps = taps,
+            .scratch = resize_scratch(src_layout, out_width, width) +
+                    rows_scratch(src_layout, dst_layout, out_width) };
+
+    return 0;
+}
+
+static int roi_valid(const csc_rect *roi,
+        unsigned int width, unsigned int height) {
+    return roi != NULL && roi->width > 0 && roi->height > 0 &&
+            roi->x + roi->width <= width && roi->y + roi->height <= height;
+}
+
+/*
+ * Decode an ROI that does not start or end on a chroma sample: the
+ * enclosing even-aligned rows are decoded a pair at a time into a
+ * scratch buffer and job->crop of them copied out, so every pixel keeps
+ * its own chroma. job->width and height are those of the aligned rows.
+ */
+static void crop_rows(const struct csc_job *job, unsigned int h0,
+        unsigned int h1, enum plane_layout layout,
+        enum plane_layout dst_layout, csc_rows_fn rows) {
+    const csc_rect *crop = &job->crop;
+    unsigned int bpp = packed_bpp(dst_layout);
+    size_t row = job->width * bpp;
+    unsigned char *buf = job_scratch(job, scratch_lines(row * 2));
+
+    struct csc_job pair = *job;
+    tight_frame(&pair.dst, dst_layout, buf, job->width, 2);
+    pair.height = 2;
+    pair.scratch -= scratch_lines(row * 2);
+
+    for (unsigned int h = h0; h < h1; h += 2) {
+        pair.src = frame_at(&job->src, layout, 0, h);
+        rows(&pair, 0, 2);
+
+        for (unsigned int r = 0; r < 2; ++r) {
+            unsigned int out = h + r - crop->y;
+            if (h + r >= crop->y && out < crop->height)
+                memcpy(job->dst.data[0] + job->dst.stride[0] * out,
+                        buf + row * r + crop->x * bpp, crop->width * bpp);
+        }
+    }
+}
+
+#define CROP_ROWS(name, layout) \
+static void name##_crop_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    crop_rows(job, h0, h1, layout, LAYOUT_PACKED, name##_rows); \
+}
+
+#define CROP4_ROWS(name, layout) \
+static void name##_crop_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    crop_rows(job, h0, h1, layout, LAYOUT_PACKED32, name##_rows); \
+}
+
+CROP_ROWS(yuv420sp_to_rgb, LAYOUT_SP)
+CROP_ROWS(yvu420sp_to_bgr, LAYOUT_SP)
+CROP_ROWS(yuv420p_to_rgb, LAYOUT_P)
+CROP_ROWS(yvu420p_to_bgr, LAYOUT_P)
+CROP_ROWS(yvu420sp_to_rgb, LAYOUT_SP)
+CROP_ROWS(yuv420sp_to_bgr, LAYOUT_SP)
+CROP_ROWS(yvu420p_to_rgb, LAYOUT_P)
+CROP_ROWS(yuv420p_to_bgr, LAYOUT_P)
+
+/*
+ * crop is the row function for ROIs off the chroma grid, NULL when dst is
+ * YUV: those need an even size and take the chroma under the top-left
+ * pixel of each 2x2 block, as the encoders do.
+ */
+static int roi_job(struct csc_job *job, csc_rows_fn rows, csc_rows_fn crop,
+        enum plane_layout src_layout, const csc_frame *src,
+        enum plane_layout dst_layout, const csc_frame *dst,
+        unsigned int width, unsigned int height, const csc_rect *roi) {
+    if (!roi_valid(roi, width, height) ||
+            !frame_valid(src, src_layout, width) ||
+            !frame_valid(dst, dst_layout, roi->width))
+        return -1;
+
+    *job = (struct csc_job) { .rows = rows, .dst = *dst,
+            .width = roi->width, .height = roi->height,
+            .scratch = rows_scratch(src_layout, dst_layout, roi->width) };
+
+    if (crop == NULL || ((roi->x | roi->y | roi->width | roi->height) & 1)
+            == 0) {
+        if (packed_bpp(dst_layout) == 0 && ((roi->width | roi->height) & 1))
+            return -1;
+        if (src_layout == LAYOUT_PACKED422 && (roi->x & 1))
+            return -1;
+        job->src = frame_at(src, src_layout, roi->x, roi->y);
+    } else {
+        unsigned int x0 = roi->x & ~1u, x1 = (roi->x + roi->width + 1) & ~1u;
+        unsigned int y0 = roi->y & ~1u, y1 = (roi->y + roi->height + 1) & ~1u;
+        if (x1 > width || y1 > height)
+            return -1;
+
+        job->rows = crop;
+        job->src = frame_at(src, src_layout, x0, y0);
+        job->width = x1 - x0;
+        job->height = y1 - y0;
+        job->crop = (csc_rect) { roi->x - x0, roi->y - y0,
+                roi->width, roi->height };
+        job->scratch = scratch_lines((size_t) job->width * 2 *
+                packed_bpp(dst_layout)) +
+                rows_scratch(src_layout, dst_layout, job->width);
+    }
+
+    return 0;
+}
+
+static int run_roi(csc_ctx *ctx, csc_rows_fn rows, csc_rows_fn crop,
+        enum plane_layout src_layout, const csc_frame *src,
+        enum plane_layout dst_layout, const csc_frame *dst,
+        unsigned int width, unsigned int height, const csc_rect *roi) {
+    struct csc_job job;
+    if (roi_job(&job, rows, crop, src_layout, src, dst_layout, dst,
+            width, height, roi) != 0)
+        return -1;
+
+    return csc_run(ctx, &job);
+}
+
+/* The YUV swaps cover every chroma sample the ROI touches */
+static int roi_in_place_job(struct csc_job *job, csc_rows_fn rows,
+        enum plane_layout layout, const csc_frame *frame,
+        unsigned int width, unsigned int height, const csc_rect *roi) {
+    if (!roi_valid(roi, width, height) || !frame_valid(frame, layout, width))
+        return -1;
+
+    unsigned int x0 = roi->x, x1 = roi->x + roi->width;
+    unsigned int y0 = roi->y, y1 = roi->y + roi->height;
+    if (packed_bpp(layout) == 0) {
+        x0 &= ~1u;
+        x1 = (x1 + 1) & ~1u;
+        y0 &= ~1u;
+        y1 = (y1 + 1) & ~1u;
+        if (x1 > width || y1 > height)
+            return -1;
+    }
+
+    csc_frame at = frame_at(frame, layout, x0, y0);
+    *job = (struct csc_job) { .rows = rows, .src = at, .dst = at,
+            .width = x1 - x0, .height = y1 - y0 };
+
+    return 0;
+}
+
+static int run_roi_in_place(csc_ctx *ctx, csc_rows_fn rows,
+        enum plane_layout layout, const csc_frame *frame,
+        unsigned int width, unsigned int height, const csc_rect *roi) {
+    struct csc_job job;
+    if (roi_in_place_job(&job, rows, layout, frame, width, height, roi) != 0)
+        return -1;
+
+    return csc_run(ctx, &job);
+}
+
+int convert_rgb_bgr_roi(csc_ctx *ctx, const csc_frame *frame,
+        unsigned short width, unsigned short height, const csc_rect *roi) {
+    return run_roi_in_place(ctx, convert_rgb_bgr_rows, LAYOUT_PACKED, frame,
+            width, height, roi);
+}
+
+int convert_yuv420sp_yvu420sp_roi(csc_ctx *ctx, const csc_frame *frame,
+        unsigned short width, unsigned short height, const csc_rect *roi) {
+    return run_roi_in_place(ctx, convert_yuv420sp_yvu420sp_rows, LAYOUT_SP,
+            frame, width, height, roi);
+}
+
+int convert_yuv420p_yvu420p_roi(csc_ctx *ctx, const csc_frame *frame,
+        unsigned short width, unsigned short height, const csc_rect *roi) {
+    return run_roi_in_place(ctx, convert_yuv420p_yvu420p_rows, LAYOUT_P,
+            frame, width, height, roi);
+}
+
+int rgb_to_yuv420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, rgb_to_yuv420sp_rows, NULL, LAYOUT_PACKED, src,
+            LAYOUT_SP, dst, width, height, roi);
+}
+
+int bgr_to_yvu420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, bgr_to_yvu420sp_rows, NULL, LAYOUT_PACKED, src,
+            LAYOUT_SP, dst, width, height, roi);
+}
+
+int rgb_to_yuv420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, rgb_to_yuv420p_rows, NULL, LAYOUT_PACKED, src,
+            LAYOUT_P, dst, width, height, roi);
+}
+
+int bgr_to_yvu420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, bgr_to_yvu420p_rows, NULL, LAYOUT_PACKED, src,
+            LAYOUT_P, dst, width, height, roi);
+}
+
+int yuv420sp_to_rgb_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, yuv420sp_to_rgb_rows, yuv420sp_to_rgb_crop_rows,
+            LAYOUT_SP, src, LAYOUT_PACKED, dst, width, height, roi);
+}
+
+int yvu420sp_to_bgr_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, yvu420sp_to_bgr_rows, yvu420sp_to_bgr_crop_rows,
+            LAYOUT_SP, src, LAYOUT_PACKED, dst, width, height, roi);
+}
+
+int yuv420p_to_rgb_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, yuv420p_to_rgb_rows, yuv420p_to_rgb_crop_rows,
+            LAYOUT_P, src, LAYOUT_PACKED, dst, width, height, roi);
+}
+
+int yvu420p_to_bgr_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, yvu420p_to_bgr_rows, yvu420p_to_bgr_crop_rows,
+            LAYOUT_P, src, LAYOUT_PACKED, dst, width, height, roi);
+}
+
+int yuv420p_to_yuv420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, yuv420p_to_yuv420sp_rows, NULL, LAYOUT_P, src,
+            LAYOUT_SP, dst, width, height, roi);
+}
+
+int yuv420sp_to_yuv420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, yuv420sp_to_yuv420p_rows, NULL, LAYOUT_SP, src,
+            LAYOUT_P, dst, width, height, roi);
+}
+
+int yvu420p_to_yvu420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return yuv420p_to_yuv420sp_roi(ctx, src, dst, width, height, roi);
+}
+
+int yvu420sp_to_yvu420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return yuv420sp_to_yuv420p_roi(ctx, src, dst, width, height, roi);
+}
+
+int rgb_to_yvu420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, rgb_to_yvu420sp_rows, NULL, LAYOUT_PACKED, src,
+            LAYOUT_SP, dst, width, height, roi);
+}
+
+int bgr_to_yuv420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, bgr_to_yuv420sp_rows, NULL, LAYOUT_PACKED, src,
+            LAYOUT_SP, dst, width, height, roi);
+}
+
+int rgb_to_yvu420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, rgb_to_yvu420p_rows, NULL, LAYOUT_PACKED, src,
+            LAYOUT_P, dst, width, height, roi);
+}
+
+int bgr_to_yuv420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, bgr_to_yuv420p_rows, NULL, LAYOUT_PACKED, src,
+            LAYOUT_P, dst, width, height, roi);
+}
+
+int yvu420sp_to_rgb_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, yvu420sp_to_rgb_rows, yvu420sp_to_rgb_crop_rows,
+            LAYOUT_SP, src, LAYOUT_PACKED, dst, width, height, roi);
+}
+
+int yuv420sp_to_bgr_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, yuv420sp_to_bgr_rows, yuv420sp_to_bgr_crop_rows,
+            LAYOUT_SP, src, LAYOUT_PACKED, dst, width, height, roi);
+}
+
+int yvu420p_to_rgb_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, yvu420p_to_rgb_rows, yvu420p_to_rgb_crop_rows,
+            LAYOUT_P, src, LAYOUT_PACKED, dst, width, height, roi);
+}
+
+int yuv420p_to_bgr_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, yuv420p_to_bgr_rows, yuv420p_to_bgr_crop_rows,
+            LAYOUT_P, src, LAYOUT_PACKED, dst, width, height, roi);
+}
+
+int yuv420p_to_yvu420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, yuv420p_to_yvu420sp_rows, NULL, LAYOUT_P, src,
+            LAYOUT_SP, dst, width, height, roi);
+}
+
+int yvu420p_to_yuv420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return yuv420p_to_yvu420sp_roi(ctx, src, dst, width, height, roi);
+}
+
+int yuv420sp_to_yvu420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, yuv420sp_to_yvu420p_rows, NULL, LAYOUT_SP, src,
+            LAYOUT_P, dst, width, height, roi);
+}
+
+int yvu420sp_to_yuv420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return yuv420sp_to_yvu420p_roi(ctx, src, dst, width, height, roi);
+}
+
+int yuv420sp_to_yvu420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, yuv420sp_to_yvu420sp_rows, NULL, LAYOUT_SP, src,
+            LAYOUT_SP, dst, width, height, roi);
+}
+
+int yvu420sp_to_yuv420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return yuv420sp_to_yvu420sp_roi(ctx, src, dst, width, height, roi);
+}
+
+int yuv420p_to_yvu420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return run_roi(ctx, yuv420p_to_yvu420p_rows, NULL, LAYOUT_P, src,
+            LAYOUT_P, dst, width, height, roi);
+}
+
+int yvu420p_to_yuv420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi) {
+    return yuv420p_to_yvu420p_roi(ctx, src, dst, width, height, roi);
+}
+
+/* Normalised value of every 8-bit sample, per channel */
+struct tensor_lut {
+    int type;
+    union {
+        float f32[3][256];
+        unsigned short f16[3][256];
+        signed char s8[3][256];
+    };
+};
+
+static const unsigned int tensor_sizes[] = {
+    [CSC_TENSOR_F32] = sizeof(float),
+    [CSC_TENSOR_F16] = sizeof(unsigned short),
+    [CSC_TENSOR_S8] = sizeof(signed char),
+};
+
+/* IEEE binary16, rounded to nearest even */
+static unsigned short float_to_half(float value) {
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    unsigned int sign = bits >> 16 & 0x8000;
+    unsigned int mant = bits & 0x7fffff;
+    int exp = (int) (bits >> 23 & 0xff) - 127 + 15;
+
+    if ((bits & 0x7fffffff) > 0x7f800000)
+        return sign | 0x7e00;
+    if (exp >= 31)
+        return sign | 0x7c00;
+    if (exp < -10)
+        return sign;
+
+    unsigned int shift = 13;
+    if (exp <= 0) {
+        mant |= 0x800000;
+        shift = 14 - exp;
+        exp = 0;
+    }
+
+    unsigned int half = (unsigned int) exp << 10 | mant >> shift;
+    unsigned int rest = mant & ((1u << shift) - 1), mid = 1u << (shift - 1);
+    if (rest > mid || (rest == mid && (half & 1)))
+        ++half;     /* may carry into the exponent, up to infinity */
+
+    return sign | half;
+}
+
+static signed char float_to_s8(float value) {
+    if (value <= -128.0f)
+        return -128;
+    if (value >= 127.0f)
+        return 127;
+
+    return value >= 0 ? (int) (value + 0.5f) : -(int) (0.5f - value);
+}
+
+static void tensor_lut_init(struct tensor_lut *lut, const csc_tensor *tensor) {
+    lut->type = tensor->type;
+    for (int c = 0; c < 3; ++c) {
+        for (int i = 0; i < 256; ++i) {
+            float value = i * tensor->scale[c] + tensor->bias[c];
+            switch (tensor->type) {
+            case CSC_TENSOR_F32:
+                lut->f32[c][i] = value;
+                break;
+            case CSC_TENSOR_F16:
+                lut->f16[c][i] = float_to_half(value);
+                break;
+            case CSC_TENSOR_S8:
+                lut->s8[c][i] = float_to_s8(value);
+                break;
+            }
+        }
+    }
+}
+
+#define TENSOR_SCATTER(table, type) \
+static void scatter_##table(const struct tensor_lut *lut, \
+        const unsigned char *restrict rgb, type *restrict r, \
+        type *restrict g, type *restrict b, unsigned int width) { \
+    for (size_t x = 0; x < width; ++x) { \
+        r[x] = lut->table[0][rgb[x * 3]]; \
+        g[x] = lut->table[1][rgb[x * 3 + 1]]; \
+        b[x] = lut->table[2][rgb[x * 3 + 2]]; \
+    } \
+}
+
+TENSOR_SCATTER(f32, float)
+TENSOR_SCATTER(f16, unsigned short)
+TENSOR_SCATTER(s8, signed char)
+
+/*
+ * Decode a pair of rows into a packed buffer that stays in L1, then spread
+ * it over the three planes through the table.
+ */
+static void tensor_rows(const struct csc_job *job, unsigned int h0,
+        unsigned int h1, enum plane_layout layout, csc_rows_fn rows) {
+    const csc_frame *dst = &job->dst;
+    size_t row = job->width * 3;
+    unsigned char *buf = job_scratch(job, job->scratch);
+
+    struct csc_job pair = *job;
+    tight_frame(&pair.dst, LAYOUT_PACKED, buf, job->width, 2);
+    pair.height = 2;
+
+    for (unsigned int h = h0; h < h1; h += 2) {
+        pair.src = frame_at(&job->src, layout, 0, h);
+        rows(&pair, 0, 2);
+
+        for (unsigned int r = 0; r < 2; ++r) {
+            void *p[3];
+            for (int c = 0; c < 3; ++c)
+                p[c] = dst->data[c] + dst->stride[c] * (h + r);
+
+            const unsigned char *rgb = buf + row * r;
+            switch (job->lut->type) {
+            case CSC_TENSOR_F32:
+                scatter_f32(job->lut, rgb, p[0], p[1], p[2], job->width);
+                break;
+            case CSC_TENSOR_F16:
+                scatter_f16(job->lut, rgb, p[0], p[1], p[2], job->width);
+                break;
+            case CSC_TENSOR_S8:
+                scatter_s8(job->lut, rgb, p[0], p[1], p[2], job->width);
+                break;
+            }
+        }
+    }
+}
+
+#define TENSOR_ROWS(name, layout) \
+static void name##_tensor_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    tensor_rows(job, h0, h1, layout, name##_to_rgb_rows); \
+}
+
+TENSOR_ROWS(yuv420sp, LAYOUT_SP)
+TENSOR_ROWS(yvu420sp, LAYOUT_SP)
+TENSOR_ROWS(yuv420p, LAYOUT_P)
+TENSOR_ROWS(yvu420p, LAYOUT_P)
+
+static int run_tensor(csc_ctx *ctx, csc_rows_fn rows,
+        enum plane_layout layout, const csc_frame *src,
+        const csc_tensor *dst, unsigned short width, unsigned short height) {
+    if (dst == NULL || dst->type < CSC_TENSOR_F32 ||
+            dst->type > CSC_TENSOR_S8 || !frame_valid(src, layout, width))
+        return -1;
+
+    struct csc_job job = { .rows = rows, .src = *src,
+            .width = width, .height = height,
+            .scratch = scratch_lines((size_t) width * 3 * 2) };
+    for (int c = 0; c < 3; ++c) {
+        if (dst->data[c] == NULL ||
+                dst->stride[c] < (size_t) width * tensor_sizes[dst->type])
+            return -1;
+        job.dst.data[c] = dst->data[c];
+        job.dst.stride[c] = dst->stride[c];
+    }
+
+    struct tensor_lut lut;
+    tensor_lut_init(&lut, dst);
+    job.lut = &lut;
+    return csc_run(ctx, &job);
+}
+
+int yuv420sp_to_tensor(csc_ctx *ctx, const csc_frame *src,
+        const csc_tensor *dst, unsigned short width, unsigned short height) {
+    return run_tensor(ctx, yuv420sp_tensor_rows, LAYOUT_SP, src, dst,
+            width, height);
+}
+
+int yvu420sp_to_tensor(csc_ctx *ctx, const csc_frame *src,
+        const csc_tensor *dst, unsigned short width, unsigned short height) {
+    return run_tensor(ctx, yvu420sp_tensor_rows, LAYOUT_SP, src, dst,
+            width, height);
+}
+
+int yuv420p_to_tensor(csc_ctx *ctx, const csc_frame *src,
+        const csc_tensor *dst, unsigned short width, unsigned short height) {
+    return run_tensor(ctx, yuv420p_tensor_rows, LAYOUT_P, src, dst,
+            width, height);
+}
+
+int yvu420p_to_tensor(csc_ctx *ctx, const csc_frame *src,
+        const csc_tensor *dst, unsigned short width, unsigned short height) {
+    return run_tensor(ctx, yvu420p_tensor_rows, LAYOUT_P, src, dst,
+            width, height);
+}
+
+/*
+ * 4-byte pixels by byte order in memory: RGBA, BGRA, ARGB and ABGR. The
+ * encoders skip the alpha byte, the decoders fill it with 255.
+ */
+ENC4_ROWS(rgba_to_yuv420sp, ORDER_RGB_UV, 0, 0, 1, 2, 0, 0, 1)
+ENC4_ROWS(rgba_to_yvu420sp, ORDER_RGB_VU, 0, 0, 1, 2, 0, 1, 0)
+ENC4_ROWS(rgba_to_yuv420p, ORDER_RGB_UV, 0, 0, 1, 2, 1, 1, 2)
+ENC4_ROWS(rgba_to_yvu420p, ORDER_RGB_VU, 0, 0, 1, 2, 1, 2, 1)
+ENC4_ROWS(bgra_to_yuv420sp, ORDER_BGR_UV, 0, 2, 1, 0, 0, 0, 1)
+ENC4_ROWS(bgra_to_yvu420sp, ORDER_BGR_VU, 0, 2, 1, 0, 0, 1, 0)
+ENC4_ROWS(bgra_to_yuv420p, ORDER_BGR_UV, 0, 2, 1, 0, 1, 1, 2)
+ENC4_ROWS(bgra_to_yvu420p, ORDER_BGR_VU, 0, 2, 1, 0, 1, 2, 1)
+ENC4_ROWS(argb_to_yuv420sp, ORDER_RGB_UV, 1, 1, 2, 3, 0, 0, 1)
+ENC4_ROWS(argb_to_yvu420sp, ORDER_RGB_VU, 1, 1, 2, 3, 0, 1, 0)
+ENC4_ROWS(argb_to_yuv420p, ORDER_RGB_UV, 1, 1, 2, 3, 1, 1, 2)
+ENC4_ROWS(argb_to_yvu420p, ORDER_RGB_VU, 1, 1, 2, 3, 1, 2, 1)
+ENC4_ROWS(abgr_to_yuv420sp, ORDER_BGR_UV, 1, 3, 2, 1, 0, 0, 1)
+ENC4_ROWS(abgr_to_yvu420sp, ORDER_BGR_VU, 1, 3, 2, 1, 0, 1, 0)
+ENC4_ROWS(abgr_to_yuv420p, ORDER_BGR_UV, 1, 3, 2, 1, 1, 1, 2)
+ENC4_ROWS(abgr_to_yvu420p, ORDER_BGR_VU, 1, 3, 2, 1, 1, 2, 1)
+
+DEC4_ROWS(yuv420sp_to_rgba, ORDER_RGB_UV, 0, 0, 1, 2, 0, 0, 1)
+DEC4_ROWS(yvu420sp_to_rgba, ORDER_RGB_VU, 0, 0, 1, 2, 0, 1, 0)
+DEC4_ROWS(yuv420p_to_rgba, ORDER_RGB_UV, 0, 0, 1, 2, 1, 1, 2)
+DEC4_ROWS(yvu420p_to_rgba, ORDER_RGB_VU, 0, 0, 1, 2, 1, 2, 1)
+DEC4_ROWS(yuv420sp_to_bgra, ORDER_BGR_UV, 0, 2, 1, 0, 0, 0, 1)
+DEC4_ROWS(yvu420sp_to_bgra, ORDER_BGR_VU, 0, 2, 1, 0, 0, 1, 0)
+DEC4_ROWS(yuv420p_to_bgra, ORDER_BGR_UV, 0, 2, 1, 0, 1, 1, 2)
+DEC4_ROWS(yvu420p_to_bgra, ORDER_BGR_VU, 0, 2, 1, 0, 1, 2, 1)
+DEC4_ROWS(yuv420sp_to_argb, ORDER_RGB_UV, 1, 1, 2, 3, 0, 0, 1)
+DEC4_ROWS(yvu420sp_to_argb, ORDER_RGB_VU, 1, 1, 2, 3, 0, 1, 0)
+DEC4_ROWS(yuv420p_to_argb, ORDER_RGB_UV, 1, 1, 2, 3, 1, 1, 2)
+DEC4_ROWS(yvu420p_to_argb, ORDER_RGB_VU, 1, 1, 2, 3, 1, 2, 1)
+DEC4_ROWS(yuv420sp_to_abgr, ORDER_BGR_UV, 1, 3, 2, 1, 0, 0, 1)
+DEC4_ROWS(yvu420sp_to_abgr, ORDER_BGR_VU, 1, 3, 2, 1, 0, 1, 0)
+DEC4_ROWS(yuv420p_to_abgr, ORDER_BGR_UV, 1, 3, 2, 1, 1, 1, 2)
+DEC4_ROWS(yvu420p_to_abgr, ORDER_BGR_VU, 1, 3, 2, 1, 1, 2, 1)
+
+SCALED_ROWS(rgba_to_yuv420sp, LAYOUT_PACKED32)
+SCALED_ROWS(rgba_to_yvu420sp, LAYOUT_PACKED32)
+SCALED_ROWS(rgba_to_yuv420p, LAYOUT_PACKED32)
+SCALED_ROWS(rgba_to_yvu420p, LAYOUT_PACKED32)
+SCALED_ROWS(bgra_to_yuv420sp, LAYOUT_PACKED32)
+SCALED_ROWS(bgra_to_yvu420sp, LAYOUT_PACKED32)
+SCALED_ROWS(bgra_to_yuv420p, LAYOUT_PACKED32)
+SCALED_ROWS(bgra_to_yvu420p, LAYOUT_PACKED32)
+SCALED_ROWS(argb_to_yuv420sp, LAYOUT_PACKED32)
+SCALED_ROWS(argb_to_yvu420sp, LAYOUT_PACKED32)
+SCALED_ROWS(argb_to_yuv420p, LAYOUT_PACKED32)
+SCALED_ROWS(argb_to_yvu420p, LAYOUT_PACKED32)
+SCALED_ROWS(abgr_to_yuv420sp, LAYOUT_PACKED32)
+SCALED_ROWS(abgr_to_yvu420sp, LAYOUT_PACKED32)
+SCALED_ROWS(abgr_to_yuv420p, LAYOUT_PACKED32)
+SCALED_ROWS(abgr_to_yvu420p, LAYOUT_PACKED32)
+SCALED_ROWS(yuv420sp_to_rgba, LAYOUT_SP)
+SCALED_ROWS(yvu420sp_to_rgba, LAYOUT_SP)
+SCALED_ROWS(yuv420p_to_rgba, LAYOUT_P)
+SCALED_ROWS(yvu420p_to_rgba, LAYOUT_P)
+SCALED_ROWS(yuv420sp_to_bgra, LAYOUT_SP)
+SCALED_ROWS(yvu420sp_to_bgra, LAYOUT_SP)
+SCALED_ROWS(yuv420p_to_bgra, LAYOUT_P)
+SCALED_ROWS(yvu420p_to_bgra, LAYOUT_P)
+SCALED_ROWS(yuv420sp_to_argb, LAYOUT_SP)
+SCALED_ROWS(yvu420sp_to_argb, LAYOUT_SP)
+SCALED_ROWS(yuv420p_to_argb, LAYOUT_P)
+SCALED_ROWS(yvu420p_to_argb, LAYOUT_P)
+SCALED_ROWS(yuv420sp_to_abgr, LAYOUT_SP)
+SCALED_ROWS(yvu420sp_to_abgr, LAYOUT_SP)
+SCALED_ROWS(yuv420p_to_abgr, LAYOUT_P)
+SCALED_ROWS(yvu420p_to_abgr, LAYOUT_P)
+
+CROP4_ROWS(yuv420sp_to_rgba, LAYOUT_SP)
+CROP4_ROWS(yvu420sp_to_rgba, LAYOUT_SP)
+CROP4_ROWS(yuv420p_to_rgba, LAYOUT_P)
+CROP4_ROWS(yvu420p_to_rgba, LAYOUT_P)
+CROP4_ROWS(yuv420sp_to_bgra, LAYOUT_SP)
+CROP4_ROWS(yvu420sp_to_bgra, LAYOUT_SP)
+CROP4_ROWS(yuv420p_to_bgra, LAYOUT_P)
+CROP4_ROWS(yvu420p_to_bgra, LAYOUT_P)
+CROP4_ROWS(yuv420sp_to_argb, LAYOUT_SP)
+CROP4_ROWS(yvu420sp_to_argb, LAYOUT_SP)
+CROP4_ROWS(yuv420p_to_argb, LAYOUT_P)
+CROP4_ROWS(yvu420p_to_argb, LAYOUT_P)
+CROP4_ROWS(yuv420sp_to_abgr, LAYOUT_SP)
+CROP4_ROWS(yvu420sp_to_abgr, LAYOUT_SP)
+CROP4_ROWS(yuv420p_to_abgr, LAYOUT_P)
+CROP4_ROWS(yvu420p_to_abgr, LAYOUT_P)
+
+/*
+ * Byte offsets of R, G, B and A (-1 for none) in each packed format, after
+ * the pixel size. Alpha is carried over between 4-byte formats and set to
+ * 255 from 3-byte ones.
+ */
+#define PX_rgb  3, 0, 1, 2, -1
+#define PX_bgr  3, 2, 1, 0, -1
+#define PX_rgba 4, 0, 1, 2, 3
+#define PX_bgra 4, 2, 1, 0, 3
+#define PX_argb 4, 1, 2, 3, 0
+#define PX_abgr 4, 3, 2, 1, 0
+
+/*
+ * Each pixel is read whole before it is written, so formats of the same
+ * size also convert in place.
+ */
+static inline __attribute__((always_inline)) void repack_rows(
+        const struct csc_job *job, unsigned int h0, unsigned int h1,
+        size_t sbpp, int sr, int sg, int sb, int sa,
+        size_t dbpp, int dr, int dg, int db, int da) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+
+    for (unsigned int h = h0; h < h1; ++h) {
+        const unsigned char *s = src->data[0] + src->stride[0] * h;
+        unsigned char *d = dst->data[0] + dst->stride[0] * h;
+        for (size_t x = 0; x < job->width; ++x) {
+            unsigned char r = s[x * sbpp + sr], g = s[x * sbpp + sg];
+            unsigned char b = s[x * sbpp + sb];
+            unsigned char a = sa >= 0 ? s[x * sbpp + sa] : 255;
+            d[x * dbpp + dr] = r;
+            d[x * dbpp + dg] = g;
+            d[x * dbpp + db] = b;
+            if (da >= 0)
+                d[x * dbpp + da] = a;
+        }
+    }
+}
+
+#define REPACK_ROWS(from, to) \
+static void from##_to_##to##_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    repack_rows(job, h0, h1, PX_##from, PX_##to); \
+}
+
+REPACK_ROWS(rgb, rgba)
+REPACK_ROWS(rgb, bgra)
+REPACK_ROWS(rgb, argb)
+REPACK_ROWS(rgb, abgr)
+REPACK_ROWS(bgr, rgba)
+REPACK_ROWS(bgr, bgra)
+REPACK_ROWS(bgr, argb)
+REPACK_ROWS(bgr, abgr)
+REPACK_ROWS(rgba, rgb)
+REPACK_ROWS(rgba, bgr)
+REPACK_ROWS(rgba, bgra)
+REPACK_ROWS(rgba, argb)
+REPACK_ROWS(rgba, abgr)
+REPACK_ROWS(bgra, rgb)
+REPACK_ROWS(bgra, bgr)
+REPACK_ROWS(bgra, rgba)
+REPACK_ROWS(bgra, argb)
+REPACK_ROWS(bgra, abgr)
+REPACK_ROWS(argb, rgb)
+REPACK_ROWS(argb, bgr)
+REPACK_ROWS(argb, rgba)
+REPACK_ROWS(argb, bgra)
+REPACK_ROWS(argb, abgr)
+REPACK_ROWS(abgr, rgb)
+REPACK_ROWS(abgr, bgr)
+REPACK_ROWS(abgr, rgba)
+REPACK_ROWS(abgr, bgra)
+REPACK_ROWS(abgr, argb)
+
+/*
+ * Packed 4:2:2 to 4:2:0 in one pass: each row pair gives two Y rows and
+ * one chroma row averaged over both. first is the offset of the first Y
+ * byte, 0 for YUYV and 1 for UYVY, planar, u and v as in enc_rows().
+ */
+static inline __attribute__((always_inline)) void unpack422_rows(
+        const struct csc_job *job, unsigned int h0, unsigned int h1,
+        int first, int planar, int u, int v) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    const struct csc_simd_kernels *simd = csc_simd_kernels();
+    unsigned int width = job->width;
+    size_t cstep = planar ? 1 : 2;
+    int c = 1 - first;
+
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *restrict s0 = src->data[0] + src->stride[0] * h;
+        const unsigned char *restrict s1 = s0 + src->stride[0];
+        unsigned char *restrict y0 = dst->data[0] + dst->stride[0] * h;
+        unsigned char *restrict y1 = y0 + dst->stride[0];
+        unsigned char *restrict u_row, *restrict v_row;
+        if (planar) {
+            u_row = dst->data[u] + dst->stride[u] * h / 2;
+            v_row = dst->data[v] + dst->stride[v] * h / 2;
+        } else {
+            u_row = dst->data[1] + dst->stride[1] * h / 2 + u;
+            v_row = dst->data[1] + dst->stride[1] * h / 2 + v;
+        }
+
+        if (simd != NULL && planar) {
+            simd->unpack422_p_rows(first, s0, s1, y0, y1, u_row, v_row,
+                    width);
+            continue;
+        }
+        if (simd != NULL) {
+            unsigned char *uv = dst->data[1] + dst->stride[1] * h / 2;
+            simd->unpack422_sp_rows(first, s0, s1, y0, y1, uv, width);
+            if (u != 0)
+                simd->swap_pairs_row(uv, width / 2);
+            continue;
+        }
+
+        for (unsigned int w = 0; w < width; w += 2) {
+            const unsigned char *a = s0 + w * 2, *b = s1 + w * 2;
+            y0[w]     = a[first];
+            y0[w + 1] = a[first + 2];
+            y1[w]     = b[first];
+            y1[w + 1] = b[first + 2];
+            u_row[w / 2 * cstep] = (a[c] + b[c] + 1) >> 1;
+            v_row[w / 2 * cstep] = (a[c + 2] + b[c + 2] + 1) >> 1;
+        }
+    }
+}
+
+#define UNPACK422_ROWS(name, first, planar, u, v) \
+static void name##_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    unpack422_rows(job, h0, h1, first, planar, u, v); \
+}
+
+UNPACK422_ROWS(yuyv_to_yuv420sp, 0, 0, 0, 1)
+UNPACK422_ROWS(yuyv_to_yvu420sp, 0, 0, 1, 0)
+UNPACK422_ROWS(yuyv_to_yuv420p, 0, 1, 1, 2)
+UNPACK422_ROWS(yuyv_to_yvu420p, 0, 1, 2, 1)
+UNPACK422_ROWS(uyvy_to_yuv420sp, 1, 0, 0, 1)
+UNPACK422_ROWS(uyvy_to_yvu420sp, 1, 0, 1, 0)
+UNPACK422_ROWS(uyvy_to_yuv420p, 1, 1, 1, 2)
+UNPACK422_ROWS(uyvy_to_yvu420p, 1, 1, 2, 1)
+
+/*
+ * Packed 4:2:2 to RGB a row at a time, each pixel pair with the chroma of
+ * its own row. The scalar code reads the samples in place, bpp, a, r, g
+ * and b as in dec_rows().
+ */
+static inline __attribute__((always_inline)) void dec422_rows(
+        const struct csc_job *job, const struct csc_dec_coefs *k,
+        unsigned int h0, unsigned int h1,
+        int first, int bpp, int r, int g, int b, int a) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    int c = 1 - first;
+
+    for (unsigned int h = h0; h < h1; ++h) {
+        const unsigned char *restrict s = src->data[0] + src->stride[0] * h;
+        unsigned char *restrict d = dst->data[0] + dst->stride[0] * h;
+        for (unsigned int w = 0; w < job->width; w += 2) {
+            const unsigned char *p = s + w * 2;
+            unsigned char *q = d + w * bpp;
+            yuv_to_rgb_pixel(k, p[first], p[c], p[c + 2], q + r, q + g,
+                    q + b);
+            yuv_to_rgb_pixel(k, p[first + 2], p[c], p[c + 2], q + r + bpp,
+                    q + g + bpp, q + b + bpp);
+            if (a >= 0)
+                q[a] = q[a + bpp] = 255;
+        }
+    }
+}
+
+/*
+ * The SIMD kernels split each row into a Y and an interleaved chroma line
+ * in scratch, which stay in L1, and decode it as a single 4:2:0 row into
+ * bpp-byte pixels, colour the offset of their colour bytes.
+ */
+static void simd_from_422(const struct csc_simd_kernels *simd,
+        const struct csc_dec_coefs *k, unsigned int first, int bpp,
+        unsigned int colour,
+        const struct csc_job *job, unsigned int h0, unsigned int h1) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    unsigned int width = job->width;
+    unsigned char *y = job_scratch(job, rows_scratch(LAYOUT_PACKED422,
+            LAYOUT_PACKED, width));
+    unsigned char *c = y + width;
+
+    for (unsigned int h = h0; h < h1; ++h) {
+        unsigned char *d = dst->data[0] + dst->stride[0] * h;
+        simd->unpack422_sp_rows(first, src->data[0] + src->stride[0] * h,
+                NULL, y, NULL, c, width);
+        if (bpp == 4)
+            simd->dec_sp_rows4(k, colour, y, NULL, c, d, NULL, width);
+        else
+            simd->dec_sp_rows(k, y, NULL, c, d, NULL, width);
+    }
+}
+
+#define DEC422_ROWS(from, to, first, order, bpp, colour) \
+static void from##_to_##to##_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    const struct csc_dec_coefs *k = \
+            dec_coefs[job->src.matrix][job->src.range]; \
+    const struct csc_simd_kernels *simd = csc_simd_kernels(); \
+    if (simd != NULL) \
+        simd_from_422(simd, &k[order], first, bpp, colour, job, h0, \
+                h1); \
+    else \
+        SCALAR_ROWS(dec422_rows, dec_coefs, job->src, \
+                job, h0, h1, first, PX_##to); \
+}
+
+DEC422_ROWS(yuyv, rgb, 0, ORDER_RGB_UV, 3, 0)
+DEC422_ROWS(yuyv, bgr, 0, ORDER_BGR_UV, 3, 0)
+DEC422_ROWS(yuyv, rgba, 0, ORDER_RGB_UV, 4, 0)
+DEC422_ROWS(yuyv, bgra, 0, ORDER_BGR_UV, 4, 0)
+DEC422_ROWS(yuyv, argb, 0, ORDER_RGB_UV, 4, 1)
+DEC422_ROWS(yuyv, abgr, 0, ORDER_BGR_UV, 4, 1)
+DEC422_ROWS(uyvy, rgb, 1, ORDER_RGB_UV, 3, 0)
+DEC422_ROWS(uyvy, bgr, 1, ORDER_BGR_UV, 3, 0)
+DEC422_ROWS(uyvy, rgba, 1, ORDER_RGB_UV, 4, 0)
+DEC422_ROWS(uyvy, bgra, 1, ORDER_BGR_UV, 4, 0)
+DEC422_ROWS(uyvy, argb, 1, ORDER_RGB_UV, 4, 1)
+DEC422_ROWS(uyvy, abgr, 1, ORDER_BGR_UV, 4, 1)
+
+CROP_ROWS(yuyv_to_rgb, LAYOUT_PACKED422)
+CROP_ROWS(yuyv_to_bgr, LAYOUT_PACKED422)
+CROP4_ROWS(yuyv_to_rgba, LAYOUT_PACKED422)
+CROP4_ROWS(yuyv_to_bgra, LAYOUT_PACKED422)
+CROP4_ROWS(yuyv_to_argb, LAYOUT_PACKED422)
+CROP4_ROWS(yuyv_to_abgr, LAYOUT_PACKED422)
+CROP_ROWS(uyvy_to_rgb, LAYOUT_PACKED422)
+CROP_ROWS(uyvy_to_bgr, LAYOUT_PACKED422)
+CROP4_ROWS(uyvy_to_rgba, LAYOUT_PACKED422)
+CROP4_ROWS(uyvy_to_bgra, LAYOUT_PACKED422)
+CROP4_ROWS(uyvy_to_argb, LAYOUT_PACKED422)
+CROP4_ROWS(uyvy_to_abgr, LAYOUT_PACKED422)
+
+/* YUYV <-> UYVY swaps the two bytes of every pair */
+static void convert_yuyv_uyvy_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    const struct csc_simd_kernels *simd = csc_simd_kernels();
+
+    for (unsigned int h = h0; h < h1; ++h) {
+        unsigned char *row = job->dst.data[0] + job->dst.stride[0] * h;
+        if (simd != NULL) {
+            simd->swap_pairs_row(row, job->width);
+            continue;
+        }
+        for (unsigned int i = 0; i < job->width * 2u; i += 2) {
+            unsigned char c = row[i];
+            row[i] = row[i + 1];
+            row[i + 1] = c;
+        }
+    }
+}
+
+/* Same-format copies, a no-op when dst is src */
+static inline __attribute__((always_inline)) void copy_planes(
+        const struct csc_job *job, unsigned int h0, unsigned int h1,
+        enum plane_layout layout) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    size_t row = (size_t) job->width * pixel_bytes(layout);
+    int interleaved = layout == LAYOUT_SP || layout == LAYOUT_SP16;
+
+    for (unsigned int p = 0; p < 3 && dst->data[p] != NULL; ++p) {
+        if (dst->data[p] == src->data[p])
+            continue;
+        unsigned int r0 = p == 0 ? h0 : h0 / 2, r1 = p == 0 ? h1 : h1 / 2;
+        size_t size = p == 0 || interleaved ? row : row / 2;
+        for (unsigned int r = r0; r < r1; ++r)
+            memcpy(dst->data[p] + dst->stride[p] * r,
+                    src->data[p] + src->stride[p] * r, size);
+    }
+}
+
+static void copy_packed_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    copy_planes(job, h0, h1, LAYOUT_PACKED);
+}
+
+static void copy_packed32_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    copy_planes(job, h0, h1, LAYOUT_PACKED32);
+}
+
+static void copy_packed422_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    copy_planes(job, h0, h1, LAYOUT_PACKED422);
+}
+
+static void copy_sp_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    copy_planes(job, h0, h1, LAYOUT_SP);
+}
+
+static void copy_p_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    copy_planes(job, h0, h1, LAYOUT_P);
+}
+
+/* RGB <-> BGR into another frame: copy a row, then swap it while cached */
+static void rgb_to_bgr_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    for (unsigned int h = h0; h < h1; ++h) {
+        copy_packed_rows(job, h, h + 1);
+        convert_rgb_bgr_rows(job, h, h + 1);
+    }
+}
+
+static void yuyv_to_uyvy_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    for (unsigned int h = h0; h < h1; ++h) {
+        copy_packed422_rows(job, h, h + 1);
+        convert_yuyv_uyvy_rows(job, h, h + 1);
+    }
+}
+
+/*
+ * 16-bit formats: P010 and I010 hold 10-bit samples at bit shift 6 and 0
+ * of their words, RGB48 16-bit channels. 8-bit samples gain two bits on
+ * the way up and lose them with rounding on the way down.
+ */
+static inline unsigned int depth_sample(unsigned int s, int from16,
+        unsigned int sshift, int to16, unsigned int dshift) {
+    if (from16 && to16)
+        return (s >> sshift & 0x3ff) << dshift;
+    if (from16)
+        return csc_narrow(s, sshift + 2);
+    return s << (dshift + 2);
+}
+
+static inline unsigned int load_sample(const unsigned char *p, size_t i,
+        int wide) {
+    return wide ? ((const unsigned short *) p)[i] : p[i];
+}
+
+static inline void store_sample(unsigned char *p, size_t i, int wide,
+        unsigned int s) {
+    if (wide)
+        ((unsigned short *) p)[i] = s;
+    else
+        p[i] = s;
+}
+
+/* count samples step apart, the SIMD kernels take contiguous ones */
+static inline __attribute__((always_inline)) void depth_row(
+        const struct csc_simd_kernels *simd,
+        const unsigned char *src, size_t sstep, int from16,
+        unsigned int sshift, unsigned char *dst, size_t dstep, int to16,
+        unsigned int dshift, unsigned int count) {
+    if (simd != NULL && sstep == 1 && dstep == 1 && from16 && !to16) {
+        simd->narrow_row((const unsigned short *) src, dst, count,
+                sshift + 2);
+        return;
+    }
+    if (simd != NULL && sstep == 1 && dstep == 1 && !from16 && to16) {
+        simd->widen_row(src, (unsigned short *) dst, count, dshift + 2);
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+        store_sample(dst, i * dstep, to16, depth_sample(
+                load_sample(src, i * sstep, from16), from16, sshift,
+                to16, dshift));
+}
+
+/*
+ * 4:2:0 between bit depths, each side given by DEPTH_<format> below:
+ * 16-bit words or bytes, the shift of 16-bit samples, then planar, u and
+ * v as in enc_rows() with offsets counted in samples.
+ */
+static inline __attribute__((always_inline)) void depth_rows(
+        const struct csc_job *job, unsigned int h0, unsigned int h1,
+        int from16, unsigned int sshift, int splanar, int su, int sv,
+        int to16, unsigned int dshift, int dplanar, int du, int dv) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    const struct csc_simd_kernels *simd = csc_simd_kernels();
+    unsigned int width = job->width;
+    size_t ssize = from16 ? 2 : 1, dsize = to16 ? 2 : 1;
+
+    for (unsigned int h = h0; h < h1; ++h) {
+        depth_row(simd, src->data[0] + src->stride[0] * h, 1, from16, sshift,
+                dst->data[0] + dst->stride[0] * h, 1, to16, dshift, width);
+        if (h & 1)
+            continue;
+
+        const unsigned char *s = src->data[1] + src->stride[1] * h / 2;
+        unsigned char *d = dst->data[1] + dst->stride[1] * h / 2;
+        if (!splanar && !dplanar && su == du) {
+            depth_row(simd, s, 1, from16, sshift, d, 1, to16, dshift, width);
+            continue;
+        }
+        if (!splanar && !dplanar && simd != NULL && !to16) {
+            depth_row(simd, s, 1, from16, sshift, d, 1, to16, dshift, width);
+            simd->swap_pairs_row(d, width / 2);
+            continue;
+        }
+
+        const unsigned char *s_u, *s_v;
+        unsigned char *d_u, *d_v;
+        if (splanar) {
+            s_u = src->data[su] + src->stride[su] * h / 2;
+            s_v = src->data[sv] + src->stride[sv] * h / 2;
+        } else {
+            s_u = s + su * ssize;
+            s_v = s + sv * ssize;
+        }
+        if (dplanar) {
+            d_u = dst->data[du] + dst->stride[du] * h / 2;
+            d_v = dst->data[dv] + dst->stride[dv] * h / 2;
+        } else {
+            d_u = d + du * dsize;
+            d_v = d + dv * dsize;
+        }
+        depth_row(simd, s_u, splanar ? 1 : 2, from16, sshift,
+                d_u, dplanar ? 1 : 2, to16, dshift, width / 2);
+        depth_row(simd, s_v, splanar ? 1 : 2, from16, sshift,
+                d_v, dplanar ? 1 : 2, to16, dshift, width / 2);
+    }
+}
+
+#define DEPTH_p010      1, 6, 0, 0, 1
+#define DEPTH_i010      1, 0, 1, 1, 2
+#define DEPTH_yuv420sp  0, 0, 0, 0, 1
+#define DEPTH_yvu420sp  0, 0, 0, 1, 0
+#define DEPTH_yuv420p   0, 0, 1, 1, 2
+#define DEPTH_yvu420p   0, 0, 1, 2, 1
+
+#define DEPTH_ROWS(from, to) \
+static void from##_to_##to##_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    depth_rows(job, h0, h1, DEPTH_##from, DEPTH_##to); \
+}
+
+DEPTH_ROWS(p010, yuv420sp)
+DEPTH_ROWS(p010, yvu420sp)
+DEPTH_ROWS(p010, yuv420p)
+DEPTH_ROWS(p010, yvu420p)
+DEPTH_ROWS(p010, i010)
+DEPTH_ROWS(i010, yuv420sp)
+DEPTH_ROWS(i010, yvu420sp)
+DEPTH_ROWS(i010, yuv420p)
+DEPTH_ROWS(i010, yvu420p)
+DEPTH_ROWS(i010, p010)
+DEPTH_ROWS(yuv420sp, p010)
+DEPTH_ROWS(yvu420sp, p010)
+DEPTH_ROWS(yuv420p, p010)
+DEPTH_ROWS(yvu420p, p010)
+DEPTH_ROWS(yuv420sp, i010)
+DEPTH_ROWS(yvu420sp, i010)
+DEPTH_ROWS(yuv420p, i010)
+DEPTH_ROWS(yvu420p, i010)
+
+/* The 10-bit sums are those of the 8-bit tables in 1/1024ths of a step */
+static inline void yuv10_to_rgb_pixel(const struct csc_dec_coefs *k,
+        int y, int u, int v, int wide, unsigned char *d,
+        int r, int g, int b) {
+    int r_val = k->y * y + k->c[0][0] * u + k->c[1][0] * v + k->off[0] * 4;
+    int g_val = k->y * y + k->c[0][1] * u + k->c[1][1] * v + k->off[1] * 4;
+    int b_val = k->y * y + k->c[0][2] * u + k->c[1][2] * v + k->off[2] * 4;
+    if (wide) {
+        store_sample(d, r, 1, clip_value((r_val >> 2) + (r_val >> 10),
+                0, 65535));
+        store_sample(d, g, 1, clip_value((g_val >> 2) + (g_val >> 10),
+                0, 65535));
+        store_sample(d, b, 1, clip_value((b_val >> 2) + (b_val >> 10),
+                0, 65535));
+    } else {
+        d[r] = clip_value(r_val >> 10, 0, 255);
+        d[g] = clip_value(g_val >> 10, 0, 255);
+        d[b] = clip_value(b_val >> 10, 0, 255);
+    }
+}
+
+/* 8-bit channels are weighted as in 8.8 fixed point, 16-bit ones in 8.16 */
+static inline unsigned int rgb_to_yuv10_sample(const short w[3],
+        unsigned int r, unsigned int g, unsigned int b, int wide, int off) {
+    int sum = w[0] * (int) r + w[1] * (int) g + w[2] * (int) b;
+    return clip_value((sum >> (wide ? 14 : 6)) + off, 0, 1023);
+}
+
+/*
+ * Scalar 10-bit kernels like dec_rows() and enc_rows(): shift is that of
+ * the 16-bit samples, wide selects RGB48 over 3-byte pixels and r, g, b
+ * are channel indices. The chroma is interleaved (P010) unless planar.
+ */
+static inline __attribute__((always_inline)) void dec10_rows(
+        const struct csc_job *job, const struct csc_dec_coefs *k,
+        unsigned int h0, unsigned int h1, unsigned int shift, int wide,
+        int r, int g, int b, int planar) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    unsigned int width = job->width;
+    size_t cstep = planar ? 1 : 2, bpp = wide ? 6 : 3;
+
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *y0 = src->data[0] + src->stride[0] * h;
+        const unsigned char *y1 = y0 + src->stride[0];
+        const unsigned char *c = src->data[1] + src->stride[1] * h / 2;
+        const unsigned char *u_row = c, *v_row = c + 2;
+        if (planar)
+            v_row = src->data[2] + src->stride[2] * h / 2;
+        unsigned char *d0 = dst->data[0] + dst->stride[0] * h;
+        unsigned char *d1 = d0 + dst->stride[0];
+
+        for (unsigned int w = 0; w < width; w += 2) {
+            int cu = load_sample(u_row, w / 2 * cstep, 1) >> shift & 0x3ff;
+            int cv = load_sample(v_row, w / 2 * cstep, 1) >> shift & 0x3ff;
+            yuv10_to_rgb_pixel(k, load_sample(y0, w, 1) >> shift & 0x3ff,
+                    cu, cv, wide, d0 + w * bpp, r, g, b);
+            yuv10_to_rgb_pixel(k, load_sample(y0, w + 1, 1) >> shift & 0x3ff,
+                    cu, cv, wide, d0 + (w + 1) * bpp, r, g, b);
+            yuv10_to_rgb_pixel(k, load_sample(y1, w, 1) >> shift & 0x3ff,
+                    cu, cv, wide, d1 + w * bpp, r, g, b);
+            yuv10_to_rgb_pixel(k, load_sample(y1, w + 1, 1) >> shift & 0x3ff,
+                    cu, cv, wide, d1 + (w + 1) * bpp, r, g, b);
+        }
+    }
+}
+
+static inline __attribute__((always_inline)) void enc10_rows(
+        const struct csc_job *job, const struct csc_enc_coefs *k,
+        unsigned int h0, unsigned int h1, unsigned int shift, int wide,
+        int r, int g, int b, int planar) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    unsigned int width = job->width;
+    size_t cstep = planar ? 1 : 2, bpp = wide ? 6 : 3;
+
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *p0 = src->data[0] + src->stride[0] * h;
+        const unsigned char *p1 = p0 + src->stride[0];
+        unsigned char *y0 = dst->data[0] + dst->stride[0] * h;
+        unsigned char *y1 = y0 + dst->stride[0];
+        unsigned char *c = dst->data[1] + dst->stride[1] * h / 2;
+        unsigned char *u_row = c, *v_row = c + 2;
+        if (planar)
+            v_row = dst->data[2] + dst->stride[2] * h / 2;
+
+        for (unsigned int w = 0; w < width; w += 2) {
+            for (unsigned int i = 0; i < 4; ++i) {
+                const unsigned char *p = (i < 2 ? p0 : p1) +
+                        (w + i % 2) * bpp;
+                unsigned int pr = load_sample(p, r, wide);
+                unsigned int pg = load_sample(p, g, wide);
+                unsigned int pb = load_sample(p, b, wide);
+                store_sample(i < 2 ? y0 : y1, w + i % 2, 1,
+                        rgb_to_yuv10_sample(k->y, pr, pg, pb, wide,
+                        k->y_off * 4) << shift);
+                if (i != 0)
+                    continue;
+                store_sample(u_row, w / 2 * cstep, 1, rgb_to_yuv10_sample(
+                        k->c[0], pr, pg, pb, wide, 512) << shift);
+                store_sample(v_row, w / 2 * cstep, 1, rgb_to_yuv10_sample(
+                        k->c[1], pr, pg, pb, wide, 512) << shift);
+            }
+        }
+    }
+}
+
+static void simd_from_yuv10(const struct csc_simd_kernels *simd,
+        const struct csc_dec_coefs *k, unsigned int shift, int wide,
+        int planar, const struct csc_job *job, unsigned int h0,
+        unsigned int h1) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned short *y0 = (const unsigned short *)
+                (src->data[0] + src->stride[0] * h);
+        const unsigned short *y1 = (const unsigned short *)
+                (src->data[0] + src->stride[0] * (h + 1));
+        const unsigned short *c0 = (const unsigned short *)
+                (src->data[1] + src->stride[1] * h / 2);
+        const unsigned short *c1 = planar ? (const unsigned short *)
+                (src->data[2] + src->stride[2] * h / 2) : NULL;
+        unsigned char *row = dst->data[0] + dst->stride[0] * h;
+        unsigned short *w0 = (unsigned short *) row;
+        unsigned short *w1 = (unsigned short *) (row + dst->stride[0]);
+        if (wide && planar)
+            simd->dec10_p_rows48(k, shift, y0, y1, c0, c1, w0, w1,
+                    job->width);
+        else if (wide)
+            simd->dec10_sp_rows48(k, shift, y0, y1, c0, w0, w1,
+                    job->width);
+        else if (planar)
+            simd->dec10_p_rows(k, shift, y0, y1, c0, c1,
+                    row, row + dst->stride[0], job->width);
+        else
+            simd->dec10_sp_rows(k, shift, y0, y1, c0,
+                    row, row + dst->stride[0], job->width);
+    }
+}
+
+static void simd_to_yuv10(const struct csc_simd_kernels *simd,
+        const struct csc_enc_coefs *k, unsigned int shift, int wide,
+        int planar, const struct csc_job *job, unsigned int h0,
+        unsigned int h1) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    for (unsigned int h = h0; h < h1; h += 2) {
+        const unsigned char *row = src->data[0] + src->stride[0] * h;
+        unsigned short *y0 = (unsigned short *)
+                (dst->data[0] + dst->stride[0] * h);
+        unsigned short *y1 = (unsigned short *)
+                (dst->data[0] + dst->stride[0] * (h + 1));
+        unsigned short *c0 = (unsigned short *)
+                (dst->data[1] + dst->stride[1] * h / 2);
+        unsigned short *c1 = planar ? (unsigned short *)
+                (dst->data[2] + dst->stride[2] * h / 2) : NULL;
+        const unsigned short *w0 = (const unsigned short *) row;
+        const unsigned short *w1 = (const unsigned short *)
+                (row + src->stride[0]);
+        if (wide && planar)
+            simd->enc10_p_row48(k, shift, w0, y0, c0, c1, job->width);
+        else if (wide)
+            simd->enc10_sp_row48(k, shift, w0, y0, c0, job->width);
+        else if (planar)
+            simd->enc10_p_row(k, shift, row, y0, c0, c1, job->width);
+        else
+            simd->enc10_sp_row(k, shift, row, y0, c0, job->width);
+        if (wide)
+            simd->enc10_y_row48(k, shift, w1, y1, job->width);
+        else
+            simd->enc10_y_row(k, shift, row + src->stride[0], y1,
+                    job->width);
+    }
+}
+
+#define DEC10_ROWS(name, order, shift, wide, r, g, b, planar) \
+static void name##_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    const struct csc_dec_coefs *k = \
+            dec_coefs[job->src.matrix][job->src.range]; \
+    const struct csc_simd_kernels *simd = csc_simd_kernels(); \
+    if (simd != NULL) \
+        simd_from_yuv10(simd, &k[order], shift, wide, planar, job, \
+                h0, h1); \
+    else \
+        SCALAR_ROWS(dec10_rows, dec_coefs, job->src, \
+                job, h0, h1, shift, wide, r, g, b, planar); \
+}
+
+#define ENC10_ROWS(name, order, shift, wide, r, g, b, planar) \
+static void name##_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    const struct csc_enc_coefs *k = \
+            enc_coefs[job->dst.matrix][job->dst.range]; \
+    const struct csc_simd_kernels *simd = csc_simd_kernels(); \
+    if (simd != NULL) \
+        simd_to_yuv10(simd, &k[order], shift, wide, planar, job, \
+                h0, h1); \
+    else \
+        SCALAR_ROWS(enc10_rows, enc_coefs, job->dst, \
+                job, h0, h1, shift, wide, r, g, b, planar); \
+}
+
+DEC10_ROWS(p010_to_rgb, ORDER_RGB_UV, 6, 0, 0, 1, 2, 0)
+DEC10_ROWS(p010_to_bgr, ORDER_BGR_UV, 6, 0, 2, 1, 0, 0)
+DEC10_ROWS(p010_to_rgb48, ORDER_RGB_UV, 6, 1, 0, 1, 2, 0)
+DEC10_ROWS(i010_to_rgb, ORDER_RGB_UV, 0, 0, 0, 1, 2, 1)
+DEC10_ROWS(i010_to_bgr, ORDER_BGR_UV, 0, 0, 2, 1, 0, 1)
+DEC10_ROWS(i010_to_rgb48, ORDER_RGB_UV, 0, 1, 0, 1, 2, 1)
+
+ENC10_ROWS(rgb_to_p010, ORDER_RGB_UV, 6, 0, 0, 1, 2, 0)
+ENC10_ROWS(bgr_to_p010, ORDER_BGR_UV, 6, 0, 2, 1, 0, 0)
+ENC10_ROWS(rgb48_to_p010, ORDER_RGB_UV, 6, 1, 0, 1, 2, 0)
+ENC10_ROWS(rgb_to_i010, ORDER_RGB_UV, 0, 0, 0, 1, 2, 1)
+ENC10_ROWS(bgr_to_i010, ORDER_BGR_UV, 0, 0, 2, 1, 0, 1)
+ENC10_ROWS(rgb48_to_i010, ORDER_RGB_UV, 0, 1, 0, 1, 2, 1)
+
+#define CROP48_ROWS(name, layout) \
+static void name##_crop_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    crop_rows(job, h0, h1, layout, LAYOUT_PACKED48, name##_rows); \
+}
+
+CROP_ROWS(p010_to_rgb, LAYOUT_SP16)
+CROP_ROWS(p010_to_bgr, LAYOUT_SP16)
+CROP48_ROWS(p010_to_rgb48, LAYOUT_SP16)
+CROP_ROWS(i010_to_rgb, LAYOUT_P16)
+CROP_ROWS(i010_to_bgr, LAYOUT_P16)
+CROP48_ROWS(i010_to_rgb48, LAYOUT_P16)
+
+/*
+ * RGB48 <-> 3-byte pixels: words round to the nearest of the 255 steps
+ * and bytes scale by 257, so a byte survives the round trip.
+ */
+static inline __attribute__((always_inline)) void rgb48_rows(
+        const struct csc_job *job, unsigned int h0, unsigned int h1,
+        int from48, int swap) {
+    const csc_frame *src = &job->src, *dst = &job->dst;
+    size_t count = (size_t) job->width * 3;
+
+    for (unsigned int h = h0; h < h1; ++h) {
+        const unsigned char *s = src->data[0] + src->stride[0] * h;
+        unsigned char *d = dst->data[0] + dst->stride[0] * h;
+        for (size_t i = 0; i < count; ++i) {
+            size_t at = swap ? i / 3 * 3 + 2 - i % 3 : i;
+            unsigned int v = load_sample(s, at, from48);
+            store_sample(d, i, !from48,
+                    from48 ? (v * 255 + 32767) / 65535 : v * 257);
+        }
+    }
+}
+
+#define RGB48_ROWS(name, from48, swap) \
+static void name##_rows(const struct csc_job *job, \
+        unsigned int h0, unsigned int h1) { \
+    rgb48_rows(job, h0, h1, from48, swap); \
+}
+
+RGB48_ROWS(rgb48_to_rgb, 1, 0)
+RGB48_ROWS(rgb48_to_bgr, 1, 1)
+RGB48_ROWS(rgb_to_rgb48, 0, 0)
+RGB48_ROWS(bgr_to_rgb48, 0, 1)
+
+static void copy_sp16_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    copy_planes(job, h0, h1, LAYOUT_SP16);
+}
+
+static void copy_p16_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    copy_planes(job, h0, h1, LAYOUT_P16);
+}
+
+static void copy_packed48_rows(const struct csc_job *job,
+        unsigned int h0, unsigned int h1) {
+    copy_planes(job, h0, h1, LAYOUT_PACKED48);
+}
+
+struct conversion {
+    csc_rows_fn rows;
+    csc_rows_fn crop;       /* decoders only, see run_roi() */
+    csc_rows_fn scaled;
+    csc_rows_fn swap;       /* in place when dst is src */
+};
+
+#define DEC(name)   { name##_rows, name##_crop_rows, name##_scaled_rows, NULL }
+#define ENC(name)   { name##_rows, NULL, name##_scaled_rows, NULL }
+#define YUV(name)   { name##_rows, NULL, NULL, NULL }
+#define SWAP(name, swap)    { name##_rows, NULL, NULL, swap##_rows }
+#define DEC_CROP(name)      { name##_rows, name##_crop_rows, NULL, NULL }
+
+static const struct conversion conversions[CSC_FORMAT_COUNT]
+        [CSC_FORMAT_COUNT] = {
+    [CSC_FORMAT_RGB24] = {
+        [CSC_FORMAT_RGB24]  = YUV(copy_packed),
+        [CSC_FORMAT_BGR24]  = SWAP(rgb_to_bgr, convert_rgb_bgr),
+        [CSC_FORMAT_NV12]   = ENC(rgb_to_yuv420sp),
+        [CSC_FORMAT_NV21]   = ENC(rgb_to_yvu420sp),
+        [CSC_FORMAT_I420]   = ENC(rgb_to_yuv420p),
+        [CSC_FORMAT_YV12]   = ENC(rgb_to_yvu420p),
+        [CSC_FORMAT_RGBA32] = YUV(rgb_to_rgba),
+        [CSC_FORMAT_BGRA32] = YUV(rgb_to_bgra),
+        [CSC_FORMAT_ARGB32] = YUV(rgb_to_argb),
+        [CSC_FORMAT_ABGR32] = YUV(rgb_to_abgr),
+        [CSC_FORMAT_P010]   = YUV(rgb_to_p010),
+        [CSC_FORMAT_I010]   = YUV(rgb_to_i010),
+        [CSC_FORMAT_RGB48]  = YUV(rgb_to_rgb48),
+    },
+    [CSC_FORMAT_BGR24] = {
+        [CSC_FORMAT_RGB24]  = SWAP(rgb_to_bgr, convert_rgb_bgr),
+        [CSC_FORMAT_BGR24]  = YUV(copy_packed),
+        [CSC_FORMAT_NV12]   = ENC(bgr_to_yuv420sp),
+        [CSC_FORMAT_NV21]   = ENC(bgr_to_yvu420sp),
+        [CSC_FORMAT_I420]   = ENC(bgr_to_yuv420p),
+        [CSC_FORMAT_YV12]   = ENC(bgr_to_yvu420p),
+        [CSC_FORMAT_RGBA32] = YUV(bgr_to_rgba),
+        [CSC_FORMAT_BGRA32] = YUV(bgr_to_bgra),
+        [CSC_FORMAT_ARGB32] = YUV(bgr_to_argb),
+        [CSC_FORMAT_ABGR32] = YUV(bgr_to_abgr),
+        [CSC_FORMAT_P010]   = YUV(bgr_to_p010),
+        [CSC_FORMAT_I010]   = YUV(bgr_to_i010),
+        [CSC_FORMAT_RGB48]  = YUV(bgr_to_rgb48),
+    },
+    [CSC_FORMAT_NV12] = {
+        [CSC_FORMAT_RGB24]  = DEC(yuv420sp_to_rgb),
+        [CSC_FORMAT_BGR24]  = DEC(yuv420sp_to_bgr),
+        [CSC_FORMAT_NV12]   = YUV(copy_sp),
+        [CSC_FORMAT_NV21]   = SWAP(yuv420sp_to_yvu420sp,
+                convert_yuv420sp_yvu420sp),
+        [CSC_FORMAT_I420]   = YUV(yuv420sp_to_yuv420p),
+        [CSC_FORMAT_YV12]   = YUV(yuv420sp_to_yvu420p),
+        [CSC_FORMAT_RGBA32] = DEC(yuv420sp_to_rgba),
+        [CSC_FORMAT_BGRA32] = DEC(yuv420sp_to_bgra),
+        [CSC_FORMAT_ARGB32] = DEC(yuv420sp_to_argb),
+        [CSC_FORMAT_ABGR32] = DEC(yuv420sp_to_abgr),
+        [CSC_FORMAT_P010]   = YUV(yuv420sp_to_p010),
+        [CSC_FORMAT_I010]   = YUV(yuv420sp_to_i010),
+    },
+    [CSC_FORMAT_NV21] = {
+        [CSC_FORMAT_RGB24]  = DEC(yvu420sp_to_rgb),
+        [CSC_FORMAT_BGR24]  = DEC(yvu420sp_to_bgr),
+        [CSC_FORMAT_NV12]   = SWAP(yuv420sp_to_yvu420sp,
+                convert_yuv420sp_yvu420sp),
+        [CSC_FORMAT_NV21]   = YUV(copy_sp),
+        [CSC_FORMAT_I420]   = YUV(yuv420sp_to_yvu420p),
+        [CSC_FORMAT_YV12]   = YUV(yuv420sp_to_yuv420p),
+        [CSC_FORMAT_RGBA32] = DEC(yvu420sp_to_rgba),
+        [CSC_FORMAT_BGRA32] = DEC(yvu420sp_to_bgra),
+        [CSC_FORMAT_ARGB32] = DEC(yvu420sp_to_argb),
+        [CSC_FORMAT_ABGR32] = DEC(yvu420sp_to_abgr),
+        [CSC_FORMAT_P010]   = YUV(yvu420sp_to_p010),
+        [CSC_FORMAT_I010]   = YUV(yvu420sp_to_i010),
+    },
+    [CSC_FORMAT_I420] = {
+        [CSC_FORMAT_RGB24]  = DEC(yuv420p_to_rgb),
+        [CSC_FORMAT_BGR24]  = DEC(yuv420p_to_bgr),
+        [CSC_FORMAT_NV12]   = YUV(yuv420p_to_yuv420sp),
+        [CSC_FORMAT_NV21]   = YUV(yuv420p_to_yvu420sp),
+        [CSC_FORMAT_I420]   = YUV(copy_p),
+        [CSC_FORMAT_YV12]   = SWAP(yuv420p_to_yvu420p, convert_yuv420p_yvu420p),
+        [CSC_FORMAT_RGBA32] = DEC(yuv420p_to_rgba),
+        [CSC_FORMAT_BGRA32] = DEC(yuv420p_to_bgra),
+        [CSC_FORMAT_ARGB32] = DEC(yuv420p_to_argb),
+        [CSC_FORMAT_ABGR32] = DEC(yuv420p_to_abgr),
+        [CSC_FORMAT_P010]   = YUV(yuv420p_to_p010),
+        [CSC_FORMAT_I010]   = YUV(yuv420p_to_i010),
+    },
+    [CSC_FORMAT_YV12] = {
+        [CSC_FORMAT_RGB24]  = DEC(yvu420p_to_rgb),
+        [CSC_FORMAT_BGR24]  = DEC(yvu420p_to_bgr),
+        [CSC_FORMAT_NV12]   = YUV(yuv420p_to_yvu420sp),
+        [CSC_FORMAT_NV21]   = YUV(yuv420p_to_yuv420sp),
+        [CSC_FORMAT_I420]   = SWAP(yuv420p_to_yvu420p, convert_yuv420p_yvu420p),
+        [CSC_FORMAT_YV12]   = YUV(copy_p),
+        [CSC_FORMAT_RGBA32] = DEC(yvu420p_to_rgba),
+        [CSC_FORMAT_BGRA32] = DEC(yvu420p_to_bgra),
+        [CSC_FORMAT_ARGB32] = DEC(yvu420p_to_argb),
+        [CSC_FORMAT_ABGR32] = DEC(yvu420p_to_abgr),
+        [CSC_FORMAT_P010]   = YUV(yvu420p_to_p010),
+        [CSC_FORMAT_I010]   = YUV(yvu420p_to_i010),
+    },
+    [CSC_FORMAT_RGBA32] = {
+        [CSC_FORMAT_RGB24]  = YUV(rgba_to_rgb),
+        [CSC_FORMAT_BGR24]  = YUV(rgba_to_bgr),
+        [CSC_FORMAT_NV12]   = ENC(rgba_to_yuv420sp),
+        [CSC_FORMAT_NV21]   = ENC(rgba_to_yvu420sp),
+        [CSC_FORMAT_I420]   = ENC(rgba_to_yuv420p),
+        [CSC_FORMAT_YV12]   = ENC(rgba_to_yvu420p),
+        [CSC_FORMAT_RGBA32] = YUV(copy_packed32),
+        [CSC_FORMAT_BGRA32] = SWAP(rgba_to_bgra, rgba_to_bgra),
+        [CSC_FORMAT_ARGB32] = SWAP(rgba_to_argb, rgba_to_argb),
+        [CSC_FORMAT_ABGR32] = SWAP(rgba_to_abgr, rgba_to_abgr),
+    },
+    [CSC_FORMAT_BGRA32] = {
+        [CSC_FORMAT_RGB24]  = YUV(bgra_to_rgb),
+        [CSC_FORMAT_BGR24]  = YUV(bgra_to_bgr),
+        [CSC_FORMAT_NV12]   = ENC(bgra_to_yuv420sp),
+        [CSC_FORMAT_NV21]   = ENC(bgra_to_yvu420sp),
+        [CSC_FORMAT_I420]   = ENC(bgra_to_yuv420p),
+        [CSC_FORMAT_YV12]   = ENC(bgra_to_yvu420p),
+        [CSC_FORMAT_RGBA32] = SWAP(bgra_to_rgba, bgra_to_rgba),
+        [CSC_FORMAT_BGRA32] = YUV(copy_packed32),
+        [CSC_FORMAT_ARGB32] = SWAP(bgra_to_argb, bgra_to_argb),
+        [CSC_FORMAT_ABGR32] = SWAP(bgra_to_abgr, bgra_to_abgr),
+    },
+    [CSC_FORMAT_ARGB32] = {
+        [CSC_FORMAT_RGB24]  = YUV(argb_to_rgb),
+        [CSC_FORMAT_BGR24]  = YUV(argb_to_bgr),
+        [CSC_FORMAT_NV12]   = ENC(argb_to_yuv420sp),
+        [CSC_FORMAT_NV21]   = ENC(argb_to_yvu420sp),
+        [CSC_FORMAT_I420]   = ENC(argb_to_yuv420p),
+        [CSC_FORMAT_YV12]   = ENC(argb_to_yvu420p),
+        [CSC_FORMAT_RGBA32] = SWAP(argb_to_rgba, argb_to_rgba),
+        [CSC_FORMAT_BGRA32] = SWAP(argb_to_bgra, argb_to_bgra),
+        [CSC_FORMAT_ARGB32] = YUV(copy_packed32),
+        [CSC_FORMAT_ABGR32] = SWAP(argb_to_abgr, argb_to_abgr),
+    },
+    [CSC_FORMAT_ABGR32] = {
+        [CSC_FORMAT_RGB24]  = YUV(abgr_to_rgb),
+        [CSC_FORMAT_BGR24]  = YUV(abgr_to_bgr),
+        [CSC_FORMAT_NV12]   = ENC(abgr_to_yuv420sp),
+        [CSC_FORMAT_NV21]   = ENC(abgr_to_yvu420sp),
+        [CSC_FORMAT_I420]   = ENC(abgr_to_yuv420p),
+        [CSC_FORMAT_YV12]   = ENC(abgr_to_yvu420p),
+        [CSC_FORMAT_RGBA32] = SWAP(abgr_to_rgba, abgr_to_rgba),
+        [CSC_FORMAT_BGRA32] = SWAP(abgr_to_bgra, abgr_to_bgra),
+        [CSC_FORMAT_ARGB32] = SWAP(abgr_to_argb, abgr_to_argb),
+        [CSC_FORMAT_ABGR32] = YUV(copy_packed32),
+    },
+    [CSC_FORMAT_YUYV] = {
+        [CSC_FORMAT_RGB24]  = DEC_CROP(yuyv_to_rgb),
+        [CSC_FORMAT_BGR24]  = DEC_CROP(yuyv_to_bgr),
+        [CSC_FORMAT_NV12]   = YUV(yuyv_to_yuv420sp),
+        [CSC_FORMAT_NV21]   = YUV(yuyv_to_yvu420sp),
+        [CSC_FORMAT_I420]   = YUV(yuyv_to_yuv420p),
+        [CSC_FORMAT_YV12]   = YUV(yuyv_to_yvu420p),
+        [CSC_FORMAT_RGBA32] = DEC_CROP(yuyv_to_rgba),
+        [CSC_FORMAT_BGRA32] = DEC_CROP(yuyv_to_bgra),
+        [CSC_FORMAT_ARGB32] = DEC_CROP(yuyv_to_argb),
+        [CSC_FORMAT_ABGR32] = DEC_CROP(yuyv_to_abgr),
+        [CSC_FORMAT_YUYV]   = YUV(copy_packed422),
+        [CSC_FORMAT_UYVY]   = SWAP(yuyv_to_uyvy, convert_yuyv_uyvy),
+    },
+    [CSC_FORMAT_UYVY] = {
+        [CSC_FORMAT_RGB24]  = DEC_CROP(uyvy_to_rgb),
+        [CSC_FORMAT_BGR24]  = DEC_CROP(uyvy_to_bgr),
+        [CSC_FORMAT_NV12]   = YUV(uyvy_to_yuv420sp),
+        [CSC_FORMAT_NV21]   = YUV(uyvy_to_yvu420sp),
+        [CSC_FORMAT_I420]   = YUV(uyvy_to_yuv420p),
+        [CSC_FORMAT_YV12]   = YUV(uyvy_to_yvu420p),
+        [CSC_FORMAT_RGBA32] = DEC_CROP(uyvy_to_rgba),
+        [CSC_FORMAT_BGRA32] = DEC_CROP(uyvy_to_bgra),
+        [CSC_FORMAT_ARGB32] = DEC_CROP(uyvy_to_argb),
+        [CSC_FORMAT_ABGR32] = DEC_CROP(uyvy_to_abgr),
+        [CSC_FORMAT_YUYV]   = SWAP(yuyv_to_uyvy, convert_yuyv_uyvy),
+        [CSC_FORMAT_UYVY]   = YUV(copy_packed422),
+    },
+    [CSC_FORMAT_P010] = {
+        [CSC_FORMAT_RGB24]  = DEC_CROP(p010_to_rgb),
+        [CSC_FORMAT_BGR24]  = DEC_CROP(p010_to_bgr),
+        [CSC_FORMAT_NV12]   = YUV(p010_to_yuv420sp),
+        [CSC_FORMAT_NV21]   = YUV(p010_to_yvu420sp),
+        [CSC_FORMAT_I420]   = YUV(p010_to_yuv420p),
+        [CSC_FORMAT_YV12]   = YUV(p010_to_yvu420p),
+        [CSC_FORMAT_P010]   = YUV(copy_sp16),
+        [CSC_FORMAT_I010]   = YUV(p010_to_i010),
+        [CSC_FORMAT_RGB48]  = DEC_CROP(p010_to_rgb48),
+    },
+    [CSC_FORMAT_I010] = {
+        [CSC_FORMAT_RGB24]  = DEC_CROP(i010_to_rgb),
+        [CSC_FORMAT_BGR24]  = DEC_CROP(i010_to_bgr),
+        [CSC_FORMAT_NV12]   = YUV(i010_to_yuv420sp),
+        [CSC_FORMAT_NV21]   = YUV(i010_to_yvu420sp),
+        [CSC_FORMAT_I420]   = YUV(i010_to_yuv420p),
+        [CSC_FORMAT_YV12]   = YUV(i010_to_yvu420p),
+        [CSC_FORMAT_P010]   = YUV(i010_to_p010),
+        [CSC_FORMAT_I010]   = YUV(copy_p16),
+        [CSC_FORMAT_RGB48]  = DEC_CROP(i010_to_rgb48),
+    },
+    [CSC_FORMAT_RGB48] = {
+        [CSC_FORMAT_RGB24]  = YUV(rgb48_to_rgb),
+        [CSC_FORMAT_BGR24]  = YUV(rgb48_to_bgr),
+        [CSC_FORMAT_P010]   = YUV(rgb48_to_p010),
+        [CSC_FORMAT_I010]   = YUV(rgb48_to_i010),
+        [CSC_FORMAT_RGB48]  = YUV(copy_packed48),
+    },
+};
+
+static const enum plane_layout format_layouts[CSC_FORMAT_COUNT] = {
+    [CSC_FORMAT_RGB24]  = LAYOUT_PACKED,
+    [CSC_FORMAT_BGR24]  = LAYOUT_PACKED,
+    [CSC_FORMAT_NV12]   = LAYOUT_SP,
+    [CSC_FORMAT_NV21]   = LAYOUT_SP,
+    [CSC_FORMAT_I420]   = LAYOUT_P,
+    [CSC_FORMAT_YV12]   = LAYOUT_P,
+    [CSC_FORMAT_RGBA32] = LAYOUT_PACKED32,
+    [CSC_FORMAT_BGRA32] = LAYOUT_PACKED32,
+    [CSC_FORMAT_ARGB32] = LAYOUT_PACKED32,
+    [CSC_FORMAT_ABGR32] = LAYOUT_PACKED32,
+    [CSC_FORMAT_YUYV]   = LAYOUT_PACKED422,
+    [CSC_FORMAT_UYVY]   = LAYOUT_PACKED422,
+    [CSC_FORMAT_P010]   = LAYOUT_SP16,
+    [CSC_FORMAT_I010]   = LAYOUT_P16,
+    [CSC_FORMAT_RGB48]  = LAYOUT_PACKED48,
+};
+
+#ifdef CSC_STATS
+/* The first pair using a row function stands for all that share it */
+void csc_job_formats(const struct csc_job *job, int *src, int *dst) {
+    csc_rows_fn rows = job->rows == stream_rows ||
+            job->rows == resize_rows ? job->inner : job->rows;
+
+    for (int s = 0; s < CSC_FORMAT_COUNT; ++s) {
+        for (int t = 0; t < CSC_FORMAT_COUNT; ++t) {
+            const struct conversion *conv = &conversions[s][t];
+            if (rows == conv->rows || rows == conv->crop ||
+                    rows == conv->scaled || rows == conv->swap) {
+                *src = s;
+                *dst = t;
+                return;
+            }
+        }
+    }
+
+    *src = *dst = -1;
+}
+#endif
+
+struct csc_plan {
+    const struct conversion *conv;
+    enum plane_layout src_layout, dst_layout;
+    unsigned int width, height;
+    csc_ctx *ctx;
+    unsigned int factor;
+    int has_roi;
+    csc_rect roi;
+    unsigned int out_width, out_height;
+    struct tap *taps;           /* of the resize, made with the plan */
+    unsigned int flags;
+};
+
+static int format_valid(int format) {
+    return format >= 0 && format < CSC_FORMAT_COUNT;
+}
+
+size_t csc_frame_init(csc_frame *frame, int format,
+        unsigned char *buf, unsigned short width, unsigned short height) {
+    return csc_frame_init_large(frame, format, buf, width, height);
+}
+
+/* Up to 8 bytes a pixel, a row's bytes still fit in an unsigned int */
+#define MAX_SIDE    (UINT_MAX / 8)
+
+static int size_valid(size_t width, size_t height) {
+    return width <= MAX_SIDE && height <= MAX_SIDE &&
+            (height == 0 || width <= SIZE_MAX / 8 / height);
+}
+
+size_t csc_frame_init_large(csc_frame *frame, int format,
+        unsigned char *buf, size_t width, size_t height) {
+    if (!format_valid(format) || !size_valid(width, height))
+        return 0;
+
+    if (frame != NULL)
+        tight_frame(frame, format_layouts[format], buf, width, height);
+
+    return frame_size(format_layouts[format], width, height);
+}
+
+static int plan_init(csc_plan *plan, int src_format, int dst_format,
+        unsigned int width, unsigned int height, const csc_opts *opts) {
+    if (!format_valid(src_format) || !format_valid(dst_format))
+        return -1;
+
+    memset(plan, 0, sizeof(*plan));
+    plan->conv = &conversions[src_format][dst_format];
+    if (plan->conv->rows == NULL)
+        return -1;
+
+    plan->src_layout = format_layouts[src_format];
+    plan->dst_layout = format_layouts[dst_format];
+    plan->width = width;
+    plan->height = height;
+
+    if (opts != NULL) {
+        plan->ctx = opts->ctx;
+        plan->factor = opts->factor;
+        if (opts->roi != NULL) {
+            plan->has_roi = 1;
+            plan->roi = *opts->roi;
+        }
+        plan->out_width = opts->out_width;
+        plan->out_height = opts->out_height;
+        plan->flags = opts->flags;
+    }
+
+    if (plan->factor != 0 && (plan->conv->scaled == NULL || plan->has_roi))
+        return -1;
+
+    if ((plan->out_width | plan->out_height) != 0 &&
+            ((plan->src_layout != LAYOUT_SP && plan->src_layout != LAYOUT_P) ||
+            plan->factor != 0 || plan->has_roi ||
+            plan->out_width == 0 || plan->out_height == 0 ||
+            !size_valid(plan->out_width, plan->out_height) ||
+            ((plan->out_width | plan->out_height) & 1)))
+        return -1;
+
+    if (plan->out_width != 0) {
+        plan->taps = resize_taps(plan->out_width, plan->out_height,
+                plan->width, plan->height);
+        if (plan->taps == NULL)
+            return -1;
+    }
+
+    return 0;
+}
+
+/* Free what plan_init() allocated */
+static void plan_free(csc_plan *plan) {
+    free(plan->taps);
+}
+
+static int plan_job(const csc_plan *plan, const csc_frame *src,
+        const csc_frame *dst, struct csc_job *job) {
+    const struct conversion *conv = plan->conv;
+    int in_place = conv->swap != NULL && src != NULL && dst != NULL &&
+            src->data[0] == dst->data[0];
+
+    if (plan->factor != 0)
+        return scaled_job(job, conv->scaled, plan->src_layout, src,
+                plan->dst_layout, dst, plan->width, plan->height,
+                plan->factor);
+    if (plan->out_width != 0)
+        return resized_job(job, conv->rows, plan->src_layout, src,
+                plan->dst_layout, dst, plan->width, plan->height,
+                plan->out_width, plan->out_height, plan->taps);
+
+    if (in_place && plan->has_roi)
+        return roi_in_place_job(job, conv->swap, plan->src_layout,
+                src, plan->width, plan->height, &plan->roi);
+    if (in_place)
+        return frames_job(job, conv->swap, plan->src_layout, src,
+                plan->dst_layout, dst, plan->width, plan->height);
+    if (plan->has_roi)
+        return roi_job(job, conv->rows, conv->crop, plan->src_layout,
+                src, plan->dst_layout, dst, plan->width, plan->height,
+                &plan->roi);
+
+    if (frames_job(job, conv->rows, plan->src_layout, src,
+            plan->dst_layout, dst, plan->width, plan->height) != 0)
+        return -1;
+    if (plan->flags & CSC_OPT_STREAM)
+        stream_job(job, plan->src_layout, plan->dst_layout);
+
+    return 0;
+}
+
+int csc_plan_job(const csc_plan *plan, const csc_frame *src,
+        const csc_frame *dst, struct csc_job *job) {
+    if (plan == NULL)
+        return -1;
+
+    return plan_job(plan, src, dst, job);
+}
+
+static int plan_execute(const csc_plan *plan, const csc_frame *src,
+        const csc_frame *dst) {
+    struct csc_job job;
+    if (plan_job(plan, src, dst, &job) != 0)
+        return -1;
+
+    return csc_run(plan->ctx, &job);
+}
+
+csc_plan *csc_plan_create(int src_format, int dst_format,
+        unsigned short width, unsigned short height, const csc_opts *opts) {
+    return csc_plan_create_large(src_format, dst_format, width, height, opts);
+}
+
+int csc_plan_execute(const csc_plan *plan, const csc_frame *src,
+        const csc_frame *dst) {
+    if (plan == NULL)
+        return -1;
+
+    return plan_execute(plan, src, dst);
+}
+
+void csc_plan_destroy(csc_plan *plan) {
+    if (plan != NULL)
+        plan_free(plan);
+    free(plan);
+}
+
+csc_plan *csc_plan_create_large(int src_format, int dst_format,
+        size_t width, size_t height, const csc_opts *opts) {
+    if (!size_valid(width, height))
+        return NULL;
+
+    csc_plan *plan = malloc(sizeof(*plan));
+    if (plan == NULL)
+        return NULL;
+
+    if (plan_init(plan, src_format, dst_format, width, height, opts) != 0) {
+        free(plan);
+        return NULL;
+    }
+
+    return plan;
+}
+
+int csc_convert(int src_format, int dst_format, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_opts *opts) {
+    return csc_convert_large(src_format, dst_format, src, dst, width, height,
+            opts);
+}
+
+int csc_convert_large(int src_format, int dst_format, const csc_frame *src,
+        const csc_frame *dst, size_t width, size_t height,
+        const csc_opts *opts) {
+    csc_plan plan;
+    if (!size_valid(width, height) ||
+            plan_init(&plan, src_format, dst_format, width, height, opts) != 0)
+        return -1;
+
+    int ret = plan_execute(&plan, src, dst);
+    plan_free(&plan);
+
+    return ret;
+}
+
+int csc_plan_execute_batch(const csc_plan *plan, const csc_frame *src,
+        const csc_frame *dst, unsigned int count) {
+    if (plan == NULL || src == NULL || dst == NULL)
+        return -1;
+    if (count == 0)
+        return 0;
+
+    struct csc_job *jobs = csc_reserve_jobs(count);
+    if (jobs == NULL)
+        return -1;
+
+    for (unsigned int i = 0; i < count; ++i)
+        if (plan_job(plan, &src[i], &dst[i], &jobs[i]) != 0)
+            return -1;
+
+    return csc_run_batch(plan->ctx, jobs, count);
+}
+
+int csc_convert_batch(int src_format, int dst_format,
+        const csc_batch_item *items, unsigned int count,
+        const csc_opts *opts) {
+    if (items == NULL)
+        return -1;
+    if (count == 0)
+        return 0;
+
+    struct csc_job *jobs = csc_reserve_jobs(count);
+    if (jobs == NULL)
+        return -1;
+
+    /* each job keeps the taps of its plan until the batch has run */
+    int ret = 0;
+    unsigned int n = 0;
+    for (; n < count && ret == 0; ++n) {
+        csc_plan plan;
+        if (plan_init(&plan, src_format, dst_format, items[n].width,
+                items[n].height, opts) != 0)
+            break;
+        ret = plan_job(&plan, &items[n].src, &items[n].dst, &jobs[n]);
+        jobs[n].taps = plan.taps;
+    }
+    if (n == count && ret == 0)
+        ret = csc_run_batch(opts != NULL ? opts->ctx : NULL, jobs, count);
+    else
+        ret = -1;
+
+    for (unsigned int i = 0; i < n; ++i)
+        free((struct tap *) jobs[i].taps);
+
+    return ret;
+}
+
+struct csc_slice {
+    const csc_plan *plan;
+    struct csc_job job;
+    int begun;
+    unsigned int first;     /* source row of the job's row 0 */
+    unsigned int arrived;   /* source rows pushed */
+    unsigned int done;      /* job rows converted */
+#ifdef CSC_STATS
+    unsigned long long start, ns;   /* of the first push, all pushes */
+#endif
+};
+
+csc_slice *csc_slice_create(const csc_plan *plan) {
+    if (plan == NULL)
+        return NULL;
+
+    csc_slice *slice = calloc(1, sizeof(*slice));
+    if (slice == NULL)
+        return NULL;
+
+    slice->plan = plan;
+
+    return slice;
+}
+
+void csc_slice_destroy(csc_slice *slice) {
+    free(slice);
+}
+
+int csc_slice_begin(csc_slice *slice, const csc_frame *src,
+        const csc_frame *dst) {
+    if (slice == NULL)
+        return -1;
+
+    slice->begun = 0;
+    if (plan_job(slice->plan, src, dst, &slice->job) != 0)
+        return -1;
+
+    /* a few rows at a time are read back soon, keep them in the cache */
+    if (slice->job.rows == stream_rows) {
+        slice->job.rows = slice->job.inner;
+        slice->job.scratch -= stream_scratch(slice->job.dst_layout,
+                slice->job.width);
+    }
+
+    /* an ROI job starts at a row of src further down */
+    slice->first = (slice->job.src.data[0] - src->data[0]) / src->stride[0];
+    slice->arrived = 0;
+    slice->done = 0;
+    slice->begun = 1;
+
+    return 0;
+}
+
+int csc_slice_push(csc_slice *slice, unsigned int rows) {
+    if (slice == NULL || !slice->begun ||
+            rows > slice->plan->height - slice->arrived)
+        return -1;
+
+    struct csc_job *job = &slice->job;
+    slice->arrived += rows;
+
+    /* the job row pairs whose source rows are all in */
+    unsigned int ready = slice->arrived > slice->first ?
+            (slice->arrived - slice->first) >> job->shift : 0;
+    ready = ready >= job->height ? job->height : ready & ~1u;
+    if (job->rows == resize_rows)
+        ready = resize_ready(job, slice->done, slice->arrived);
+    if (ready > slice->done) {
+        if (csc_reserve_scratch(job->scratch) != 0) {
+            slice->arrived -= rows;
+            return -1;
+        }
+#ifdef CSC_STATS
+        /* the frame is counted once whole, with the time spent on it */
+        unsigned long long start = csc_stats_now();
+        if (slice->done == 0) {
+            slice->start = start;
+            slice->ns = 0;
+        }
+        job->rows(job, slice->done, ready);
+        slice->ns += csc_stats_now() - start;
+        if (ready == job->height)
+            csc_stats_record(job, slice->start, slice->ns);
+#else
+        job->rows(job, slice->done, ready);
+#endif
+        slice->done = ready;
+    }
+
+    /* a crop job covers the rows around the ROI as well */
+    if (job->crop.width == 0)
+        return slice->done;
+    if (slice->done <= job->crop.y)
+        return 0;
+
+    return slice->done - job->crop.y < job->crop.height ?
+            slice->done - job->crop.y : job->crop.height;
+}
@@ -8,6 +8,8 @@
 #ifndef CONV_RGB_YUV_H_
 #define CONV_RGB_YUV_H_
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -27,8 +29,34 @@ extern "C" {
  * RGB               BGR
  * RGBRGBRGBRGB      BGRBGRBGRBGR
  * RGBRGBRGBRGB      BGRBGRBGRBGR
+ *
+ * RGBA              BGRA              ARGB              ABGR
+ * RGBARGBARGBA      BGRABGRABGRA      ARGBARGBARGB      ABGRABGRABGR
+ * RGBARGBARGBA      BGRABGRABGRA      ARGBARGBARGB      ABGRABGRABGR
+ *
+ * YUYV              UYVY
+ * YUYVYUYVYUYV      UYVYUYVYUYVY
+ * YUYVYUYVYUYV      UYVYUYVYUYVY
+ *
+ * P010 and I010 are laid out as NV12 and I420, RGB48 as RGB, with every
+ * sample a 16-bit little-endian word.
  */
 
+/*
+ * The best SIMD level supported by the CPU is picked on first use.
+ * csc_set_simd_level() can lower it, e.g. to compare against the scalar
+ * code, and returns the level actually in effect.
+ */
+enum csc_simd_level {
+    CSC_SIMD_NONE = 0,
+    CSC_SIMD_SSE41,
+    CSC_SIMD_AVX2,
+};
+
+extern int csc_get_simd_level(void);
+
+extern int csc_set_simd_level(int level);
+
 extern unsigned int convert_rgb_bgr(unsigned char *rgb_or_bgr,
         unsigned short width, unsigned short height);
 
@@ -86,6 +114,926 @@ extern unsigned int yvu420sp_to_yvu420p(const unsigned char *yvu420sp,
         unsigned short width, unsigned short height,
         unsigned char *yvu420p_buf, unsigned int buf_size);
 
+extern unsigned int rgb_to_yvu420sp(const unsigned char *rgb,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size);
+
+extern unsigned int bgr_to_yuv420sp(const unsigned char *bgr,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size);
+
+extern unsigned int rgb_to_yvu420p(const unsigned char *rgb,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size);
+
+extern unsigned int bgr_to_yuv420p(const unsigned char *bgr,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size);
+
+extern unsigned int yvu420sp_to_rgb(const unsigned char *yvu420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *rgb_buf, unsigned int buf_size);
+
+extern unsigned int yuv420sp_to_bgr(const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *bgr_buf, unsigned int buf_size);
+
+extern unsigned int yvu420p_to_rgb(const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *rgb_buf, unsigned int buf_size);
+
+extern unsigned int yuv420p_to_bgr(const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *bgr_buf, unsigned int buf_size);
+
+extern unsigned int yuv420p_to_yvu420sp(const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size);
+
+extern unsigned int yvu420p_to_yuv420sp(const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size);
+
+extern unsigned int yuv420sp_to_yvu420p(const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size);
+
+extern unsigned int yvu420sp_to_yuv420p(const unsigned char *yvu420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size);
+
+extern unsigned int yuv420sp_to_yvu420sp(const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size);
+
+extern unsigned int yvu420sp_to_yuv420sp(const unsigned char *yvu420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size);
+
+extern unsigned int yuv420p_to_yvu420p(const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size);
+
+extern unsigned int yvu420p_to_yuv420p(const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size);
+
+/*
+ * Worker pool for the _mt variants below. Threads are created once and
+ * pinned to CPUs; every call splits the frame into even-row bands run by
+ * the workers and the calling thread. n_threads = 0 uses all online CPUs.
+ * A ctx runs one conversion at a time, a NULL ctx converts on the calling
+ * thread only.
+ */
+typedef struct csc_ctx csc_ctx;
+
+extern csc_ctx *csc_ctx_create(unsigned int n_threads);
+
+extern void csc_ctx_destroy(csc_ctx *ctx);
+
+extern unsigned int csc_ctx_threads(const csc_ctx *ctx);
+
+extern unsigned int convert_rgb_bgr_mt(csc_ctx *ctx, unsigned char *rgb_or_bgr,
+        unsigned short width, unsigned short height);
+
+extern unsigned int convert_yuv420sp_yvu420sp_mt(csc_ctx *ctx,
+        unsigned char *yuv420sp_or_yvu420sp,
+        unsigned short width, unsigned short height);
+
+extern unsigned int convert_yuv420p_yvu420p_mt(csc_ctx *ctx,
+        unsigned char *yuv420p_or_yvu420p,
+        unsigned short width, unsigned short height);
+
+extern unsigned int rgb_to_yuv420sp_mt(csc_ctx *ctx, const unsigned char *rgb,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size);
+
+extern unsigned int bgr_to_yvu420sp_mt(csc_ctx *ctx, const unsigned char *bgr,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size);
+
+extern unsigned int rgb_to_yuv420p_mt(csc_ctx *ctx, const unsigned char *rgb,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size);
+
+extern unsigned int bgr_to_yvu420p_mt(csc_ctx *ctx, const unsigned char *bgr,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size);
+
+extern unsigned int yuv420sp_to_rgb_mt(csc_ctx *ctx,
+        const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *rgb_buf, unsigned int buf_size);
+
+extern unsigned int yvu420sp_to_bgr_mt(csc_ctx *ctx,
+        const unsigned char *yvu420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *bgr_buf, unsigned int buf_size);
+
+extern unsigned int yuv420p_to_rgb_mt(csc_ctx *ctx,
+        const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *rgb_buf, unsigned int buf_size);
+
+extern unsigned int yvu420p_to_bgr_mt(csc_ctx *ctx,
+        const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *bgr_buf, unsigned int buf_size);
+
+extern unsigned int yuv420p_to_yuv420sp_mt(csc_ctx *ctx,
+        const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size);
+
+extern unsigned int yuv420sp_to_yuv420p_mt(csc_ctx *ctx,
+        const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size);
+
+extern unsigned int yvu420p_to_yvu420sp_mt(csc_ctx *ctx,
+        const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size);
+
+extern unsigned int yvu420sp_to_yvu420p_mt(csc_ctx *ctx,
+        const unsigned char *yvu420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size);
+
+extern unsigned int rgb_to_yvu420sp_mt(csc_ctx *ctx,
+        const unsigned char *rgb,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size);
+
+extern unsigned int bgr_to_yuv420sp_mt(csc_ctx *ctx,
+        const unsigned char *bgr,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size);
+
+extern unsigned int rgb_to_yvu420p_mt(csc_ctx *ctx,
+        const unsigned char *rgb,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size);
+
+extern unsigned int bgr_to_yuv420p_mt(csc_ctx *ctx,
+        const unsigned char *bgr,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size);
+
+extern unsigned int yvu420sp_to_rgb_mt(csc_ctx *ctx,
+        const unsigned char *yvu420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *rgb_buf, unsigned int buf_size);
+
+extern unsigned int yuv420sp_to_bgr_mt(csc_ctx *ctx,
+        const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *bgr_buf, unsigned int buf_size);
+
+extern unsigned int yvu420p_to_rgb_mt(csc_ctx *ctx,
+        const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *rgb_buf, unsigned int buf_size);
+
+extern unsigned int yuv420p_to_bgr_mt(csc_ctx *ctx,
+        const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *bgr_buf, unsigned int buf_size);
+
+extern unsigned int yuv420p_to_yvu420sp_mt(csc_ctx *ctx,
+        const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size);
+
+extern unsigned int yvu420p_to_yuv420sp_mt(csc_ctx *ctx,
+        const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size);
+
+extern unsigned int yuv420sp_to_yvu420p_mt(csc_ctx *ctx,
+        const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size);
+
+extern unsigned int yvu420sp_to_yuv420p_mt(csc_ctx *ctx,
+        const unsigned char *yvu420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size);
+
+extern unsigned int yuv420sp_to_yvu420sp_mt(csc_ctx *ctx,
+        const unsigned char *yuv420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420sp_buf, unsigned int buf_size);
+
+extern unsigned int yvu420sp_to_yuv420sp_mt(csc_ctx *ctx,
+        const unsigned char *yvu420sp,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420sp_buf, unsigned int buf_size);
+
+extern unsigned int yuv420p_to_yvu420p_mt(csc_ctx *ctx,
+        const unsigned char *yuv420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yvu420p_buf, unsigned int buf_size);
+
+extern unsigned int yvu420p_to_yuv420p_mt(csc_ctx *ctx,
+        const unsigned char *yvu420p,
+        unsigned short width, unsigned short height,
+        unsigned char *yuv420p_buf, unsigned int buf_size);
+
+/*
+ * Frames with their own plane pointers and strides, e.g. padded capture or
+ * decoder buffers, converted without a copy into a contiguous buffer.
+ *
+ * data[] holds the planes in memory order of the format: data[0] only for
+ * RGB/BGR, Y and UV (or VU) for yuv420sp/yvu420sp, Y, U, V for yuv420p and
+ * Y, V, U for yvu420p. stride[] is the distance in bytes between the start
+ * of two rows of each plane.
+ *
+ * matrix and range describe the YUV frame of a conversion and are ignored
+ * for RGB/BGR frames and between two YUV formats. Their zero values give
+ * the BT.601 limited range used by the plain and _mt functions.
+ *
+ * The _frame functions take an optional ctx like the _mt ones and return 0,
+ * or -1 when a plane is missing, a stride is shorter than a row or the
+ * matrix/range is unknown.
+ */
+enum csc_matrix {
+    CSC_MATRIX_BT601 = 0,
+    CSC_MATRIX_BT709,
+    CSC_MATRIX_BT2020,
+};
+
+enum csc_range {
+    CSC_RANGE_LIMITED = 0,  /* Y 16..235, UV 16..240 */
+    CSC_RANGE_FULL,         /* 0..255 */
+};
+
+typedef struct csc_frame {
+    unsigned char *data[3];
+    size_t stride[3];
+    int matrix;             /* enum csc_matrix */
+    int range;              /* enum csc_range */
+} csc_frame;
+
+extern int convert_rgb_bgr_frame(csc_ctx *ctx, const csc_frame *frame,
+        unsigned short width, unsigned short height);
+
+extern int convert_yuv420sp_yvu420sp_frame(csc_ctx *ctx, const csc_frame *frame,
+        unsigned short width, unsigned short height);
+
+extern int convert_yuv420p_yvu420p_frame(csc_ctx *ctx, const csc_frame *frame,
+        unsigned short width, unsigned short height);
+
+extern int rgb_to_yuv420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int bgr_to_yvu420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int rgb_to_yuv420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int bgr_to_yvu420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yuv420sp_to_rgb_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yvu420sp_to_bgr_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yuv420p_to_rgb_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yvu420p_to_bgr_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yuv420p_to_yuv420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yuv420sp_to_yuv420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yvu420p_to_yvu420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yvu420sp_to_yvu420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int rgb_to_yvu420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int bgr_to_yuv420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int rgb_to_yvu420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int bgr_to_yuv420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yvu420sp_to_rgb_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yuv420sp_to_bgr_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yvu420p_to_rgb_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yuv420p_to_bgr_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yuv420p_to_yvu420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yvu420p_to_yuv420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yuv420sp_to_yvu420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yvu420sp_to_yuv420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yuv420sp_to_yvu420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yvu420sp_to_yuv420sp_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yuv420p_to_yvu420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+extern int yvu420p_to_yuv420p_frame(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height);
+
+/*
+ * Fused conversion and box downscale by factor 2, 4 or 8: every plane of
+ * src is averaged over factor x factor blocks and the result converted,
+ * so the source is read once and only the small frame is written. width
+ * and height are those of src, dst is width/factor x height/factor, both
+ * rounded down to even. Returns 0, or -1 for an invalid frame or factor
+ * or when the scratch rows, kept per thread, cannot be allocated.
+ */
+extern int rgb_to_yuv420sp_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+extern int bgr_to_yvu420sp_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+extern int rgb_to_yuv420p_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+extern int bgr_to_yvu420p_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+extern int yuv420sp_to_rgb_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+extern int yvu420sp_to_bgr_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+extern int yuv420p_to_rgb_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+extern int yvu420p_to_bgr_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+extern int rgb_to_yvu420sp_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+extern int bgr_to_yuv420sp_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+extern int rgb_to_yvu420p_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+extern int bgr_to_yuv420p_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+extern int yvu420sp_to_rgb_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+extern int yuv420sp_to_bgr_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+extern int yvu420p_to_rgb_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+extern int yuv420p_to_bgr_scaled(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        unsigned int factor);
+
+/*
+ * Region of interest conversions: only roi of the width x height src is
+ * read, and dst is roi->width x roi->height, tightly packed or strided.
+ * The cost follows the ROI, not the frame.
+ *
+ * The decoders to RGB/BGR take any rectangle and give every pixel the
+ * chroma it has in the full frame. Outputs in a YUV format need an even
+ * roi width and height; at an odd x or y each 2x2 block takes the chroma
+ * under its top-left pixel, like the encoders. The in-place swaps change
+ * every chroma sample the rectangle touches. Returns 0, or -1 for an
+ * invalid frame, a rectangle outside the frame or, decoding off the
+ * chroma grid, when the scratch rows kept per thread cannot be allocated.
+ */
+typedef struct csc_rect {
+    unsigned short x, y;
+    unsigned short width, height;
+} csc_rect;
+
+extern int convert_rgb_bgr_roi(csc_ctx *ctx, const csc_frame *frame,
+        unsigned short width, unsigned short height, const csc_rect *roi);
+
+extern int convert_yuv420sp_yvu420sp_roi(csc_ctx *ctx, const csc_frame *frame,
+        unsigned short width, unsigned short height, const csc_rect *roi);
+
+extern int convert_yuv420p_yvu420p_roi(csc_ctx *ctx, const csc_frame *frame,
+        unsigned short width, unsigned short height, const csc_rect *roi);
+
+extern int rgb_to_yuv420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int bgr_to_yvu420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int rgb_to_yuv420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int bgr_to_yvu420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yuv420sp_to_rgb_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yvu420sp_to_bgr_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yuv420p_to_rgb_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yvu420p_to_bgr_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yuv420p_to_yuv420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yuv420sp_to_yuv420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yvu420p_to_yvu420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yvu420sp_to_yvu420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int rgb_to_yvu420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int bgr_to_yuv420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int rgb_to_yvu420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int bgr_to_yuv420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yvu420sp_to_rgb_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yuv420sp_to_bgr_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yvu420p_to_rgb_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yuv420p_to_bgr_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yuv420p_to_yvu420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yvu420p_to_yuv420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yuv420sp_to_yvu420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yvu420sp_to_yuv420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yuv420sp_to_yvu420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yvu420sp_to_yuv420sp_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yuv420p_to_yvu420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+extern int yvu420p_to_yuv420p_roi(csc_ctx *ctx, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_rect *roi);
+
+/*
+ * Decode straight into a planar R, G, B tensor for inference, without an
+ * RGB frame in between. Each channel is written as
+ *
+ *     value = sample * scale[c] + bias[c]
+ *
+ * for the 0..255 RGB sample, so normalising with a mean and std given in
+ * 0..1 units is scale = 1 / (255 * std) and bias = -mean / std. fp16 is
+ * IEEE binary16; int8 is rounded and saturated, with the quantisation
+ * scale and zero point folded into scale and bias.
+ *
+ * The planes may be one CHW buffer or apart; stride[] is in bytes. The
+ * functions take src like the _frame ones and return 0, or -1 for an
+ * invalid frame or tensor or when the packed rows they decode through,
+ * kept per thread, cannot be allocated.
+ */
+enum csc_tensor_type {
+    CSC_TENSOR_F32 = 0,
+    CSC_TENSOR_F16,
+    CSC_TENSOR_S8,
+};
+
+typedef struct csc_tensor {
+    void *data[3];          /* R, G, B */
+    size_t stride[3];
+    int type;               /* enum csc_tensor_type */
+    float scale[3];
+    float bias[3];
+} csc_tensor;
+
+extern int yuv420sp_to_tensor(csc_ctx *ctx, const csc_frame *src,
+        const csc_tensor *dst, unsigned short width, unsigned short height);
+
+extern int yvu420sp_to_tensor(csc_ctx *ctx, const csc_frame *src,
+        const csc_tensor *dst, unsigned short width, unsigned short height);
+
+extern int yuv420p_to_tensor(csc_ctx *ctx, const csc_frame *src,
+        const csc_tensor *dst, unsigned short width, unsigned short height);
+
+extern int yvu420p_to_tensor(csc_ctx *ctx, const csc_frame *src,
+        const csc_tensor *dst, unsigned short width, unsigned short height);
+
+/*
+ * Any-to-any conversion between the formats below, in one pass for every
+ * pair. A plan resolves the pair, size and options once, so executing it
+ * per frame costs a table lookup less than csc_convert(), which builds
+ * and runs a plan on the stack.
+ *
+ * With opts NULL the whole frame is converted on the calling thread.
+ * factor selects the _scaled box downscale and needs one RGB and one
+ * 4:2:0 format; roi (copied into the plan) selects the _roi behaviour,
+ * and the two do not combine. Converting between RGB24 and BGR24, NV12
+ * and NV21, I420 and YV12, YUYV and UYVY or two 4-byte formats with dst
+ * the same frame as src converts in place.
+ *
+ * The 4-byte formats are named by byte order in memory, so the
+ * little-endian XRGB8888 word is BGRA32. Alpha is ignored when encoding,
+ * written as 255 when decoding or widening 3-byte pixels, and kept
+ * between two 4-byte formats.
+ *
+ * YUYV and UYVY are packed 4:2:2 camera formats and convert to every
+ * other format except P010, I010 and RGB48, but only from each other.
+ * Going to 4:2:0 the chroma of each row pair is averaged in the same
+ * pass, so a camera frame is read once; going to RGB each row is decoded
+ * with its own chroma. An ROI needs an even x unless dst is RGB.
+ *
+ * P010 and I010 are 10-bit 4:2:0, P010 with the bits at the top of each
+ * word and I010 at the bottom, the other 6 bits ignored; there is no
+ * 16-bit P016. RGB48 has 16 bits a channel. They
+ * convert to and from RGB24, BGR24, RGB48 and each other, and the 10-bit
+ * formats to and from the 8-bit 4:2:0 ones. Samples lose their low bits
+ * with rounding on the way down to 8 bits and are shifted up on the way
+ * back. There is no downscale for them.
+ *
+ * out_width and out_height resize bilinearly from NV12, NV21, I420 or
+ * YV12 to any format in the same pass, to any even size: each output row
+ * pair is sampled from the source planes in fixed point, with SIMD for
+ * the vertical blend, and converted while it is in L1, so only the
+ * output is written. Sample centres are lined up, as most resizers do.
+ * Resizing does not combine with factor or roi. For a letterboxed model
+ * input, point dst at the picture within the padded frame and fill the
+ * bars separately.
+ *
+ * csc_plan_create() returns NULL for an unknown format, an invalid
+ * combination of options or if the memory for a resize's sample
+ * positions, worked out once with the plan, cannot be had. csc_convert()
+ * and csc_plan_execute() return 0 or -1 like the _frame functions.
+ */
+enum csc_format {
+    CSC_FORMAT_RGB24 = 0,
+    CSC_FORMAT_BGR24,
+    CSC_FORMAT_NV12,        /* yuv420sp */
+    CSC_FORMAT_NV21,        /* yvu420sp */
+    CSC_FORMAT_I420,        /* yuv420p */
+    CSC_FORMAT_YV12,        /* yvu420p */
+    CSC_FORMAT_RGBA32,      /* 4-byte pixels, named in memory order */
+    CSC_FORMAT_BGRA32,
+    CSC_FORMAT_ARGB32,
+    CSC_FORMAT_ABGR32,
+    CSC_FORMAT_YUYV,        /* packed 4:2:2, YUY2 */
+    CSC_FORMAT_UYVY,
+    CSC_FORMAT_P010,        /* 16-bit words from here on */
+    CSC_FORMAT_I010,
+    CSC_FORMAT_RGB48,
+    CSC_FORMAT_COUNT,
+};
+
+enum csc_opt_flags {
+    CSC_OPT_STREAM      = 1 << 0,   /* see csc_convert_large() */
+};
+
+typedef struct csc_opts {
+    csc_ctx *ctx;           /* NULL to run on the calling thread */
+    unsigned int factor;    /* 2, 4 or 8 to downscale, 0 for none */
+    const csc_rect *roi;    /* NULL for the whole frame */
+    unsigned int out_width, out_height; /* to resize to, 0 for none */
+    unsigned int flags;     /* csc_opt_flags */
+} csc_opts;
+
+typedef struct csc_plan csc_plan;
+
+/*
+ * Point frame at the planes of a contiguous width x height buffer in the
+ * layout of the plain functions. Returns the size of that buffer, 0 for
+ * an unknown format; with buf NULL only the size is computed.
+ */
+extern size_t csc_frame_init(csc_frame *frame, int format,
+        unsigned char *buf, unsigned short width, unsigned short height);
+
+extern csc_plan *csc_plan_create(int src_format, int dst_format,
+        unsigned short width, unsigned short height, const csc_opts *opts);
+
+extern int csc_plan_execute(const csc_plan *plan, const csc_frame *src,
+        const csc_frame *dst);
+
+extern void csc_plan_destroy(csc_plan *plan);
+
+extern int csc_convert(int src_format, int dst_format, const csc_frame *src,
+        const csc_frame *dst, unsigned short width, unsigned short height,
+        const csc_opts *opts);
+
+/*
+ * The same for frames past the 65535 x 65535 of the other functions, e.g.
+ * stitched panoramas, with sizes in size_t throughout. Each side may be
+ * up to UINT_MAX / 8 pixels; larger sizes, or ones whose buffer would not
+ * fit in a size_t, fail with 0, NULL or -1. An roi in opts can still only
+ * address the first 65535 columns and rows.
+ *
+ * With CSC_OPT_STREAM in opts->flags, whole-frame conversions whose
+ * source and output together do not fit the last-level cache, through
+ * these or the other functions taking opts, go a row pair at a time
+ * through a small buffer and are written out with non-temporal stores
+ * while the next source rows are prefetched, so the output goes around
+ * the cache instead of evicting the source and the working sets of other
+ * threads and processes. Leave it off when the output is read soon after,
+ * as it then has to come back from memory.
+ */
+extern size_t csc_frame_init_large(csc_frame *frame, int format,
+        unsigned char *buf, size_t width, size_t height);
+
+extern csc_plan *csc_plan_create_large(int src_format, int dst_format,
+        size_t width, size_t height, const csc_opts *opts);
+
+extern int csc_convert_large(int src_format, int dst_format,
+        const csc_frame *src, const csc_frame *dst, size_t width,
+        size_t height, const csc_opts *opts);
+
+/*
+ * Convert many frames in one call. The frames are shared out between the
+ * ctx threads whole, large ones in bands, and a thread that runs out of
+ * work takes over from the others, so many small frames or a mix of
+ * sizes keep every thread busy where one call per frame would not.
+ *
+ * csc_plan_execute_batch() converts src[i] to dst[i] with one plan,
+ * csc_convert_batch() takes the size per frame. Nothing is converted
+ * and -1 returned if any frame is invalid.
+ */
+typedef struct csc_batch_item {
+    csc_frame src, dst;
+    unsigned short width, height;
+} csc_batch_item;
+
+extern int csc_plan_execute_batch(const csc_plan *plan, const csc_frame *src,
+        const csc_frame *dst, unsigned int count);
+
+extern int csc_convert_batch(int src_format, int dst_format,
+        const csc_batch_item *items, unsigned int count,
+        const csc_opts *opts);
+
+/*
+ * Convert a frame as its rows arrive, e.g. from a decoder or a sensor,
+ * rather than once it is whole, so the output lags the input by a few
+ * rows instead of a frame. A slice converts frames with one plan, a
+ * frame at a time: csc_slice_begin() takes the frame's buffers, checked
+ * as by csc_plan_execute(), and csc_slice_push() tells it that rows more
+ * rows of the source, from the top, have been filled in.
+ *
+ * Each push converts, on the calling thread, the output rows whose
+ * source rows are all in, a row pair at a time, which is 2 x factor
+ * source rows when downscaling. So pushing even counts of rows
+ * (multiples of 2 x factor to downscale) leaves none waiting. The output
+ * is the same as converting the frame whole.
+ *
+ * csc_slice_push() returns how many output rows are done so far, or -1
+ * before csc_slice_begin(), for more rows than the frame has or if the
+ * memory to convert them cannot be had, in which case the push does not
+ * count and can be made again.
+ */
+typedef struct csc_slice csc_slice;
+
+extern csc_slice *csc_slice_create(const csc_plan *plan);
+
+extern void csc_slice_destroy(csc_slice *slice);
+
+extern int csc_slice_begin(csc_slice *slice, const csc_frame *src,
+        const csc_frame *dst);
+
+extern int csc_slice_push(csc_slice *slice, unsigned int rows);
+
+/*
+ * A pool of count buffers for width x height frames of one format, made
+ * up front so a stream of frames needs no allocation per frame. With the
+ * plan and ctx also made up front, converting the stream allocates only
+ * until the scratch each thread keeps, and for batches the arrays the
+ * ctx and calling thread keep, have grown to their largest. Each buffer
+ * starts on a 64-byte boundary and is laid out as by csc_frame_init(),
+ * so it serves the plain functions as well as frames.
+ *
+ * csc_pool_get() takes a buffer, pointing frame at it unless frame is
+ * NULL, and returns NULL when all are out. csc_pool_put() gives one back
+ * and returns -1 for a pointer that is not a buffer of the pool. Both
+ * are lock-free and can be called from any thread, a buffer taken on one
+ * thread being put back on another.
+ */
+enum csc_pool_flags {
+    CSC_POOL_PREFAULT   = 1 << 0,   /* touch every page up front */
+    CSC_POOL_HUGE_PAGES = 1 << 1,   /* back with 2 MiB pages if possible */
+};
+
+typedef struct csc_pool csc_pool;
+
+extern csc_pool *csc_pool_create(int format, size_t width, size_t height,
+        unsigned int count, unsigned int flags);
+
+extern void csc_pool_destroy(csc_pool *pool);
+
+extern unsigned char *csc_pool_get(csc_pool *pool, csc_frame *frame);
+
+extern int csc_pool_put(csc_pool *pool, unsigned char *buf);
+
+/*
+ * Conversions run by a queue's own threads, for callers such as capture
+ * callbacks that must not wait on them. csc_submit() checks the frames
+ * against the plan, hands them over and returns at once; each frame is
+ * converted whole by one thread, many frames at a time, and the ctx of
+ * the plan is not used. The buffers and the plan must stay valid until
+ * the frame completes.
+ *
+ * At most depth frames are out at a time, counting completed ones not
+ * yet polled. csc_submit() returns 0, or a negative <errno.h> code with
+ * the frame not taken, for the caller to drop or retry it: -EAGAIN when
+ * the queue is full, -EINVAL for frames that do not fit the plan or a
+ * stream of another queue, and -ENOMEM when the memory the frame
+ * converts through cannot be had. That memory is kept with the queue
+ * from frame to frame.
+ *
+ * A completed frame calls done(user) on the thread that converted it,
+ * or with done NULL is kept for csc_queue_poll(), which returns up to
+ * max of their user pointers. csc_queue_fd() is readable while there
+ * may be such frames, an eventfd to poll() or epoll on Linux and -1
+ * elsewhere. Frames of the same stream complete in the order they were
+ * submitted, even when converted side by side; frames without one as
+ * soon as they are done.
+ *
+ * csc_queue_destroy() waits for the frames submitted to complete; a
+ * stream must have none out when destroyed.
+ */
+typedef struct csc_queue csc_queue;
+typedef struct csc_stream csc_stream;
+typedef void (*csc_done_fn)(void *user);
+
+extern csc_queue *csc_queue_create(unsigned int n_threads,
+        unsigned int depth);
+
+extern void csc_queue_destroy(csc_queue *queue);
+
+extern csc_stream *csc_stream_create(csc_queue *queue);
+
+extern void csc_stream_destroy(csc_stream *stream);
+
+extern int csc_submit(csc_queue *queue, csc_stream *stream,
+        const csc_plan *plan, const csc_frame *src, const csc_frame *dst,
+        csc_done_fn done, void *user);
+
+extern int csc_queue_fd(const csc_queue *queue);
+
+extern unsigned int csc_queue_poll(csc_queue *queue, void **users,
+        unsigned int max);
+
+/*
+ * Counters per conversion, built in with make STATS=1 (-DCSC_STATS) and
+ * otherwise left out. Each thread counts the frames it converts, with
+ * relaxed atomics and no locks, and csc_stats_snapshot() adds the threads
+ * up. Conversions that share a row function, e.g. NV12 to NV21 and back,
+ * count under the first pair of enum csc_format.
+ *
+ * hist[b] counts the frames that took from 2^b up to 2^(b + 1) ns, the
+ * last bucket all slower ones. A frame of a batch is counted with an
+ * equal share of the batch, and a frame of a slice once its last row is
+ * done, with the time its pushes spent converting.
+ */
+#define CSC_STATS_BUCKETS   32
+
+typedef struct csc_stats_entry {
+    int src_format, dst_format;     /* -1 for the _tensor functions */
+    unsigned long long calls, pixels, bytes, ns;
+    unsigned long long hist[CSC_STATS_BUCKETS];
+} csc_stats_entry;
+
+/*
+ * Fill up to max entries, one for each conversion used so far. Returns
+ * how many there are, which may be more than max, or -1 without the
+ * stats built in.
+ */
+extern int csc_stats_snapshot(csc_stats_entry *entries, unsigned int max);
+
+/*
+ * The snapshot as text, a line per conversion such as
+ *
+ *  rgb24:nv12 calls 3 pixels 6220800 bytes 15552000 ns 4512309 hist 20:3
+ *
+ * with the histogram as bucket:count for the buckets in use.
+ * Writes at most size bytes including the '\0' and returns the length of
+ * the whole text, as snprintf() does.
+ */
+extern size_t csc_stats_dump(char *buf, size_t size);
+
+/*
+ * A hook called on the converting thread after every frame, NULL to
+ * remove it. It should return quickly and not convert frames itself.
+ * A frame converting while the hook is changed sees the old fn and user
+ * or the new ones, never a mix. Returns 0, or -1 without the stats built
+ * in or if the memory for the hook cannot be had, the old hook staying.
+ */
+typedef struct csc_trace_event {
+    int src_format, dst_format;     /* as in csc_stats_entry */
+    size_t width, height;           /* of the output */
+    unsigned long long start_ns;    /* CLOCK_MONOTONIC */
+    unsigned long long ns;
+} csc_trace_event;
+
+typedef void (*csc_trace_fn)(void *user, const csc_trace_event *event);
+
+extern int csc_stats_set_trace(csc_trace_fn fn, void *user);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,1308 @@
+/*
+ * conv_rgb_yuv_avx2.c
+ *
+ * AVX2 row kernels, 32 pixels per iteration. Each 128-bit lane holds 16
+ * consecutive pixels so the in-lane shuffles match the SSE4.1 kernels.
+ */
+
+#include "conv_rgb_yuv_simd.h"
+
+#ifdef __AVX2__
+
+#include <immintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+struct enc_consts {
+    __m256i mask[3][3], mask4;
+    __m256i ky[3], kc[2][3], y_off;
+};
+
+static void load_enc_consts(struct enc_consts *e,
+        const struct csc_enc_coefs *k) {
+    for (int p = 0; p < 3; ++p) {
+        for (int v = 0; v < 3; ++v)
+            e->mask[p][v] = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+                    (const __m128i *) csc_deint_mask[p][v]));
+        e->ky[p] = _mm256_set1_epi16(k->y[p]);
+        e->kc[0][p] = _mm256_set1_epi16(k->c[0][p]);
+        e->kc[1][p] = _mm256_set1_epi16(k->c[1][p]);
+    }
+    e->y_off = _mm256_set1_epi16(k->y_off);
+    e->mask4 = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+            (const __m128i *) csc_deint4_mask));
+}
+
+static inline __m256i load_lanes(const unsigned char *lo,
+        const unsigned char *hi) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(
+            _mm_loadu_si128((const __m128i *) lo)),
+            _mm_loadu_si128((const __m128i *) hi), 1);
+}
+
+/* pixels 0-15 in the low lane, 16-31 in the high lane */
+static inline void deinterleave(const struct enc_consts *e,
+        const unsigned char *src, __m256i p[3]) {
+    __m256i a = load_lanes(src, src + 48);
+    __m256i b = load_lanes(src + 16, src + 64);
+    __m256i c = load_lanes(src + 32, src + 80);
+    for (int i = 0; i < 3; ++i)
+        p[i] = _mm256_or_si256(_mm256_or_si256(
+                _mm256_shuffle_epi8(a, e->mask[i][0]),
+                _mm256_shuffle_epi8(b, e->mask[i][1])),
+                _mm256_shuffle_epi8(c, e->mask[i][2]));
+}
+
+/* 32 4-byte pixels, lanes as above */
+static inline __attribute__((always_inline)) void deinterleave4(
+        const struct enc_consts *e, const unsigned char *src,
+        unsigned int first, __m256i p[3]) {
+    __m256i v[4];
+    for (int i = 0; i < 4; ++i)
+        v[i] = _mm256_shuffle_epi8(load_lanes(src + i * 16,
+                src + 64 + i * 16), e->mask4);
+
+    __m256i t0 = _mm256_unpacklo_epi32(v[0], v[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(v[0], v[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(v[2], v[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(v[2], v[3]);
+    __m256i q[4] = {
+        _mm256_unpacklo_epi64(t0, t2), _mm256_unpackhi_epi64(t0, t2),
+        _mm256_unpacklo_epi64(t1, t3), _mm256_unpackhi_epi64(t1, t3),
+    };
+    for (int i = 0; i < 3; ++i)
+        p[i] = q[first + i];
+}
+
+static inline __m256i y16(const struct enc_consts *e,
+        __m256i p0, __m256i p1, __m256i p2) {
+    __m256i sum = _mm256_add_epi16(_mm256_add_epi16(
+            _mm256_mullo_epi16(p0, e->ky[0]),
+            _mm256_mullo_epi16(p1, e->ky[1])),
+            _mm256_mullo_epi16(p2, e->ky[2]));
+    return _mm256_add_epi16(_mm256_srli_epi16(sum, 8), e->y_off);
+}
+
+static inline __m256i y32(const struct enc_consts *e, const __m256i p[3]) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i lo = y16(e, _mm256_unpacklo_epi8(p[0], zero),
+            _mm256_unpacklo_epi8(p[1], zero),
+            _mm256_unpacklo_epi8(p[2], zero));
+    __m256i hi = y16(e, _mm256_unpackhi_epi8(p[0], zero),
+            _mm256_unpackhi_epi8(p[1], zero),
+            _mm256_unpackhi_epi8(p[2], zero));
+    return _mm256_packus_epi16(lo, hi);
+}
+
+static inline __m256i c16(const __m256i k[3],
+        __m256i p0, __m256i p1, __m256i p2) {
+    __m256i sum = _mm256_add_epi16(_mm256_add_epi16(
+            _mm256_mullo_epi16(p0, k[0]),
+            _mm256_mullo_epi16(p1, k[1])),
+            _mm256_mullo_epi16(p2, k[2]));
+    return _mm256_add_epi16(_mm256_srai_epi16(sum, 8),
+            _mm256_set1_epi16(128));
+}
+
+/* per lane: [c0 x 8, c1 x 8] for the 8 even pixels of the lane */
+static inline __m256i chroma32(const struct enc_consts *e, const __m256i p[3]) {
+    __m256i even = _mm256_set1_epi16(0x00ff);
+    __m256i p0 = _mm256_and_si256(p[0], even);
+    __m256i p1 = _mm256_and_si256(p[1], even);
+    __m256i p2 = _mm256_and_si256(p[2], even);
+    return _mm256_packus_epi16(c16(e->kc[0], p0, p1, p2),
+            c16(e->kc[1], p0, p1, p2));
+}
+
+static void enc_y_row(const struct csc_enc_coefs *k,
+        const unsigned char *src, unsigned char *y, unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i p[3];
+        deinterleave(&e, src + x * 3, p);
+        _mm256_storeu_si256((__m256i *) (y + x), y32(&e, p));
+    }
+
+    for (; x < width; ++x)
+        y[x] = csc_enc_y(k, src + x * 3);
+}
+
+static void enc_sp_row(const struct csc_enc_coefs *k,
+        const unsigned char *src, unsigned char *y, unsigned char *c,
+        unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i p[3];
+        deinterleave(&e, src + x * 3, p);
+        _mm256_storeu_si256((__m256i *) (y + x), y32(&e, p));
+
+        __m256i cc = chroma32(&e, p);
+        _mm256_storeu_si256((__m256i *) (c + x),
+                _mm256_unpacklo_epi8(cc, _mm256_srli_si256(cc, 8)));
+    }
+
+    for (; x < width; x += 2) {
+        y[x]        = csc_enc_y(k, src + x * 3);
+        y[x + 1]    = csc_enc_y(k, src + x * 3 + 3);
+        c[x]        = csc_enc_c(k, 0, src + x * 3);
+        c[x + 1]    = csc_enc_c(k, 1, src + x * 3);
+    }
+}
+
+static void enc_p_row(const struct csc_enc_coefs *k,
+        const unsigned char *src, unsigned char *y,
+        unsigned char *c0, unsigned char *c1, unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i p[3];
+        deinterleave(&e, src + x * 3, p);
+        _mm256_storeu_si256((__m256i *) (y + x), y32(&e, p));
+
+        /* gather [c0 lane0, c0 lane1 | c1 lane0, c1 lane1] */
+        __m256i cc = _mm256_permute4x64_epi64(chroma32(&e, p), 0xd8);
+        _mm_storeu_si128((__m128i *) (c0 + x / 2),
+                _mm256_castsi256_si128(cc));
+        _mm_storeu_si128((__m128i *) (c1 + x / 2),
+                _mm256_extracti128_si256(cc, 1));
+    }
+
+    for (; x < width; x += 2) {
+        y[x]        = csc_enc_y(k, src + x * 3);
+        y[x + 1]    = csc_enc_y(k, src + x * 3 + 3);
+        c0[x / 2]   = csc_enc_c(k, 0, src + x * 3);
+        c1[x / 2]   = csc_enc_c(k, 1, src + x * 3);
+    }
+}
+
+static inline __attribute__((always_inline)) void enc_y_row4_n(
+        const struct csc_enc_coefs *k, unsigned int first,
+        const unsigned char *src, unsigned char *y, unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i p[3];
+        deinterleave4(&e, src + x * 4, first, p);
+        _mm256_storeu_si256((__m256i *) (y + x), y32(&e, p));
+    }
+
+    for (; x < width; ++x)
+        y[x] = csc_enc_y(k, src + x * 4 + first);
+}
+
+static void enc_y_row4(const struct csc_enc_coefs *k, unsigned int first,
+        const unsigned char *src, unsigned char *y, unsigned int width) {
+    if (first == 0)
+        enc_y_row4_n(k, 0, src, y, width);
+    else
+        enc_y_row4_n(k, 1, src, y, width);
+}
+
+static inline __attribute__((always_inline)) void enc_sp_row4_n(
+        const struct csc_enc_coefs *k, unsigned int first,
+        const unsigned char *src, unsigned char *y, unsigned char *c,
+        unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i p[3];
+        deinterleave4(&e, src + x * 4, first, p);
+        _mm256_storeu_si256((__m256i *) (y + x), y32(&e, p));
+
+        __m256i cc = chroma32(&e, p);
+        _mm256_storeu_si256((__m256i *) (c + x),
+                _mm256_unpacklo_epi8(cc, _mm256_srli_si256(cc, 8)));
+    }
+
+    for (; x < width; x += 2) {
+        const unsigned char *s = src + x * 4 + first;
+        y[x]        = csc_enc_y(k, s);
+        y[x + 1]    = csc_enc_y(k, s + 4);
+        c[x]        = csc_enc_c(k, 0, s);
+        c[x + 1]    = csc_enc_c(k, 1, s);
+    }
+}
+
+static void enc_sp_row4(const struct csc_enc_coefs *k, unsigned int first,
+        const unsigned char *src, unsigned char *y, unsigned char *c,
+        unsigned int width) {
+    if (first == 0)
+        enc_sp_row4_n(k, 0, src, y, c, width);
+    else
+        enc_sp_row4_n(k, 1, src, y, c, width);
+}
+
+static inline __attribute__((always_inline)) void enc_p_row4_n(
+        const struct csc_enc_coefs *k, unsigned int first,
+        const unsigned char *src, unsigned char *y,
+        unsigned char *c0, unsigned char *c1, unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i p[3];
+        deinterleave4(&e, src + x * 4, first, p);
+        _mm256_storeu_si256((__m256i *) (y + x), y32(&e, p));
+
+        __m256i cc = _mm256_permute4x64_epi64(chroma32(&e, p), 0xd8);
+        _mm_storeu_si128((__m128i *) (c0 + x / 2),
+                _mm256_castsi256_si128(cc));
+        _mm_storeu_si128((__m128i *) (c1 + x / 2),
+                _mm256_extracti128_si256(cc, 1));
+    }
+
+    for (; x < width; x += 2) {
+        const unsigned char *s = src + x * 4 + first;
+        y[x]        = csc_enc_y(k, s);
+        y[x + 1]    = csc_enc_y(k, s + 4);
+        c0[x / 2]   = csc_enc_c(k, 0, s);
+        c1[x / 2]   = csc_enc_c(k, 1, s);
+    }
+}
+
+static void enc_p_row4(const struct csc_enc_coefs *k, unsigned int first,
+        const unsigned char *src, unsigned char *y,
+        unsigned char *c0, unsigned char *c1, unsigned int width) {
+    if (first == 0)
+        enc_p_row4_n(k, 0, src, y, c0, c1, width);
+    else
+        enc_p_row4_n(k, 1, src, y, c0, c1, width);
+}
+
+struct dec_consts {
+    __m256i mask[3][3];
+    __m256i ky, kc[3], off[3];
+};
+
+static void load_dec_consts(struct dec_consts *d,
+        const struct csc_dec_coefs *k) {
+    for (int n = 0; n < 3; ++n) {
+        for (int v = 0; v < 3; ++v)
+            d->mask[n][v] = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+                    (const __m128i *) csc_int_mask[n][v]));
+        d->kc[n] = _mm256_set1_epi32((int) ((unsigned short) k->c[0][n] |
+                (unsigned int) (unsigned short) k->c[1][n] << 16));
+        d->off[n] = _mm256_set1_epi32(k->off[n]);
+    }
+    d->ky = _mm256_set1_epi32(k->y);
+}
+
+/* lo: (C0, C1) pairs 0-3 and 8-11 in 16-bit lanes, hi: 4-7 and 12-15 */
+static inline void chroma_terms16(const struct dec_consts *d,
+        __m256i lo, __m256i hi, __m256i t[3][4]) {
+    for (int n = 0; n < 3; ++n) {
+        __m256i a = _mm256_add_epi32(_mm256_madd_epi16(lo, d->kc[n]),
+                d->off[n]);
+        __m256i b = _mm256_add_epi32(_mm256_madd_epi16(hi, d->kc[n]),
+                d->off[n]);
+        t[n][0] = _mm256_unpacklo_epi32(a, a);
+        t[n][1] = _mm256_unpackhi_epi32(a, a);
+        t[n][2] = _mm256_unpacklo_epi32(b, b);
+        t[n][3] = _mm256_unpackhi_epi32(b, b);
+    }
+}
+
+/* pairs: (C0, C1) samples 0-7 in the low lane, 8-15 in the high lane */
+static inline void chroma_terms(const struct dec_consts *d, __m256i pairs,
+        __m256i t[3][4]) {
+    __m256i zero = _mm256_setzero_si256();
+    chroma_terms16(d, _mm256_unpacklo_epi8(pairs, zero),
+            _mm256_unpackhi_epi8(pairs, zero), t);
+}
+
+/*
+ * lo: Y samples 0-7 and 16-23 in 16-bit lanes, hi: 8-15 and 24-31, the
+ * sums scaled by 1 << bits
+ */
+static inline __attribute__((always_inline)) void y_terms(
+        const struct dec_consts *d, __m256i lo, __m256i hi, __m256i ys[4]) {
+    __m256i zero = _mm256_setzero_si256();
+    ys[0] = _mm256_madd_epi16(_mm256_unpacklo_epi16(lo, zero), d->ky);
+    ys[1] = _mm256_madd_epi16(_mm256_unpackhi_epi16(lo, zero), d->ky);
+    ys[2] = _mm256_madd_epi16(_mm256_unpacklo_epi16(hi, zero), d->ky);
+    ys[3] = _mm256_madd_epi16(_mm256_unpackhi_epi16(hi, zero), d->ky);
+}
+
+static inline __attribute__((always_inline)) void dec_planes(
+        const struct dec_consts *d, __m256i lo, __m256i hi,
+        const __m256i t[3][4], int bits, __m256i o[3]) {
+    __m256i ys[4];
+    y_terms(d, lo, hi, ys);
+
+    for (int n = 0; n < 3; ++n) {
+        __m256i a = _mm256_packs_epi32(
+                _mm256_srai_epi32(_mm256_add_epi32(ys[0], t[n][0]), bits),
+                _mm256_srai_epi32(_mm256_add_epi32(ys[1], t[n][1]), bits));
+        __m256i b = _mm256_packs_epi32(
+                _mm256_srai_epi32(_mm256_add_epi32(ys[2], t[n][2]), bits),
+                _mm256_srai_epi32(_mm256_add_epi32(ys[3], t[n][3]), bits));
+        o[n] = _mm256_packus_epi16(a, b);
+    }
+}
+
+static inline void dec_planes32(const struct dec_consts *d,
+        const unsigned char *y, const __m256i t[3][4], __m256i o[3]) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i yy = _mm256_loadu_si256((const __m256i *) y);
+    dec_planes(d, _mm256_unpacklo_epi8(yy, zero),
+            _mm256_unpackhi_epi8(yy, zero), t, 8, o);
+}
+
+static inline void store_rgb32(const struct dec_consts *d, const __m256i o[3],
+        unsigned char *dst) {
+    __m256i v[3];
+    for (int i = 0; i < 3; ++i)
+        v[i] = _mm256_or_si256(_mm256_or_si256(
+                _mm256_shuffle_epi8(o[0], d->mask[0][i]),
+                _mm256_shuffle_epi8(o[1], d->mask[1][i])),
+                _mm256_shuffle_epi8(o[2], d->mask[2][i]));
+
+    /* each lane produced 48 bytes, put them back in pixel order */
+    _mm256_storeu_si256((__m256i *) dst,
+            _mm256_permute2x128_si256(v[0], v[1], 0x20));
+    _mm256_storeu_si256((__m256i *) (dst + 32),
+            _mm256_permute2x128_si256(v[2], v[0], 0x30));
+    _mm256_storeu_si256((__m256i *) (dst + 64),
+            _mm256_permute2x128_si256(v[1], v[2], 0x31));
+}
+
+static inline void dec_row32(const struct dec_consts *d,
+        const unsigned char *y, const __m256i t[3][4], unsigned char *dst) {
+    __m256i o[3];
+    dec_planes32(d, y, t, o);
+    store_rgb32(d, o, dst);
+}
+
+static inline __attribute__((always_inline)) void dec_row32_4(
+        const struct dec_consts *d, const unsigned char *y,
+        const __m256i t[3][4], unsigned int first, unsigned char *dst) {
+    __m256i q[4];
+    dec_planes32(d, y, t, q + first);
+    q[first == 0 ? 3 : 0] = _mm256_set1_epi8(-1);
+
+    __m256i lo01 = _mm256_unpacklo_epi8(q[0], q[1]);
+    __m256i hi01 = _mm256_unpackhi_epi8(q[0], q[1]);
+    __m256i lo23 = _mm256_unpacklo_epi8(q[2], q[3]);
+    __m256i hi23 = _mm256_unpackhi_epi8(q[2], q[3]);
+    __m256i v0 = _mm256_unpacklo_epi16(lo01, lo23);
+    __m256i v1 = _mm256_unpackhi_epi16(lo01, lo23);
+    __m256i v2 = _mm256_unpacklo_epi16(hi01, hi23);
+    __m256i v3 = _mm256_unpackhi_epi16(hi01, hi23);
+
+    /* v0..v3 hold pixels 0-15 in the low lanes, 16-31 in the high ones */
+    _mm256_storeu_si256((__m256i *) dst,
+            _mm256_permute2x128_si256(v0, v1, 0x20));
+    _mm256_storeu_si256((__m256i *) (dst + 32),
+            _mm256_permute2x128_si256(v2, v3, 0x20));
+    _mm256_storeu_si256((__m256i *) (dst + 64),
+            _mm256_permute2x128_si256(v0, v1, 0x31));
+    _mm256_storeu_si256((__m256i *) (dst + 96),
+            _mm256_permute2x128_si256(v2, v3, 0x31));
+}
+
+static void dec_sp_rows(const struct csc_dec_coefs *k,
+        const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c, unsigned char *d0, unsigned char *d1,
+        unsigned int width) {
+    struct dec_consts d;
+    load_dec_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i t[3][4];
+        chroma_terms(&d, _mm256_loadu_si256((const __m256i *) (c + x)), t);
+        dec_row32(&d, y0 + x, t, d0 + x * 3);
+        if (y1 != NULL)
+            dec_row32(&d, y1 + x, t, d1 + x * 3);
+    }
+
+    csc_dec_rows_tail(k, y0, y1, c, c + 1, 2, d0, d1, x, width);
+}
+
+static void dec_p_rows(const struct csc_dec_coefs *k,
+        const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c0, const unsigned char *c1,
+        unsigned char *d0, unsigned char *d1, unsigned int width) {
+    struct dec_consts d;
+    load_dec_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m128i u = _mm_loadu_si128((const __m128i *) (c0 + x / 2));
+        __m128i v = _mm_loadu_si128((const __m128i *) (c1 + x / 2));
+        __m256i pairs = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                _mm_unpacklo_epi8(u, v)), _mm_unpackhi_epi8(u, v), 1);
+        __m256i t[3][4];
+        chroma_terms(&d, pairs, t);
+        dec_row32(&d, y0 + x, t, d0 + x * 3);
+        if (y1 != NULL)
+            dec_row32(&d, y1 + x, t, d1 + x * 3);
+    }
+
+    csc_dec_rows_tail(k, y0, y1, c0, c1, 1, d0, d1, x, width);
+}
+
+static inline __attribute__((always_inline)) void dec_sp_rows4_n(
+        const struct csc_dec_coefs *k, unsigned int first,
+        const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c, unsigned char *d0, unsigned char *d1,
+        unsigned int width) {
+    struct dec_consts d;
+    load_dec_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i t[3][4];
+        chroma_terms(&d, _mm256_loadu_si256((const __m256i *) (c + x)), t);
+        dec_row32_4(&d, y0 + x, t, first, d0 + x * 4);
+        if (y1 != NULL)
+            dec_row32_4(&d, y1 + x, t, first, d1 + x * 4);
+    }
+
+    csc_dec_rows4_tail(k, first, y0, y1, c, c + 1, 2, d0, d1, x, width);
+}
+
+static void dec_sp_rows4(const struct csc_dec_coefs *k, unsigned int first,
+        const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c, unsigned char *d0, unsigned char *d1,
+        unsigned int width) {
+    if (first == 0)
+        dec_sp_rows4_n(k, 0, y0, y1, c, d0, d1, width);
+    else
+        dec_sp_rows4_n(k, 1, y0, y1, c, d0, d1, width);
+}
+
+static inline __attribute__((always_inline)) void dec_p_rows4_n(
+        const struct csc_dec_coefs *k, unsigned int first,
+        const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c0, const unsigned char *c1,
+        unsigned char *d0, unsigned char *d1, unsigned int width) {
+    struct dec_consts d;
+    load_dec_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m128i u = _mm_loadu_si128((const __m128i *) (c0 + x / 2));
+        __m128i v = _mm_loadu_si128((const __m128i *) (c1 + x / 2));
+        __m256i pairs = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                _mm_unpacklo_epi8(u, v)), _mm_unpackhi_epi8(u, v), 1);
+        __m256i t[3][4];
+        chroma_terms(&d, pairs, t);
+        dec_row32_4(&d, y0 + x, t, first, d0 + x * 4);
+        if (y1 != NULL)
+            dec_row32_4(&d, y1 + x, t, first, d1 + x * 4);
+    }
+
+    csc_dec_rows4_tail(k, first, y0, y1, c0, c1, 1, d0, d1, x, width);
+}
+
+static void dec_p_rows4(const struct csc_dec_coefs *k, unsigned int first,
+        const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c0, const unsigned char *c1,
+        unsigned char *d0, unsigned char *d1, unsigned int width) {
+    if (first == 0)
+        dec_p_rows4_n(k, 0, y0, y1, c0, c1, d0, d1, width);
+    else
+        dec_p_rows4_n(k, 1, y0, y1, c0, c1, d0, d1, width);
+}
+
+static inline __m256i load2(const unsigned char *lo, const unsigned char *hi) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(
+            _mm_loadu_si128((const __m128i *) lo)),
+            _mm_loadu_si128((const __m128i *) hi), 1);
+}
+
+static inline void store2(unsigned char *lo, unsigned char *hi, __m256i v) {
+    _mm_storeu_si128((__m128i *) lo, _mm256_castsi256_si128(v));
+    _mm_storeu_si128((__m128i *) hi, _mm256_extracti128_si256(v, 1));
+}
+
+/* Two blocks of 16 pixels per iteration, one in each 128-bit lane */
+/*
+ * 32 pixels of a 4:2:2 row: Y is in the even bytes for first 0 and the
+ * odd ones for first 1, the chroma pairs in the others. The packs work
+ * per lane, the permute puts the four quarters back in order.
+ */
+static inline __attribute__((always_inline)) void split422(unsigned int first,
+        const unsigned char *src, __m256i *y, __m256i *c) {
+    const __m256i lo = _mm256_set1_epi16(0xff);
+    __m256i a = _mm256_loadu_si256((const __m256i *) src);
+    __m256i b = _mm256_loadu_si256((const __m256i *) (src + 32));
+    __m256i even = _mm256_permute4x64_epi64(_mm256_packus_epi16(
+            _mm256_and_si256(a, lo), _mm256_and_si256(b, lo)), 0xd8);
+    __m256i odd = _mm256_permute4x64_epi64(_mm256_packus_epi16(
+            _mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8)), 0xd8);
+    *y = first == 0 ? even : odd;
+    *c = first == 0 ? odd : even;
+}
+
+static inline __attribute__((always_inline)) void unpack422_sp_rows_n(
+        unsigned int first, const unsigned char *s0, const unsigned char *s1,
+        unsigned char *y0, unsigned char *y1, unsigned char *c,
+        unsigned int width) {
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i ya, yb, ca, cb;
+        split422(first, s0 + x * 2, &ya, &ca);
+        _mm256_storeu_si256((__m256i *) (y0 + x), ya);
+        if (s1 != NULL) {
+            split422(first, s1 + x * 2, &yb, &cb);
+            _mm256_storeu_si256((__m256i *) (y1 + x), yb);
+            ca = _mm256_avg_epu8(ca, cb);
+        }
+        _mm256_storeu_si256((__m256i *) (c + x), ca);
+    }
+
+    csc_unpack422_tail(first, s0, s1, y0, y1, c, c + 1, 2, x, width);
+}
+
+static void unpack422_sp_rows(unsigned int first,
+        const unsigned char *s0, const unsigned char *s1,
+        unsigned char *y0, unsigned char *y1, unsigned char *c,
+        unsigned int width) {
+    if (first == 0)
+        unpack422_sp_rows_n(0, s0, s1, y0, y1, c, width);
+    else
+        unpack422_sp_rows_n(1, s0, s1, y0, y1, c, width);
+}
+
+static inline __attribute__((always_inline)) void unpack422_p_rows_n(
+        unsigned int first, const unsigned char *s0, const unsigned char *s1,
+        unsigned char *y0, unsigned char *y1,
+        unsigned char *c0, unsigned char *c1, unsigned int width) {
+    const __m256i lo = _mm256_set1_epi16(0xff);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i ya, yb, ca, cb;
+        split422(first, s0 + x * 2, &ya, &ca);
+        split422(first, s1 + x * 2, &yb, &cb);
+        _mm256_storeu_si256((__m256i *) (y0 + x), ya);
+        _mm256_storeu_si256((__m256i *) (y1 + x), yb);
+
+        __m256i cc = _mm256_avg_epu8(ca, cb);
+        __m256i uv = _mm256_permute4x64_epi64(_mm256_packus_epi16(
+                _mm256_and_si256(cc, lo), _mm256_srli_epi16(cc, 8)), 0xd8);
+        _mm_storeu_si128((__m128i *) (c0 + x / 2),
+                _mm256_castsi256_si128(uv));
+        _mm_storeu_si128((__m128i *) (c1 + x / 2),
+                _mm256_extracti128_si256(uv, 1));
+    }
+
+    csc_unpack422_tail(first, s0, s1, y0, y1, c0, c1, 1, x, width);
+}
+
+static void unpack422_p_rows(unsigned int first,
+        const unsigned char *s0, const unsigned char *s1,
+        unsigned char *y0, unsigned char *y1,
+        unsigned char *c0, unsigned char *c1, unsigned int width) {
+    if (first == 0)
+        unpack422_p_rows_n(0, s0, s1, y0, y1, c0, c1, width);
+    else
+        unpack422_p_rows_n(1, s0, s1, y0, y1, c0, c1, width);
+}
+
+/* The offsets in 1/1024ths for 10-bit samples */
+static void load_dec10_consts(struct dec_consts *d,
+        const struct csc_dec_coefs *k) {
+    load_dec_consts(d, k);
+    for (int n = 0; n < 3; ++n)
+        d->off[n] = _mm256_slli_epi32(d->off[n], 2);
+}
+
+/* 16 10-bit samples at bit shift, anything above them ignored */
+static inline __attribute__((always_inline)) __m256i load10x16(
+        const unsigned short *p, unsigned int shift) {
+    return _mm256_and_si256(_mm256_srli_epi16(
+            _mm256_loadu_si256((const __m256i *) p), shift),
+            _mm256_set1_epi16(0x3ff));
+}
+
+/*
+ * 32 samples from p in the lane order of the 8-bit kernels once widened:
+ * 0-7 and 16-23 in *lo, 8-15 and 24-31 in *hi
+ */
+static inline __attribute__((always_inline)) void load10(
+        const unsigned short *p, unsigned int shift, __m256i *lo, __m256i *hi) {
+    __m256i a = load10x16(p, shift);
+    __m256i b = load10x16(p + 16, shift);
+    *lo = _mm256_permute2x128_si256(a, b, 0x20);
+    *hi = _mm256_permute2x128_si256(a, b, 0x31);
+}
+
+static inline __attribute__((always_inline)) void dec10_row32(
+        const struct dec_consts *d, const unsigned short *y,
+        unsigned int shift, const __m256i t[3][4], unsigned char *dst) {
+    __m256i lo, hi, o[3];
+    load10(y, shift, &lo, &hi);
+    dec_planes(d, lo, hi, t, 10, o);
+    store_rgb32(d, o, dst);
+}
+
+/* shift is a constant in each expansion, as first is for the row4 kernels */
+static inline __attribute__((always_inline)) void dec10_sp_rows_n(
+        const struct csc_dec_coefs *k, unsigned int shift,
+        const unsigned short *y0, const unsigned short *y1,
+        const unsigned short *c, unsigned char *d0, unsigned char *d1,
+        unsigned int width) {
+    struct dec_consts d;
+    load_dec10_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i lo, hi, t[3][4];
+        load10(c + x, shift, &lo, &hi);
+        chroma_terms16(&d, lo, hi, t);
+        dec10_row32(&d, y0 + x, shift, t, d0 + x * 3);
+        if (y1 != NULL)
+            dec10_row32(&d, y1 + x, shift, t, d1 + x * 3);
+    }
+
+    csc_dec10_rows_tail(k, shift, y0, y1, c, c + 1, 2, d0, d1, x, width);
+}
+
+static void dec10_sp_rows(const struct csc_dec_coefs *k, unsigned int shift,
+        const unsigned short *y0, const unsigned short *y1,
+        const unsigned short *c, unsigned char *d0, unsigned char *d1,
+        unsigned int width) {
+    if (shift == 0)
+        dec10_sp_rows_n(k, 0, y0, y1, c, d0, d1, width);
+    else
+        dec10_sp_rows_n(k, 6, y0, y1, c, d0, d1, width);
+}
+
+static inline __attribute__((always_inline)) void dec10_p_rows_n(
+        const struct csc_dec_coefs *k, unsigned int shift,
+        const unsigned short *y0, const unsigned short *y1,
+        const unsigned short *c0, const unsigned short *c1,
+        unsigned char *d0, unsigned char *d1, unsigned int width) {
+    struct dec_consts d;
+    load_dec10_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i u = load10x16(c0 + x / 2, shift);
+        __m256i v = load10x16(c1 + x / 2, shift);
+        __m256i t[3][4];
+        chroma_terms16(&d, _mm256_unpacklo_epi16(u, v),
+                _mm256_unpackhi_epi16(u, v), t);
+        dec10_row32(&d, y0 + x, shift, t, d0 + x * 3);
+        if (y1 != NULL)
+            dec10_row32(&d, y1 + x, shift, t, d1 + x * 3);
+    }
+
+    csc_dec10_rows_tail(k, shift, y0, y1, c0, c1, 1, d0, d1, x, width);
+}
+
+static void dec10_p_rows(const struct csc_dec_coefs *k, unsigned int shift,
+        const unsigned short *y0, const unsigned short *y1,
+        const unsigned short *c0, const unsigned short *c1,
+        unsigned char *d0, unsigned char *d1, unsigned int width) {
+    if (shift == 0)
+        dec10_p_rows_n(k, 0, y0, y1, c0, c1, d0, d1, width);
+    else
+        dec10_p_rows_n(k, 6, y0, y1, c0, c1, d0, d1, width);
+}
+
+static inline __m256i sum16(const __m256i k[3],
+        __m256i p0, __m256i p1, __m256i p2) {
+    return _mm256_add_epi16(_mm256_add_epi16(
+            _mm256_mullo_epi16(p0, k[0]),
+            _mm256_mullo_epi16(p1, k[1])),
+            _mm256_mullo_epi16(p2, k[2]));
+}
+
+/*
+ * 32 pixels to 10-bit Y in y[], 0-15 and 16-31: the 8-bit sums shifted
+ * down by 6 rather than 8
+ */
+static inline __attribute__((always_inline)) void enc10_y32(
+        const struct enc_consts *e, const __m256i p[3], unsigned int shift,
+        __m256i y[2]) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i y_off = _mm256_slli_epi16(e->y_off, 2);
+
+    __m256i lo = _mm256_add_epi16(_mm256_srli_epi16(sum16(e->ky,
+            _mm256_unpacklo_epi8(p[0], zero),
+            _mm256_unpacklo_epi8(p[1], zero),
+            _mm256_unpacklo_epi8(p[2], zero)), 6), y_off);
+    __m256i hi = _mm256_add_epi16(_mm256_srli_epi16(sum16(e->ky,
+            _mm256_unpackhi_epi8(p[0], zero),
+            _mm256_unpackhi_epi8(p[1], zero),
+            _mm256_unpackhi_epi8(p[2], zero)), 6), y_off);
+    lo = _mm256_slli_epi16(lo, shift);
+    hi = _mm256_slli_epi16(hi, shift);
+    y[0] = _mm256_permute2x128_si256(lo, hi, 0x20);
+    y[1] = _mm256_permute2x128_si256(lo, hi, 0x31);
+}
+
+/* The 10-bit chroma of the 16 even pixels of 32, in order */
+static inline __attribute__((always_inline)) void enc10_c32(
+        const struct enc_consts *e, const __m256i p[3], unsigned int shift,
+        __m256i *u, __m256i *v) {
+    __m256i c_off = _mm256_set1_epi16(512);
+    __m256i even = _mm256_set1_epi16(0x00ff);
+    __m256i p0 = _mm256_and_si256(p[0], even);
+    __m256i p1 = _mm256_and_si256(p[1], even);
+    __m256i p2 = _mm256_and_si256(p[2], even);
+    *u = _mm256_slli_epi16(_mm256_add_epi16(_mm256_srai_epi16(
+            sum16(e->kc[0], p0, p1, p2), 6), c_off), shift);
+    *v = _mm256_slli_epi16(_mm256_add_epi16(_mm256_srai_epi16(
+            sum16(e->kc[1], p0, p1, p2), 6), c_off), shift);
+}
+
+static inline __attribute__((always_inline)) void enc10_y_row_n(
+        const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned char *src, unsigned short *y, unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i p[3], yy[2];
+        deinterleave(&e, src + x * 3, p);
+        enc10_y32(&e, p, shift, yy);
+        _mm256_storeu_si256((__m256i *) (y + x), yy[0]);
+        _mm256_storeu_si256((__m256i *) (y + x + 16), yy[1]);
+    }
+
+    for (; x < width; ++x)
+        y[x] = csc_enc10_y(k, src + x * 3) << shift;
+}
+
+static void enc10_y_row(const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned char *src, unsigned short *y, unsigned int width) {
+    if (shift == 0)
+        enc10_y_row_n(k, 0, src, y, width);
+    else
+        enc10_y_row_n(k, 6, src, y, width);
+}
+
+static inline __attribute__((always_inline)) void enc10_sp_row_n(
+        const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned char *src, unsigned short *y, unsigned short *c,
+        unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i p[3], yy[2], u, v;
+        deinterleave(&e, src + x * 3, p);
+        enc10_y32(&e, p, shift, yy);
+        enc10_c32(&e, p, shift, &u, &v);
+        _mm256_storeu_si256((__m256i *) (y + x), yy[0]);
+        _mm256_storeu_si256((__m256i *) (y + x + 16), yy[1]);
+        __m256i lo = _mm256_unpacklo_epi16(u, v);
+        __m256i hi = _mm256_unpackhi_epi16(u, v);
+        _mm256_storeu_si256((__m256i *) (c + x),
+                _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *) (c + x + 16),
+                _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    csc_enc10_row_tail(k, shift, src, y, c, c + 1, 2, x, width);
+}
+
+static void enc10_sp_row(const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned char *src, unsigned short *y, unsigned short *c,
+        unsigned int width) {
+    if (shift == 0)
+        enc10_sp_row_n(k, 0, src, y, c, width);
+    else
+        enc10_sp_row_n(k, 6, src, y, c, width);
+}
+
+static inline __attribute__((always_inline)) void enc10_p_row_n(
+        const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned char *src, unsigned short *y,
+        unsigned short *c0, unsigned short *c1, unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i p[3], yy[2], u, v;
+        deinterleave(&e, src + x * 3, p);
+        enc10_y32(&e, p, shift, yy);
+        enc10_c32(&e, p, shift, &u, &v);
+        _mm256_storeu_si256((__m256i *) (y + x), yy[0]);
+        _mm256_storeu_si256((__m256i *) (y + x + 16), yy[1]);
+        _mm256_storeu_si256((__m256i *) (c0 + x / 2), u);
+        _mm256_storeu_si256((__m256i *) (c1 + x / 2), v);
+    }
+
+    csc_enc10_row_tail(k, shift, src, y, c0, c1, 1, x, width);
+}
+
+static void enc10_p_row(const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned char *src, unsigned short *y,
+        unsigned short *c0, unsigned short *c1, unsigned int width) {
+    if (shift == 0)
+        enc10_p_row_n(k, 0, src, y, c0, c1, width);
+    else
+        enc10_p_row_n(k, 6, src, y, c0, c1, width);
+}
+
+/* The RGB48 interleave in place of the 8-bit one */
+static void load_dec48_consts(struct dec_consts *d,
+        const struct csc_dec_coefs *k) {
+    load_dec10_consts(d, k);
+    for (int n = 0; n < 3; ++n)
+        for (int v = 0; v < 3; ++v)
+            d->mask[n][v] = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+                    (const __m128i *) csc_int16_mask[n][v]));
+}
+
+static inline __m256i wide48(__m256i s) {
+    return _mm256_add_epi32(_mm256_srai_epi32(s, 2),
+            _mm256_srai_epi32(s, 10));
+}
+
+/*
+ * 32 RGB48 pixels: the lanes of o[0] hold the channels of 0-7 and 16-23,
+ * those of o[1] 8-15 and 24-31
+ */
+static inline __attribute__((always_inline)) void dec10_row48(
+        const struct dec_consts *d, const unsigned short *y,
+        unsigned int shift, const __m256i t[3][4], unsigned short *dst) {
+    __m256i lo, hi, ys[4], o[2][3], v[2][3];
+    load10(y, shift, &lo, &hi);
+    y_terms(d, lo, hi, ys);
+    for (int i = 0; i < 2; ++i) {
+        for (int n = 0; n < 3; ++n)
+            o[i][n] = _mm256_packus_epi32(
+                    wide48(_mm256_add_epi32(ys[i * 2], t[n][i * 2])),
+                    wide48(_mm256_add_epi32(ys[i * 2 + 1],
+                    t[n][i * 2 + 1])));
+        for (int j = 0; j < 3; ++j)
+            v[i][j] = _mm256_or_si256(_mm256_or_si256(
+                    _mm256_shuffle_epi8(o[i][0], d->mask[0][j]),
+                    _mm256_shuffle_epi8(o[i][1], d->mask[1][j])),
+                    _mm256_shuffle_epi8(o[i][2], d->mask[2][j]));
+    }
+
+    /* the low lanes make pixels 0-15, the high lanes 16-31 */
+    __m256i *p = (__m256i *) dst;
+    _mm256_storeu_si256(p, _mm256_permute2x128_si256(v[0][0], v[0][1], 0x20));
+    _mm256_storeu_si256(p + 1,
+            _mm256_permute2x128_si256(v[0][2], v[1][0], 0x20));
+    _mm256_storeu_si256(p + 2,
+            _mm256_permute2x128_si256(v[1][1], v[1][2], 0x20));
+    _mm256_storeu_si256(p + 3,
+            _mm256_permute2x128_si256(v[0][0], v[0][1], 0x31));
+    _mm256_storeu_si256(p + 4,
+            _mm256_permute2x128_si256(v[0][2], v[1][0], 0x31));
+    _mm256_storeu_si256(p + 5,
+            _mm256_permute2x128_si256(v[1][1], v[1][2], 0x31));
+}
+
+static inline __attribute__((always_inline)) void dec10_sp_rows48_n(
+        const struct csc_dec_coefs *k, unsigned int shift,
+        const unsigned short *y0, const unsigned short *y1,
+        const unsigned short *c, unsigned short *d0, unsigned short *d1,
+        unsigned int width) {
+    struct dec_consts d;
+    load_dec48_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i lo, hi, t[3][4];
+        load10(c + x, shift, &lo, &hi);
+        chroma_terms16(&d, lo, hi, t);
+        dec10_row48(&d, y0 + x, shift, t, d0 + x * 3);
+        if (y1 != NULL)
+            dec10_row48(&d, y1 + x, shift, t, d1 + x * 3);
+    }
+
+    csc_dec10_rows48_tail(k, shift, y0, y1, c, c + 1, 2, d0, d1, x, width);
+}
+
+static void dec10_sp_rows48(const struct csc_dec_coefs *k,
+        unsigned int shift, const unsigned short *y0,
+        const unsigned short *y1, const unsigned short *c,
+        unsigned short *d0, unsigned short *d1, unsigned int width) {
+    if (shift == 0)
+        dec10_sp_rows48_n(k, 0, y0, y1, c, d0, d1, width);
+    else
+        dec10_sp_rows48_n(k, 6, y0, y1, c, d0, d1, width);
+}
+
+static inline __attribute__((always_inline)) void dec10_p_rows48_n(
+        const struct csc_dec_coefs *k, unsigned int shift,
+        const unsigned short *y0, const unsigned short *y1,
+        const unsigned short *c0, const unsigned short *c1,
+        unsigned short *d0, unsigned short *d1, unsigned int width) {
+    struct dec_consts d;
+    load_dec48_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i u = load10x16(c0 + x / 2, shift);
+        __m256i v = load10x16(c1 + x / 2, shift);
+        __m256i t[3][4];
+        chroma_terms16(&d, _mm256_unpacklo_epi16(u, v),
+                _mm256_unpackhi_epi16(u, v), t);
+        dec10_row48(&d, y0 + x, shift, t, d0 + x * 3);
+        if (y1 != NULL)
+            dec10_row48(&d, y1 + x, shift, t, d1 + x * 3);
+    }
+
+    csc_dec10_rows48_tail(k, shift, y0, y1, c0, c1, 1, d0, d1, x, width);
+}
+
+static void dec10_p_rows48(const struct csc_dec_coefs *k,
+        unsigned int shift, const unsigned short *y0,
+        const unsigned short *y1, const unsigned short *c0,
+        const unsigned short *c1, unsigned short *d0, unsigned short *d1,
+        unsigned int width) {
+    if (shift == 0)
+        dec10_p_rows48_n(k, 0, y0, y1, c0, c1, d0, d1, width);
+    else
+        dec10_p_rows48_n(k, 6, y0, y1, c0, c1, d0, d1, width);
+}
+
+/*
+ * The 16-bit channels go through pmaddwd as signed words less 32768, the
+ * bias putting it back along with the offset. kp and kb hold the (w0, w1)
+ * and (w2, 0) pairs of Y, C0 and C1.
+ */
+struct enc48_consts {
+    __m256i mask[3][3];
+    __m256i kp[3], kb[3], bias[3];
+};
+
+static void load_enc48_consts(struct enc48_consts *e,
+        const struct csc_enc_coefs *k) {
+    const short *w[3] = { k->y, k->c[0], k->c[1] };
+    const int off[3] = { k->y_off * 4, 512, 512 };
+    for (int n = 0; n < 3; ++n) {
+        for (int v = 0; v < 3; ++v)
+            e->mask[n][v] = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+                    (const __m128i *) csc_deint16_mask[n][v]));
+        e->kp[n] = _mm256_set1_epi32((int) ((unsigned short) w[n][0] |
+                (unsigned int) (unsigned short) w[n][1] << 16));
+        e->kb[n] = _mm256_set1_epi32((unsigned short) w[n][2]);
+        e->bias[n] = _mm256_set1_epi32(32768 *
+                (w[n][0] + w[n][1] + w[n][2]) + (off[n] << 14));
+    }
+}
+
+/*
+ * 16 RGB48 pixels split by channel and made signed, 0-7 in the low lane
+ * and 8-15 in the high lane
+ */
+static inline void deinterleave48(const struct enc48_consts *e,
+        const unsigned short *src, __m256i p[3]) {
+    const unsigned char *b8 = (const unsigned char *) src;
+    __m256i a = load_lanes(b8, b8 + 48);
+    __m256i b = load_lanes(b8 + 16, b8 + 64);
+    __m256i c = load_lanes(b8 + 32, b8 + 80);
+    __m256i sign = _mm256_set1_epi16(-32768);
+    for (int i = 0; i < 3; ++i)
+        p[i] = _mm256_xor_si256(_mm256_or_si256(_mm256_or_si256(
+                _mm256_shuffle_epi8(a, e->mask[i][0]),
+                _mm256_shuffle_epi8(b, e->mask[i][1])),
+                _mm256_shuffle_epi8(c, e->mask[i][2])), sign);
+}
+
+/* The sums from (R, G) pairs and (B, 0), offset and shifted */
+static inline __m256i sum48(const struct enc48_consts *e, int n,
+        __m256i rg, __m256i b) {
+    return _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(
+            _mm256_madd_epi16(rg, e->kp[n]),
+            _mm256_madd_epi16(b, e->kb[n])), e->bias[n]), 14);
+}
+
+static inline __attribute__((always_inline)) __m256i pack10(__m256i lo,
+        __m256i hi, unsigned int shift) {
+    return _mm256_slli_epi16(_mm256_min_epu16(_mm256_packus_epi32(lo, hi),
+            _mm256_set1_epi16(1023)), shift);
+}
+
+/* packus keeps the lanes, so the 16 samples come out in order */
+static inline __attribute__((always_inline)) __m256i enc10_y16(
+        const struct enc48_consts *e, const __m256i p[3],
+        unsigned int shift) {
+    __m256i zero = _mm256_setzero_si256();
+    return pack10(sum48(e, 0, _mm256_unpacklo_epi16(p[0], p[1]),
+            _mm256_unpacklo_epi16(p[2], zero)),
+            sum48(e, 0, _mm256_unpackhi_epi16(p[0], p[1]),
+            _mm256_unpackhi_epi16(p[2], zero)), shift);
+}
+
+/* The chroma of the 8 even pixels of 16, B taken with the zero weight */
+static inline __attribute__((always_inline)) void enc10_c48(
+        const struct enc48_consts *e, const __m256i p[3],
+        unsigned int shift, __m128i *u, __m128i *v) {
+    __m256i rg = _mm256_blend_epi16(p[0], _mm256_slli_epi32(p[1], 16),
+            0xaa);
+    __m256i cu = sum48(e, 1, rg, p[2]), cv = sum48(e, 2, rg, p[2]);
+    *u = _mm256_castsi256_si128(_mm256_permute4x64_epi64(
+            pack10(cu, cu, shift), 0x08));
+    *v = _mm256_castsi256_si128(_mm256_permute4x64_epi64(
+            pack10(cv, cv, shift), 0x08));
+}
+
+static inline __attribute__((always_inline)) void enc10_y_row48_n(
+        const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned short *src, unsigned short *y, unsigned int width) {
+    struct enc48_consts e;
+    load_enc48_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i p[3];
+        deinterleave48(&e, src + x * 3, p);
+        _mm256_storeu_si256((__m256i *) (y + x), enc10_y16(&e, p, shift));
+    }
+
+    for (; x < width; ++x)
+        y[x] = csc_enc10_y48(k, src + x * 3) << shift;
+}
+
+static void enc10_y_row48(const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned short *src, unsigned short *y, unsigned int width) {
+    if (shift == 0)
+        enc10_y_row48_n(k, 0, src, y, width);
+    else
+        enc10_y_row48_n(k, 6, src, y, width);
+}
+
+static inline __attribute__((always_inline)) void enc10_sp_row48_n(
+        const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned short *src, unsigned short *y, unsigned short *c,
+        unsigned int width) {
+    struct enc48_consts e;
+    load_enc48_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i p[3];
+        __m128i u, v;
+        deinterleave48(&e, src + x * 3, p);
+        enc10_c48(&e, p, shift, &u, &v);
+        _mm256_storeu_si256((__m256i *) (y + x), enc10_y16(&e, p, shift));
+        _mm_storeu_si128((__m128i *) (c + x), _mm_unpacklo_epi16(u, v));
+        _mm_storeu_si128((__m128i *) (c + x + 8), _mm_unpackhi_epi16(u, v));
+    }
+
+    csc_enc10_row48_tail(k, shift, src, y, c, c + 1, 2, x, width);
+}
+
+static void enc10_sp_row48(const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned short *src, unsigned short *y, unsigned short *c,
+        unsigned int width) {
+    if (shift == 0)
+        enc10_sp_row48_n(k, 0, src, y, c, width);
+    else
+        enc10_sp_row48_n(k, 6, src, y, c, width);
+}
+
+static inline __attribute__((always_inline)) void enc10_p_row48_n(
+        const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned short *src, unsigned short *y,
+        unsigned short *c0, unsigned short *c1, unsigned int width) {
+    struct enc48_consts e;
+    load_enc48_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i p[3];
+        __m128i u, v;
+        deinterleave48(&e, src + x * 3, p);
+        enc10_c48(&e, p, shift, &u, &v);
+        _mm256_storeu_si256((__m256i *) (y + x), enc10_y16(&e, p, shift));
+        _mm_storeu_si128((__m128i *) (c0 + x / 2), u);
+        _mm_storeu_si128((__m128i *) (c1 + x / 2), v);
+    }
+
+    csc_enc10_row48_tail(k, shift, src, y, c0, c1, 1, x, width);
+}
+
+static void enc10_p_row48(const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned short *src, unsigned short *y,
+        unsigned short *c0, unsigned short *c1, unsigned int width) {
+    if (shift == 0)
+        enc10_p_row48_n(k, 0, src, y, c0, c1, width);
+    else
+        enc10_p_row48_n(k, 6, src, y, c0, c1, width);
+}
+
+/* adds_epu16 keeps the rounding from wrapping, packus saturates */
+static void narrow_row(const unsigned short *src, unsigned char *dst,
+        unsigned int count, unsigned int drop) {
+    const __m256i round = _mm256_set1_epi16(1 << (drop - 1));
+
+    unsigned int x = 0;
+    for (; x + 32 <= count; x += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (src + x));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (src + x + 16));
+        a = _mm256_srli_epi16(_mm256_adds_epu16(a, round), drop);
+        b = _mm256_srli_epi16(_mm256_adds_epu16(b, round), drop);
+        _mm256_storeu_si256((__m256i *) (dst + x), _mm256_permute4x64_epi64(
+                _mm256_packus_epi16(a, b), 0xd8));
+    }
+
+    csc_narrow_tail(src, dst, x, count, drop);
+}
+
+static void widen_row(const unsigned char *src, unsigned short *dst,
+        unsigned int count, unsigned int shift) {
+    unsigned int x = 0;
+    for (; x + 32 <= count; x += 32) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src + x));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + x + 16));
+        _mm256_storeu_si256((__m256i *) (dst + x),
+                _mm256_slli_epi16(_mm256_cvtepu8_epi16(a), shift));
+        _mm256_storeu_si256((__m256i *) (dst + x + 16),
+                _mm256_slli_epi16(_mm256_cvtepu8_epi16(b), shift));
+    }
+
+    csc_widen_tail(src, dst, x, count, shift);
+}
+
+static void swap_rgb_row(unsigned char *row, unsigned int width) {
+    __m256i m[3][3];
+    for (int o = 0; o < 3; ++o)
+        for (int i = 0; i < 3; ++i)
+            m[o][i] = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+                    (const __m128i *) csc_swap_mask[o][i]));
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        unsigned char *p = row + x * 3, *q = p + 48;
+        __m256i a = load2(p, q);
+        __m256i b = load2(p + 16, q + 16);
+        __m256i c = load2(p + 32, q + 32);
+        store2(p, q, _mm256_or_si256(_mm256_shuffle_epi8(a, m[0][0]),
+                _mm256_shuffle_epi8(b, m[0][1])));
+        store2(p + 16, q + 16, _mm256_or_si256(_mm256_or_si256(
+                _mm256_shuffle_epi8(a, m[1][0]),
+                _mm256_shuffle_epi8(b, m[1][1])),
+                _mm256_shuffle_epi8(c, m[1][2])));
+        store2(p + 32, q + 32, _mm256_or_si256(
+                _mm256_shuffle_epi8(b, m[2][1]),
+                _mm256_shuffle_epi8(c, m[2][2])));
+    }
+
+    csc_swap_rgb_tail(row, x, width);
+}
+
+static void swap_pairs_row(unsigned char *row, unsigned int count) {
+    const __m256i mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+            9, 8, 11, 10, 13, 12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6,
+            9, 8, 11, 10, 13, 12, 15, 14);
+
+    unsigned int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        __m256i *p = (__m256i *) (row + x * 2);
+        _mm256_storeu_si256(p,
+                _mm256_shuffle_epi8(_mm256_loadu_si256(p), mask));
+    }
+
+    csc_swap_pairs_tail(row, x, count);
+}
+
+static void swap_rows(unsigned char *a, unsigned char *b, unsigned int count) {
+    unsigned int x = 0;
+    for (; x + 32 <= count; x += 32) {
+        __m256i va = _mm256_loadu_si256((const __m256i *) (a + x));
+        __m256i vb = _mm256_loadu_si256((const __m256i *) (b + x));
+        _mm256_storeu_si256((__m256i *) (a + x), vb);
+        _mm256_storeu_si256((__m256i *) (b + x), va);
+    }
+
+    csc_swap_rows_tail(a, b, x, count);
+}
+
+static void stream_row(unsigned char *dst, const unsigned char *src,
+        size_t size) {
+    size_t x = -(uintptr_t) dst & 31;
+    if (x > size)
+        x = size;
+    memcpy(dst, src, x);
+
+    for (; x + 32 <= size; x += 32)
+        _mm256_stream_si256((__m256i *) (dst + x),
+                _mm256_loadu_si256((const __m256i *) (src + x)));
+
+    memcpy(dst + x, src + x, size - x);
+    _mm_sfence();
+}
+
+/* The 16-bit sums stay below 2^16, so the logical shift is exact */
+static void lerp_row(const unsigned char *a, const unsigned char *b,
+        unsigned int f, unsigned char *dst, unsigned int count) {
+    const __m256i wa = _mm256_set1_epi16(256 - f), wb = _mm256_set1_epi16(f);
+    const __m256i round = _mm256_set1_epi16(128);
+
+    unsigned int x = 0;
+    for (; x + 32 <= count; x += 32) {
+        __m256i va = _mm256_loadu_si256((const __m256i *) (a + x));
+        __m256i vb = _mm256_loadu_si256((const __m256i *) (b + x));
+        __m256i lo = _mm256_add_epi16(_mm256_add_epi16(
+                _mm256_mullo_epi16(_mm256_cvtepu8_epi16(
+                _mm256_castsi256_si128(va)), wa),
+                _mm256_mullo_epi16(_mm256_cvtepu8_epi16(
+                _mm256_castsi256_si128(vb)), wb)), round);
+        __m256i hi = _mm256_add_epi16(_mm256_add_epi16(
+                _mm256_mullo_epi16(_mm256_cvtepu8_epi16(
+                _mm256_extracti128_si256(va, 1)), wa),
+                _mm256_mullo_epi16(_mm256_cvtepu8_epi16(
+                _mm256_extracti128_si256(vb, 1)), wb)), round);
+        /* packus works per lane: put the quarters back in order */
+        _mm256_storeu_si256((__m256i *) (dst + x), _mm256_permute4x64_epi64(
+                _mm256_packus_epi16(_mm256_srli_epi16(lo, 8),
+                _mm256_srli_epi16(hi, 8)), 0xd8));
+    }
+
+    csc_lerp_tail(a, b, f, dst, x, count);
+}
+
+const struct csc_simd_kernels csc_simd_kernels_avx2 = {
+    .enc_y_row      = enc_y_row,
+    .enc_sp_row     = enc_sp_row,
+    .enc_p_row      = enc_p_row,
+    .dec_sp_rows    = dec_sp_rows,
+    .dec_p_rows     = dec_p_rows,
+    .enc_y_row4     = enc_y_row4,
+    .enc_sp_row4    = enc_sp_row4,
+    .enc_p_row4     = enc_p_row4,
+    .dec_sp_rows4   = dec_sp_rows4,
+    .dec_p_rows4    = dec_p_rows4,
+    .unpack422_sp_rows = unpack422_sp_rows,
+    .unpack422_p_rows  = unpack422_p_rows,
+    .dec10_sp_rows  = dec10_sp_rows,
+    .dec10_p_rows   = dec10_p_rows,
+    .enc10_y_row    = enc10_y_row,
+    .enc10_sp_row   = enc10_sp_row,
+    .enc10_p_row    = enc10_p_row,
+    .dec10_sp_rows48 = dec10_sp_rows48,
+    .dec10_p_rows48  = dec10_p_rows48,
+    .enc10_y_row48   = enc10_y_row48,
+    .enc10_sp_row48  = enc10_sp_row48,
+    .enc10_p_row48   = enc10_p_row48,
+    .narrow_row     = narrow_row,
+    .widen_row      = widen_row,
+    .swap_rgb_row   = swap_rgb_row,
+    .swap_pairs_row = swap_pairs_row,
+    .swap_rows      = swap_rows,
+    .stream_row     = stream_row,
+    .lerp_row       = lerp_row,
+};
+
+#endif // __AVX2__
@@ -0,0 +1,471 @@
+/*
+ * conv_rgb_yuv_mt.c
+ *
+ * Persistent worker pool for the _mt conversions.
+ */
+
+#define _GNU_SOURCE
+
+#include "conv_rgb_yuv_mt.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* more bands than threads so a preempted worker does not stall the call */
+#define BANDS_PER_THREAD    4
+
+/* spin this many times before sleeping on the condition variables */
+#define SPIN_COUNT          4000
+
+/* a batch splits a frame into bands of at least this many pixels */
+#define MIN_BAND_PIXELS     (1 << 16)
+
+/* last-level cache size to assume when sysconf() does not know */
+#define DEFAULT_CACHE_SIZE  (8 << 20)
+
+/* scratch is allocated in whole cache lines */
+#define SCRATCH_ALIGN       64
+
+/* A band of one job of a batch */
+struct unit {
+    const struct csc_job *job;
+    unsigned int h0, h1;
+};
+
+/*
+ * A contiguous run of units, first taken by one thread. Its owner and any
+ * thread that has run out of work claim units from next, so a slice of
+ * large frames is shared out once the slices of small ones are done.
+ */
+struct slice {
+    atomic_uint next;
+    unsigned int end;
+} __attribute__((aligned(64)));
+
+struct csc_ctx {
+    unsigned int n_threads;
+    pthread_t *workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    int quit;
+
+    void (*run)(csc_ctx *ctx);
+    atomic_uint busy;
+    atomic_ulong generation;
+
+    /* csc_run() */
+    const struct csc_job *job;
+    unsigned int band_rows;
+    unsigned int n_bands;
+    atomic_uint next_band;
+
+    /* csc_run_batch(), the arrays kept from batch to batch */
+    struct unit *units;
+    unsigned int units_size;
+    struct slice *slices;
+    unsigned int n_slices;
+    atomic_uint next_slice;
+    size_t scratch;                 /* the most any job of it needs */
+};
+
+/*
+ * The thread's scratch and batch jobs, their allocations freed with the
+ * thread by the keys
+ */
+static _Thread_local unsigned char *scratch;
+static _Thread_local size_t scratch_size;
+static _Thread_local struct csc_job *jobs;
+static _Thread_local unsigned int jobs_size;
+static pthread_key_t scratch_key, jobs_key;
+static pthread_once_t keys_once = PTHREAD_ONCE_INIT;
+
+static void keys_create(void) {
+    pthread_key_create(&scratch_key, free);
+    pthread_key_create(&jobs_key, free);
+}
+
+unsigned char *csc_scratch(void) {
+    return scratch;
+}
+
+int csc_reserve_scratch(size_t size) {
+    if (size <= scratch_size)
+        return 0;
+
+    pthread_once(&keys_once, keys_create);
+    size = (size + SCRATCH_ALIGN - 1) & ~(size_t) (SCRATCH_ALIGN - 1);
+    unsigned char *buf = aligned_alloc(SCRATCH_ALIGN, size);
+    if (buf == NULL)
+        return -1;
+
+    free(pthread_getspecific(scratch_key));
+    pthread_setspecific(scratch_key, buf);
+    scratch = buf;
+    scratch_size = size;
+
+    return 0;
+}
+
+struct csc_job *csc_reserve_jobs(unsigned int count) {
+    if (count == 0)
+        return NULL;
+    if (count <= jobs_size)
+        return jobs;
+
+    pthread_once(&keys_once, keys_create);
+    struct csc_job *buf = malloc(count * sizeof(*buf));
+    if (buf == NULL)
+        return NULL;
+
+    free(pthread_getspecific(jobs_key));
+    pthread_setspecific(jobs_key, buf);
+    jobs = buf;
+    jobs_size = count;
+
+    return jobs;
+}
+
+static void run_bands(csc_ctx *ctx) {
+    const struct csc_job *job = ctx->job;
+    unsigned int band;
+    if (csc_reserve_scratch(job->scratch) != 0)
+        return;
+
+    while ((band = atomic_fetch_add_explicit(&ctx->next_band, 1,
+            memory_order_relaxed)) < ctx->n_bands) {
+        unsigned int h0 = band * ctx->band_rows;
+        unsigned int h1 = h0 + ctx->band_rows;
+        job->rows(job, h0, h1 < job->height ? h1 : job->height);
+    }
+}
+
+static void *worker_main(void *arg) {
+    csc_ctx *ctx = arg;
+    unsigned long seen = 0;
+
+    for (;;) {
+        unsigned long gen;
+        for (int i = 0; i < SPIN_COUNT; ++i) {
+            gen = atomic_load_explicit(&ctx->generation, memory_order_acquire);
+            if (gen != seen)
+                break;
+            cpu_relax();
+        }
+
+        if (gen == seen) {
+            pthread_mutex_lock(&ctx->lock);
+            while ((gen = atomic_load(&ctx->generation)) == seen && !ctx->quit)
+                pthread_cond_wait(&ctx->start, &ctx->lock);
+            pthread_mutex_unlock(&ctx->lock);
+            if (gen == seen)
+                break;
+        }
+
+        seen = gen;
+        ctx->run(ctx);
+
+        if (atomic_fetch_sub(&ctx->busy, 1) == 1) {
+            pthread_mutex_lock(&ctx->lock);
+            pthread_cond_signal(&ctx->done);
+            pthread_mutex_unlock(&ctx->lock);
+        }
+    }
+
+    return NULL;
+}
+
+/* Worker i goes to the (i + 1)th CPU we may run on, the caller keeps its own */
+static void pin_workers(csc_ctx *ctx) {
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 ||
+            (unsigned int) CPU_COUNT(&allowed) < ctx->n_threads)
+        return;
+
+    unsigned int worker = 0, nth = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && worker + 1 < ctx->n_threads; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed) || nth++ == 0)
+            continue;
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(ctx->workers[worker++], sizeof(set), &set);
+    }
+#else
+    (void) ctx;
+#endif
+}
+
+csc_ctx *csc_ctx_create(unsigned int n_threads) {
+    if (n_threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = online > 0 ? online : 1;
+    }
+
+    csc_ctx *ctx = calloc(1, sizeof(*ctx));
+    if (ctx == NULL)
+        return NULL;
+
+    ctx->workers = calloc(n_threads, sizeof(pthread_t));
+    ctx->slices = aligned_alloc(sizeof(*ctx->slices),
+            n_threads * sizeof(*ctx->slices));
+    if (ctx->workers == NULL || ctx->slices == NULL) {
+        free(ctx->slices);
+        free(ctx->workers);
+        free(ctx);
+        return NULL;
+    }
+
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->start, NULL);
+    pthread_cond_init(&ctx->done, NULL);
+    atomic_init(&ctx->next_band, 0);
+    atomic_init(&ctx->next_slice, 0);
+    atomic_init(&ctx->busy, 0);
+    atomic_init(&ctx->generation, 0);
+
+    /* the calling thread is the first of n_threads */
+    ctx->n_threads = 1;
+    while (ctx->n_threads < n_threads) {
+        if (pthread_create(&ctx->workers[ctx->n_threads - 1], NULL,
+                worker_main, ctx) != 0)
+            break;
+        ++ctx->n_threads;
+    }
+
+    pin_workers(ctx);
+
+    return ctx;
+}
+
+void csc_ctx_destroy(csc_ctx *ctx) {
+    if (ctx == NULL)
+        return;
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->quit = 1;
+    pthread_cond_broadcast(&ctx->start);
+    pthread_mutex_unlock(&ctx->lock);
+
+    for (unsigned int i = 0; i + 1 < ctx->n_threads; ++i)
+        pthread_join(ctx->workers[i], NULL);
+
+    pthread_cond_destroy(&ctx->done);
+    pthread_cond_destroy(&ctx->start);
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx->units);
+    free(ctx->slices);
+    free(ctx->workers);
+    free(ctx);
+}
+
+unsigned int csc_ctx_threads(const csc_ctx *ctx) {
+    return ctx != NULL ? ctx->n_threads : 1;
+}
+
+/*
+ * Run ctx->run on every thread of the ctx, the caller included. Called
+ * with ctx->lock held and the job set up, releases the lock.
+ */
+static void dispatch(csc_ctx *ctx) {
+    atomic_store(&ctx->busy, ctx->n_threads - 1);
+    atomic_fetch_add_explicit(&ctx->generation, 1, memory_order_release);
+    pthread_cond_broadcast(&ctx->start);
+    pthread_mutex_unlock(&ctx->lock);
+
+    ctx->run(ctx);
+
+    for (int i = 0; i < SPIN_COUNT && atomic_load(&ctx->busy) != 0; ++i)
+        cpu_relax();
+
+    if (atomic_load(&ctx->busy) != 0) {
+        pthread_mutex_lock(&ctx->lock);
+        while (atomic_load(&ctx->busy) != 0)
+            pthread_cond_wait(&ctx->done, &ctx->lock);
+        pthread_mutex_unlock(&ctx->lock);
+    }
+}
+
+static int run_job(csc_ctx *ctx, const struct csc_job *job) {
+    unsigned int pairs = (job->height + 1) / 2;
+    if (csc_reserve_scratch(job->scratch) != 0)
+        return -1;
+    if (ctx == NULL || ctx->n_threads < 2 || pairs < 2) {
+        job->rows(job, 0, job->height);
+        return 0;
+    }
+
+    unsigned int bands = ctx->n_threads * BANDS_PER_THREAD;
+    if (bands > pairs)
+        bands = pairs;
+    unsigned int band_pairs = (pairs + bands - 1) / bands;
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->run = run_bands;
+    ctx->job = job;
+    ctx->band_rows = band_pairs * 2;
+    ctx->n_bands = (pairs + band_pairs - 1) / band_pairs;
+    atomic_store(&ctx->next_band, 0);
+    dispatch(ctx);
+
+    return 0;
+}
+
+static void drain_slice(struct slice *slice, const struct unit *units) {
+    unsigned int i;
+    while ((i = atomic_fetch_add_explicit(&slice->next, 1,
+            memory_order_relaxed)) < slice->end)
+        units[i].job->rows(units[i].job, units[i].h0, units[i].h1);
+}
+
+/* Own slice first, then steal from the others in turn */
+static void run_units(csc_ctx *ctx) {
+    unsigned int own = atomic_fetch_add_explicit(&ctx->next_slice, 1,
+            memory_order_relaxed) % ctx->n_slices;
+    if (csc_reserve_scratch(ctx->scratch) != 0)
+        return;
+
+    for (unsigned int i = 0; i < ctx->n_slices; ++i)
+        drain_slice(&ctx->slices[(own + i) % ctx->n_slices], ctx->units);
+}
+
+/* ctx->units grown to hold n, 0 or -1 */
+static int reserve_units(csc_ctx *ctx, unsigned int n) {
+    if (n <= ctx->units_size)
+        return 0;
+
+    struct unit *units = malloc(n * sizeof(*units));
+    if (units == NULL)
+        return -1;
+
+    free(ctx->units);
+    ctx->units = units;
+    ctx->units_size = n;
+
+    return 0;
+}
+
+/* Bands of a job in a batch: whole small frames, large ones split */
+static unsigned int job_bands(const struct csc_job *job) {
+    unsigned int pairs = (job->height + 1) / 2;
+    size_t bands = (size_t) job->width * job->height / MIN_BAND_PIXELS;
+
+    return bands < 1 ? 1 : bands > pairs ? pairs : (unsigned int) bands;
+}
+
+static int run_batch(csc_ctx *ctx, const struct csc_job *jobs,
+        unsigned int count) {
+    unsigned int n_units = 0;
+    size_t size = 0;
+    for (unsigned int j = 0; j < count; ++j) {
+        n_units += job_bands(&jobs[j]);
+        if (jobs[j].scratch > size)
+            size = jobs[j].scratch;
+    }
+    if (csc_reserve_scratch(size) != 0)
+        return -1;
+
+    if (ctx == NULL || ctx->n_threads < 2 || n_units < 2 ||
+            reserve_units(ctx, n_units) != 0) {
+        for (unsigned int j = 0; j < count; ++j)
+            run_job(ctx, &jobs[j]);
+        return 0;
+    }
+
+    struct unit *units = ctx->units;
+    struct slice *slices = ctx->slices;
+    unsigned int u = 0;
+    for (unsigned int j = 0; j < count; ++j) {
+        unsigned int bands = job_bands(&jobs[j]);
+        unsigned int pairs = (jobs[j].height + 1) / 2;
+        for (unsigned int b = 0; b < bands; ++b) {
+            units[u].job = &jobs[j];
+            units[u].h0 = (size_t) pairs * b / bands * 2;
+            units[u].h1 = b + 1 < bands ?
+                    (size_t) pairs * (b + 1) / bands * 2 : jobs[j].height;
+            ++u;
+        }
+    }
+
+    unsigned int n_slices = ctx->n_threads;
+    for (unsigned int i = 0; i < n_slices; ++i) {
+        atomic_init(&slices[i].next, n_units * i / n_slices);
+        slices[i].end = n_units * (i + 1) / n_slices;
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->run = run_units;
+    ctx->n_slices = n_slices;
+    ctx->scratch = size;
+    atomic_store(&ctx->next_slice, 0);
+    dispatch(ctx);
+
+    return 0;
+}
+
+int csc_run(csc_ctx *ctx, const struct csc_job *job) {
+#ifdef CSC_STATS
+    unsigned long long start = csc_stats_now();
+    if (run_job(ctx, job) != 0)
+        return -1;
+    csc_stats_record(job, start, csc_stats_now() - start);
+
+    return 0;
+#else
+    return run_job(ctx, job);
+#endif
+}
+
+/* With the stats built in each frame of a batch gets an equal share */
+int csc_run_batch(csc_ctx *ctx, const struct csc_job *jobs,
+        unsigned int count) {
+#ifdef CSC_STATS
+    unsigned long long start = csc_stats_now();
+    if (run_batch(ctx, jobs, count) != 0)
+        return -1;
+    unsigned long long ns = count != 0 ?
+            (csc_stats_now() - start) / count : 0;
+    for (unsigned int j = 0; j < count; ++j)
+        csc_stats_record(&jobs[j], start, ns);
+
+    return 0;
+#else
+    return run_batch(ctx, jobs, count);
+#endif
+}
+
+void csc_run_scratch(const struct csc_job *job, unsigned char *buf) {
+    unsigned char *own = scratch;
+    size_t own_size = scratch_size;
+
+    scratch = buf;
+    scratch_size = job->scratch;
+    csc_run(NULL, job);
+    scratch = own;
+    scratch_size = own_size;
+}
+
+/* Looked up once, by whichever thread asks first */
+static size_t cache_size;
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+
+static void cache_size_init(void) {
+    long size = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (size <= 0)
+        size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    cache_size = size > 0 ? (size_t) size : DEFAULT_CACHE_SIZE;
+}
+
+size_t csc_cache_size(void) {
+    pthread_once(&cache_once, cache_size_init);
+    return cache_size;
+}
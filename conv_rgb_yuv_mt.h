@@ -0,0 +1,97 @@
+/*
+ * conv_rgb_yuv_mt.h
+ *
+ * Internal: row-band jobs and the worker pool behind csc_ctx.
+ */
+
+#ifndef CONV_RGB_YUV_MT_H_
+#define CONV_RGB_YUV_MT_H_
+
+#include "conv_rgb_yuv.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() do {} while (0)
+#endif
+
+struct csc_job;
+struct tensor_lut;
+struct tap;
+
+/* Convert rows [h0, h1) of the frame, h0 and h1 even */
+typedef void (*csc_rows_fn)(const struct csc_job *job,
+        unsigned int h0, unsigned int h1);
+
+struct csc_job {
+    csc_rows_fn rows;
+    csc_frame src, dst;
+    unsigned int width, height;     /* of the output */
+    unsigned int shift;             /* log2 of the downscale factor */
+    csc_rect crop;                  /* of the output within the rows */
+    const struct tensor_lut *lut;   /* of the _tensor output */
+    csc_rows_fn inner;              /* rows under stream_rows() and */
+    int src_layout, dst_layout;     /* resize_rows(), enum plane_layout */
+    unsigned int in_width, in_height;   /* of the resize_rows() source */
+    const struct tap *taps;         /* its columns and rows, resize_taps() */
+    size_t scratch;                 /* bytes of csc_scratch() rows uses */
+};
+
+/*
+ * Run job->rows over the whole frame. With a ctx the frame is split into
+ * even-row bands shared by the workers and the calling thread, without a
+ * ctx it runs in one go on the calling thread. Returns 0, or -1 with
+ * nothing converted when the calling thread's scratch cannot be had; a
+ * worker without its scratch leaves its bands to the others.
+ */
+extern int csc_run(csc_ctx *ctx, const struct csc_job *job);
+
+/*
+ * Run count jobs as one unit of work: small frames are not split and
+ * large ones are cut into bands, and the threads steal from each other
+ * so mixed sizes finish together. 0 or -1 like csc_run().
+ */
+extern int csc_run_batch(csc_ctx *ctx, const struct csc_job *jobs,
+        unsigned int count);
+
+/*
+ * Scratch memory of the calling thread for the row functions, at least
+ * job->scratch bytes while job->rows runs under csc_run(). It is kept
+ * from job to job and only grows, so a stream of frames allocates it
+ * once; csc_reserve_scratch() grows it for rows called directly.
+ */
+extern unsigned char *csc_scratch(void);
+
+/* 0, or -1 if size bytes of scratch cannot be had */
+extern int csc_reserve_scratch(size_t size);
+
+/*
+ * An array of count jobs for the calling thread to fill and hand to
+ * csc_run_batch(), kept and grown like the scratch. NULL for count 0 or
+ * if it cannot be had.
+ */
+extern struct csc_job *csc_reserve_jobs(unsigned int count);
+
+/* csc_run() without a ctx, with buf instead of the thread's scratch */
+extern void csc_run_scratch(const struct csc_job *job, unsigned char *buf);
+
+/* Set up job to convert src to dst with plan, 0 or -1 if they do not fit */
+extern int csc_plan_job(const csc_plan *plan, const csc_frame *src,
+        const csc_frame *dst, struct csc_job *job);
+
+/* Size of the last-level cache, a guess where it cannot be queried */
+extern size_t csc_cache_size(void);
+
+#ifdef CSC_STATS
+/* Monotonic clock in ns */
+extern unsigned long long csc_stats_now(void);
+
+/* Count a job run by csc_run() for the csc_stats_ functions */
+extern void csc_stats_record(const struct csc_job *job,
+        unsigned long long start, unsigned long long ns);
+
+/* Formats of the conversion job runs, -1 for the _tensor functions */
+extern void csc_job_formats(const struct csc_job *job, int *src, int *dst);
+#endif
+
+#endif // CONV_RGB_YUV_MT_H_
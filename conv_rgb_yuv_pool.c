@@ -0,0 +1,190 @@
+/*
+ * conv_rgb_yuv_pool.c
+ *
+ * Preallocated frame buffers handed out and taken back without locks.
+ */
+
+#define _GNU_SOURCE
+
+#include "conv_rgb_yuv.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#define BUF_ALIGN   64
+#define HUGE_PAGE   ((size_t) 2 << 20)
+
+/*
+ * The free buffers form a stack linked through next[], by index + 1 so
+ * that 0 ends it. head holds the top in its low half and a count of pops
+ * and pushes in its high half, so a compare-and-swap fails if the top was
+ * taken and put back in between (ABA).
+ */
+struct csc_pool {
+    atomic_ullong head __attribute__((aligned(64)));
+
+    int format;
+    size_t width, height;
+    size_t slot;            /* bytes of a frame, rounded up */
+    unsigned int count;
+    unsigned char *base;
+    size_t mapped;          /* bytes mapped at base, 0 if from malloc */
+    atomic_uint *next;
+};
+
+static unsigned char *alloc_buffers(size_t size, unsigned int flags,
+        size_t *mapped) {
+    *mapped = 0;
+#ifdef __linux__
+    void *p = MAP_FAILED;
+    size_t huge = (size + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+    if (flags & CSC_POOL_HUGE_PAGES)
+        p = mmap(NULL, huge, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        *mapped = huge;
+        return p;
+    }
+
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p != MAP_FAILED) {
+        /* no reserved huge pages: ask for transparent ones instead */
+        if (flags & CSC_POOL_HUGE_PAGES)
+            madvise(p, size, MADV_HUGEPAGE);
+        *mapped = size;
+        return p;
+    }
+
+    return NULL;
+#else
+    (void) flags;
+    return aligned_alloc(BUF_ALIGN, size);
+#endif
+}
+
+static void free_buffers(unsigned char *base, size_t mapped) {
+#ifdef __linux__
+    if (mapped != 0) {
+        munmap(base, mapped);
+        return;
+    }
+#endif
+    (void) mapped;
+    free(base);
+}
+
+static void push(csc_pool *pool, unsigned int i) {
+    unsigned long long old = atomic_load_explicit(&pool->head,
+            memory_order_relaxed);
+    unsigned long long top;
+    do {
+        atomic_store_explicit(&pool->next[i], (unsigned int) old,
+                memory_order_relaxed);
+        top = ((old >> 32) + 1) << 32 | (i + 1);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->head, &old, top,
+            memory_order_release, memory_order_relaxed));
+}
+
+/* Index of the buffer taken off the stack, -1 if it is empty */
+static long pop(csc_pool *pool) {
+    unsigned long long old = atomic_load_explicit(&pool->head,
+            memory_order_acquire);
+    unsigned long long top;
+    do {
+        unsigned int i = (unsigned int) old;
+        if (i == 0)
+            return -1;
+        top = ((old >> 32) + 1) << 32 |
+                atomic_load_explicit(&pool->next[i - 1], memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->head, &old, top,
+            memory_order_acquire, memory_order_acquire));
+
+    return (unsigned int) old - 1;
+}
+
+csc_pool *csc_pool_create(int format, size_t width, size_t height,
+        unsigned int count, unsigned int flags) {
+    size_t size = csc_frame_init_large(NULL, format, NULL, width, height);
+    if (size == 0 || count == 0)
+        return NULL;
+
+    size_t slot = (size + BUF_ALIGN - 1) & ~(size_t) (BUF_ALIGN - 1);
+    if (slot > SIZE_MAX / count)
+        return NULL;
+
+    csc_pool *pool = aligned_alloc(64, sizeof(*pool));
+    if (pool == NULL)
+        return NULL;
+
+    memset(pool, 0, sizeof(*pool));
+    pool->format = format;
+    pool->width = width;
+    pool->height = height;
+    pool->slot = slot;
+    pool->count = count;
+    pool->next = malloc(count * sizeof(*pool->next));
+    pool->base = alloc_buffers(slot * count, flags, &pool->mapped);
+    if (pool->next == NULL || pool->base == NULL) {
+        free(pool->next);
+        if (pool->base != NULL)
+            free_buffers(pool->base, pool->mapped);
+        free(pool);
+        return NULL;
+    }
+
+    if (flags & CSC_POOL_PREFAULT)
+        memset(pool->base, 0, slot * count);
+
+    atomic_init(&pool->head, 0);
+    for (unsigned int i = count; i-- > 0; ) {
+        atomic_init(&pool->next[i], 0);
+        push(pool, i);
+    }
+
+    return pool;
+}
+
+void csc_pool_destroy(csc_pool *pool) {
+    if (pool == NULL)
+        return;
+
+    free_buffers(pool->base, pool->mapped);
+    free(pool->next);
+    free(pool);
+}
+
+unsigned char *csc_pool_get(csc_pool *pool, csc_frame *frame) {
+    if (pool == NULL)
+        return NULL;
+
+    long i = pop(pool);
+    if (i < 0)
+        return NULL;
+
+    unsigned char *buf = pool->base + pool->slot * i;
+    if (frame != NULL)
+        csc_frame_init_large(frame, pool->format, buf,
+                pool->width, pool->height);
+
+    return buf;
+}
+
+int csc_pool_put(csc_pool *pool, unsigned char *buf) {
+    if (pool == NULL)
+        return -1;
+
+    size_t offset = (uintptr_t) buf - (uintptr_t) pool->base;
+    if (offset % pool->slot != 0 || offset / pool->slot >= pool->count)
+        return -1;
+
+    push(pool, offset / pool->slot);
+
+    return 0;
+}
@@ -0,0 +1,431 @@
+/*
+ * conv_rgb_yuv_queue.c
+ *
+ * Asynchronous conversions: a bounded lock-free queue of frames drained
+ * by threads of its own.
+ */
+
+#define _GNU_SOURCE
+
+#include "conv_rgb_yuv_mt.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+/* spin this many times before sleeping on the semaphore */
+#define SPIN_COUNT  4000
+
+/*
+ * A bounded multi-producer multi-consumer ring of indices. Each cell's
+ * seq says whose turn it is: pos when free for the push at pos, pos + 1
+ * when full for the pop at pos, so threads only meet on head and tail.
+ */
+struct cell {
+    atomic_uint seq;
+    unsigned int value;
+};
+
+struct ring {
+    atomic_uint tail __attribute__((aligned(64)));
+    atomic_uint head __attribute__((aligned(64)));
+    unsigned int mask;
+    struct cell *cells;
+};
+
+struct item {
+    struct csc_job job;
+    csc_stream *stream;
+    unsigned int seq;               /* in the stream */
+    csc_done_fn done;
+    void *user;
+    unsigned char *scratch;         /* of the job, kept for the next */
+    size_t scratch_size;
+} __attribute__((aligned(64)));
+
+struct csc_queue {
+    struct ring submitted, completed, free;
+
+    struct item *items;
+    unsigned int size;              /* of the rings, a power of two */
+
+    sem_t ready;                    /* a post per submitted item */
+    atomic_int quit;
+    int fd;
+    unsigned int n_threads;
+    pthread_t *workers;
+};
+
+/*
+ * Items finish in any order and are completed in seq order: each waits
+ * in finished[] by seq until the thread completing the stream gets to
+ * it. At most size items are out, so their slots never collide.
+ */
+struct csc_stream {
+    csc_queue *queue;
+    atomic_uint next;               /* seq of the next item submitted */
+    atomic_int completing;          /* a thread is completing items */
+    atomic_uint active;             /* threads in complete_in_order() */
+    unsigned int completed;         /* seq of the next to complete */
+    atomic_uint *finished;          /* index + 1, 0 if not finished */
+};
+
+static int ring_init(struct ring *ring, unsigned int size) {
+    ring->cells = malloc(size * sizeof(*ring->cells));
+    if (ring->cells == NULL)
+        return -1;
+
+    ring->mask = size - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    for (unsigned int i = 0; i < size; ++i)
+        atomic_init(&ring->cells[i].seq, i);
+
+    return 0;
+}
+
+static int ring_push(struct ring *ring, unsigned int value) {
+    unsigned int pos = atomic_load_explicit(&ring->tail,
+            memory_order_relaxed);
+    for (;;) {
+        struct cell *cell = &ring->cells[pos & ring->mask];
+        int diff = (int) (atomic_load_explicit(&cell->seq,
+                memory_order_acquire) - pos);
+        if (diff < 0)
+            return -1;
+
+        if (diff == 0 && atomic_compare_exchange_weak_explicit(&ring->tail,
+                &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+            cell->value = value;
+            atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+            return 0;
+        }
+        if (diff > 0)
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    }
+}
+
+/* -1 if empty, or if the push of the first item has not finished yet */
+static int ring_pop(struct ring *ring, unsigned int *value) {
+    unsigned int pos = atomic_load_explicit(&ring->head,
+            memory_order_relaxed);
+    for (;;) {
+        struct cell *cell = &ring->cells[pos & ring->mask];
+        int diff = (int) (atomic_load_explicit(&cell->seq,
+                memory_order_acquire) - (pos + 1));
+        if (diff < 0)
+            return -1;
+
+        if (diff == 0 && atomic_compare_exchange_weak_explicit(&ring->head,
+                &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+            *value = cell->value;
+            atomic_store_explicit(&cell->seq, pos + ring->mask + 1,
+                    memory_order_release);
+            return 0;
+        }
+        if (diff > 0)
+            pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    }
+}
+
+static void signal_fd(csc_queue *queue) {
+#ifdef __linux__
+    uint64_t one = 1;
+    if (write(queue->fd, &one, sizeof(one)) < 0) {
+        /* only fails once the counter is near 2^64 */
+    }
+#else
+    (void) queue;
+#endif
+}
+
+static void complete(csc_queue *queue, unsigned int i) {
+    struct item *item = &queue->items[i];
+    if (item->done != NULL) {
+        item->done(item->user);
+        ring_push(&queue->free, i);
+    } else {
+        ring_push(&queue->completed, i);
+        signal_fd(queue);
+    }
+}
+
+static void complete_in_order(csc_queue *queue, csc_stream *stream) {
+    unsigned int mask = queue->size - 1;
+
+    /*
+     * Whoever finishes an item tries to complete the stream; one that
+     * finds another thread at it leaves its item to that thread, which
+     * looks again after letting go.
+     */
+    while (!atomic_exchange(&stream->completing, 1)) {
+        unsigned int seq = stream->completed;
+        unsigned int i;
+        while ((i = atomic_exchange(&stream->finished[seq & mask], 0)) != 0) {
+            complete(queue, i - 1);
+            ++seq;
+        }
+        stream->completed = seq;
+        atomic_store(&stream->completing, 0);
+
+        if (atomic_load(&stream->finished[seq & mask]) == 0)
+            break;
+    }
+}
+
+static void wait_ready(csc_queue *queue) {
+    for (int i = 0; i < SPIN_COUNT; ++i) {
+        if (sem_trywait(&queue->ready) == 0)
+            return;
+        cpu_relax();
+    }
+
+    while (sem_wait(&queue->ready) != 0 && errno == EINTR)
+        ;
+}
+
+static void *worker_main(void *arg) {
+    csc_queue *queue = arg;
+
+    for (;;) {
+        wait_ready(queue);
+
+        /* csc_queue_destroy() posts once per thread after the items */
+        unsigned int i;
+        while (ring_pop(&queue->submitted, &i) != 0) {
+            if (atomic_load(&queue->quit))
+                return NULL;
+            cpu_relax();
+        }
+
+        struct item *item = &queue->items[i];
+        csc_run_scratch(&item->job, item->scratch);
+
+        csc_stream *stream = item->stream;
+        if (stream == NULL) {
+            complete(queue, i);
+            continue;
+        }
+
+        /* counted before the item can complete, for csc_stream_destroy() */
+        atomic_fetch_add(&stream->active, 1);
+        atomic_store(&stream->finished[item->seq & (queue->size - 1)], i + 1);
+        complete_in_order(queue, stream);
+        atomic_fetch_sub(&stream->active, 1);
+    }
+}
+
+static void queue_free(csc_queue *queue) {
+#ifdef __linux__
+    if (queue->fd >= 0)
+        close(queue->fd);
+#endif
+    free(queue->submitted.cells);
+    free(queue->completed.cells);
+    free(queue->free.cells);
+    if (queue->items != NULL)
+        for (unsigned int i = 0; i < queue->size; ++i)
+            free(queue->items[i].scratch);
+    free(queue->items);
+    free(queue->workers);
+    free(queue);
+}
+
+csc_queue *csc_queue_create(unsigned int n_threads, unsigned int depth) {
+    if (depth == 0 || depth > UINT_MAX / 2 + 1)
+        return NULL;
+
+    if (n_threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = online > 0 ? online : 1;
+    }
+
+    csc_queue *queue = aligned_alloc(64, sizeof(*queue));
+    if (queue == NULL)
+        return NULL;
+
+    memset(queue, 0, sizeof(*queue));
+    queue->size = 1;
+    while (queue->size < depth)
+        queue->size *= 2;
+
+    queue->fd = -1;
+#ifdef __linux__
+    queue->fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+#endif
+    queue->items = aligned_alloc(64, queue->size * sizeof(*queue->items));
+    if (queue->items != NULL)
+        memset(queue->items, 0, queue->size * sizeof(*queue->items));
+    queue->workers = calloc(n_threads, sizeof(pthread_t));
+    if (ring_init(&queue->submitted, queue->size) != 0 ||
+            ring_init(&queue->completed, queue->size) != 0 ||
+            ring_init(&queue->free, queue->size) != 0 ||
+            queue->items == NULL || queue->workers == NULL) {
+        queue_free(queue);
+        return NULL;
+    }
+
+    for (unsigned int i = 0; i < depth; ++i)
+        ring_push(&queue->free, i);
+
+    sem_init(&queue->ready, 0, 0);
+    atomic_init(&queue->quit, 0);
+
+    while (queue->n_threads < n_threads) {
+        if (pthread_create(&queue->workers[queue->n_threads], NULL,
+                worker_main, queue) != 0)
+            break;
+        ++queue->n_threads;
+    }
+
+    if (queue->n_threads == 0) {
+        sem_destroy(&queue->ready);
+        queue_free(queue);
+        return NULL;
+    }
+
+    return queue;
+}
+
+void csc_queue_destroy(csc_queue *queue) {
+    if (queue == NULL)
+        return;
+
+    atomic_store(&queue->quit, 1);
+    for (unsigned int i = 0; i < queue->n_threads; ++i)
+        sem_post(&queue->ready);
+    for (unsigned int i = 0; i < queue->n_threads; ++i)
+        pthread_join(queue->workers[i], NULL);
+
+    sem_destroy(&queue->ready);
+    queue_free(queue);
+}
+
+csc_stream *csc_stream_create(csc_queue *queue) {
+    if (queue == NULL)
+        return NULL;
+
+    csc_stream *stream = malloc(sizeof(*stream));
+    if (stream == NULL)
+        return NULL;
+
+    stream->finished = malloc(queue->size * sizeof(*stream->finished));
+    if (stream->finished == NULL) {
+        free(stream);
+        return NULL;
+    }
+
+    stream->queue = queue;
+    atomic_init(&stream->next, 0);
+    atomic_init(&stream->completing, 0);
+    atomic_init(&stream->active, 0);
+    stream->completed = 0;
+    for (unsigned int i = 0; i < queue->size; ++i)
+        atomic_init(&stream->finished[i], 0);
+
+    return stream;
+}
+
+void csc_stream_destroy(csc_stream *stream) {
+    if (stream == NULL)
+        return;
+
+    /* its last items are complete, but not the threads completing them */
+    while (atomic_load(&stream->active) != 0)
+        sched_yield();
+
+    free(stream->finished);
+    free(stream);
+}
+
+static int item_scratch(struct item *item) {
+    if (item->job.scratch <= item->scratch_size)
+        return 0;
+
+    free(item->scratch);
+    item->scratch_size = 0;
+    item->scratch = aligned_alloc(64,
+            (item->job.scratch + 63) & ~(size_t) 63);
+    if (item->scratch == NULL)
+        return -1;
+
+    item->scratch_size = item->job.scratch;
+
+    return 0;
+}
+
+int csc_submit(csc_queue *queue, csc_stream *stream, const csc_plan *plan,
+        const csc_frame *src, const csc_frame *dst, csc_done_fn done,
+        void *user) {
+    if (queue == NULL || (stream != NULL && stream->queue != queue))
+        return -EINVAL;
+
+    unsigned int i;
+    if (ring_pop(&queue->free, &i) != 0)
+        return -EAGAIN;
+
+    /* the scratch is set up here, a worker has no way to fail */
+    struct item *item = &queue->items[i];
+    int err = 0;
+    if (csc_plan_job(plan, src, dst, &item->job) != 0)
+        err = -EINVAL;
+    else if (item_scratch(item) != 0)
+        err = -ENOMEM;
+    if (err != 0) {
+        ring_push(&queue->free, i);
+        return err;
+    }
+
+    /* the seq is taken last so that a failed submit leaves no gap */
+    item->stream = stream;
+    item->done = done;
+    item->user = user;
+    if (stream != NULL)
+        item->seq = atomic_fetch_add_explicit(&stream->next, 1,
+                memory_order_relaxed);
+
+    ring_push(&queue->submitted, i);
+    sem_post(&queue->ready);
+
+    return 0;
+}
+
+int csc_queue_fd(const csc_queue *queue) {
+    return queue != NULL ? queue->fd : -1;
+}
+
+unsigned int csc_queue_poll(csc_queue *queue, void **users,
+        unsigned int max) {
+    if (queue == NULL)
+        return 0;
+
+#ifdef __linux__
+    uint64_t count;
+    if (read(queue->fd, &count, sizeof(count)) < 0) {
+        /* EAGAIN: nothing signalled since the last poll */
+    }
+#endif
+
+    unsigned int n = 0, i;
+    while (n < max && ring_pop(&queue->completed, &i) == 0) {
+        users[n++] = queue->items[i].user;
+        ring_push(&queue->free, i);
+    }
+
+    /* the read reset the fd: set it again for what is left */
+    if (n == max)
+        signal_fd(queue);
+
+    return n;
+}
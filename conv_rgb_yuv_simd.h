@@ -0,0 +1,590 @@
+/*
+ * conv_rgb_yuv_simd.h
+ *
+ * Internal row kernels shared by the scalar driver in conv_rgb_yuv.c and
+ * the SSE4.1/AVX2 implementations. Not part of the public API.
+ */
+
+#ifndef CONV_RGB_YUV_SIMD_H_
+#define CONV_RGB_YUV_SIMD_H_
+
+#include <stddef.h>
+
+/*
+ * Packed 24-bit pixels are handled by byte position (0, 1, 2) rather than
+ * by channel name: RGB and BGR differ only in the order of the weights.
+ * Chroma samples are likewise "first" and "second" in memory order, so
+ * NV12/NV21 and I420/YV12 share one kernel each.
+ *
+ * Y  = (y[0]*p0 + y[1]*p1 + y[2]*p2) >> 8 + y_off
+ * Cn = (c[n][0]*p0 + c[n][1]*p1 + c[n][2]*p2) >> 8 + 128
+ *
+ * Every partial sum fits in 16 bits, which the SIMD kernels rely on: the
+ * y weights add up to at most 256 and each chroma row to 0.
+ */
+struct csc_enc_coefs {
+    short y[3];
+    short c[2][3];
+    short y_off;
+};
+
+/*
+ * Pn = (y*Y + c[0][n]*C0 + c[1][n]*C1 + off[n]) >> 8, clipped to 0..255
+ *
+ * C0/C1 are the chroma samples in memory order and Pn the packed output
+ * byte n, so NV21 -> BGR is just another table.
+ */
+struct csc_dec_coefs {
+    short y;
+    short c[2][3];
+    int off[3];
+};
+
+/*
+ * Encode one row of width pixels (width even). The chroma variants also
+ * write width/2 samples taken from the even pixels of the row.
+ */
+typedef void (*csc_enc_y_row_fn)(const struct csc_enc_coefs *k,
+        const unsigned char *src, unsigned char *y, unsigned int width);
+typedef void (*csc_enc_sp_row_fn)(const struct csc_enc_coefs *k,
+        const unsigned char *src, unsigned char *y, unsigned char *c,
+        unsigned int width);
+typedef void (*csc_enc_p_row_fn)(const struct csc_enc_coefs *k,
+        const unsigned char *src, unsigned char *y,
+        unsigned char *c0, unsigned char *c1, unsigned int width);
+
+/*
+ * Decode a pair of rows sharing one chroma row into packed pixels.
+ * y1/d1 may be NULL to decode the first row only.
+ */
+typedef void (*csc_dec_sp_rows_fn)(const struct csc_dec_coefs *k,
+        const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c, unsigned char *d0, unsigned char *d1,
+        unsigned int width);
+typedef void (*csc_dec_p_rows_fn)(const struct csc_dec_coefs *k,
+        const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c0, const unsigned char *c1,
+        unsigned char *d0, unsigned char *d1, unsigned int width);
+
+/*
+ * The same for 4-byte pixels with the colour bytes at first..first + 2,
+ * first being 0 or 1. The encoders ignore the fourth byte, the decoders
+ * set it to 255.
+ */
+typedef void (*csc_enc_y_row4_fn)(const struct csc_enc_coefs *k,
+        unsigned int first, const unsigned char *src, unsigned char *y,
+        unsigned int width);
+typedef void (*csc_enc_sp_row4_fn)(const struct csc_enc_coefs *k,
+        unsigned int first, const unsigned char *src, unsigned char *y,
+        unsigned char *c, unsigned int width);
+typedef void (*csc_enc_p_row4_fn)(const struct csc_enc_coefs *k,
+        unsigned int first, const unsigned char *src, unsigned char *y,
+        unsigned char *c0, unsigned char *c1, unsigned int width);
+typedef void (*csc_dec_sp_rows4_fn)(const struct csc_dec_coefs *k,
+        unsigned int first, const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c, unsigned char *d0, unsigned char *d1,
+        unsigned int width);
+typedef void (*csc_dec_p_rows4_fn)(const struct csc_dec_coefs *k,
+        unsigned int first, const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c0, const unsigned char *c1,
+        unsigned char *d0, unsigned char *d1, unsigned int width);
+
+/*
+ * Split a pair of packed 4:2:2 rows, YUYV with first 0 or UYVY with first
+ * 1, into two Y rows and one row of chroma, each sample the average of
+ * the two rows rounded up. The interleaved variant keeps the chroma pairs
+ * in memory order and with s1 and y1 NULL splits s0 alone, its chroma
+ * as it is.
+ */
+typedef void (*csc_unpack422_sp_rows_fn)(unsigned int first,
+        const unsigned char *s0, const unsigned char *s1,
+        unsigned char *y0, unsigned char *y1, unsigned char *c,
+        unsigned int width);
+typedef void (*csc_unpack422_p_rows_fn)(unsigned int first,
+        const unsigned char *s0, const unsigned char *s1,
+        unsigned char *y0, unsigned char *y1,
+        unsigned char *c0, unsigned char *c1, unsigned int width);
+
+/*
+ * 10-bit samples in 16-bit words, shift being the position of the bits:
+ * 6 for P010, 0 for I010. The decoders use the 8-bit tables with the sums
+ * kept to 1/1024ths of a step and write packed 8-bit pixels; the encoders
+ * read them and write 10-bit samples, chroma from the even pixels as
+ * above.
+ */
+typedef void (*csc_dec10_sp_rows_fn)(const struct csc_dec_coefs *k,
+        unsigned int shift, const unsigned short *y0,
+        const unsigned short *y1, const unsigned short *c,
+        unsigned char *d0, unsigned char *d1, unsigned int width);
+typedef void (*csc_dec10_p_rows_fn)(const struct csc_dec_coefs *k,
+        unsigned int shift, const unsigned short *y0,
+        const unsigned short *y1, const unsigned short *c0,
+        const unsigned short *c1, unsigned char *d0, unsigned char *d1,
+        unsigned int width);
+typedef void (*csc_enc10_y_row_fn)(const struct csc_enc_coefs *k,
+        unsigned int shift, const unsigned char *src, unsigned short *y,
+        unsigned int width);
+typedef void (*csc_enc10_sp_row_fn)(const struct csc_enc_coefs *k,
+        unsigned int shift, const unsigned char *src, unsigned short *y,
+        unsigned short *c, unsigned int width);
+typedef void (*csc_enc10_p_row_fn)(const struct csc_enc_coefs *k,
+        unsigned int shift, const unsigned char *src, unsigned short *y,
+        unsigned short *c0, unsigned short *c1, unsigned int width);
+
+/*
+ * The same from and to RGB48: the decoders keep 16 bits of the sums,
+ * (s >> 2) + (s >> 10) clipped to 0..65535, and the encoders weight the
+ * 16-bit channels with the 8-bit tables in 8.16 fixed point.
+ */
+typedef void (*csc_dec10_sp_rows48_fn)(const struct csc_dec_coefs *k,
+        unsigned int shift, const unsigned short *y0,
+        const unsigned short *y1, const unsigned short *c,
+        unsigned short *d0, unsigned short *d1, unsigned int width);
+typedef void (*csc_dec10_p_rows48_fn)(const struct csc_dec_coefs *k,
+        unsigned int shift, const unsigned short *y0,
+        const unsigned short *y1, const unsigned short *c0,
+        const unsigned short *c1, unsigned short *d0, unsigned short *d1,
+        unsigned int width);
+typedef void (*csc_enc10_y_row48_fn)(const struct csc_enc_coefs *k,
+        unsigned int shift, const unsigned short *src, unsigned short *y,
+        unsigned int width);
+typedef void (*csc_enc10_sp_row48_fn)(const struct csc_enc_coefs *k,
+        unsigned int shift, const unsigned short *src, unsigned short *y,
+        unsigned short *c, unsigned int width);
+typedef void (*csc_enc10_p_row48_fn)(const struct csc_enc_coefs *k,
+        unsigned int shift, const unsigned short *src, unsigned short *y,
+        unsigned short *c0, unsigned short *c1, unsigned int width);
+
+/*
+ * count 16-bit samples to 8 bits with the low drop bits rounded off and
+ * saturated, or 8-bit samples to 16 bits shifted up by shift.
+ */
+typedef void (*csc_narrow_row_fn)(const unsigned short *src,
+        unsigned char *dst, unsigned int count, unsigned int drop);
+typedef void (*csc_widen_row_fn)(const unsigned char *src,
+        unsigned short *dst, unsigned int count, unsigned int shift);
+
+/*
+ * In-place swaps: bytes 0 and 2 of width packed pixels, the two bytes of
+ * count interleaved chroma pairs, or count bytes between two rows.
+ */
+typedef void (*csc_swap_row_fn)(unsigned char *row, unsigned int count);
+typedef void (*csc_swap_rows_fn)(unsigned char *a, unsigned char *b,
+        unsigned int count);
+
+/*
+ * Blend count bytes of two rows, weighting b by f / 256 (f up to 256) and
+ * rounding: the vertical pass of the bilinear resize.
+ */
+typedef void (*csc_lerp_row_fn)(const unsigned char *a,
+        const unsigned char *b, unsigned int f, unsigned char *dst,
+        unsigned int count);
+
+/*
+ * Copy size bytes with non-temporal stores, which go around the caches,
+ * and fence them so the copy is visible to other threads on return.
+ */
+typedef void (*csc_stream_row_fn)(unsigned char *dst,
+        const unsigned char *src, size_t size);
+
+struct csc_simd_kernels {
+    csc_enc_y_row_fn    enc_y_row;
+    csc_enc_sp_row_fn   enc_sp_row;
+    csc_enc_p_row_fn    enc_p_row;
+    csc_dec_sp_rows_fn  dec_sp_rows;
+    csc_dec_p_rows_fn   dec_p_rows;
+    csc_enc_y_row4_fn   enc_y_row4;
+    csc_enc_sp_row4_fn  enc_sp_row4;
+    csc_enc_p_row4_fn   enc_p_row4;
+    csc_dec_sp_rows4_fn dec_sp_rows4;
+    csc_dec_p_rows4_fn  dec_p_rows4;
+    csc_unpack422_sp_rows_fn unpack422_sp_rows;
+    csc_unpack422_p_rows_fn  unpack422_p_rows;
+    csc_dec10_sp_rows_fn dec10_sp_rows;
+    csc_dec10_p_rows_fn  dec10_p_rows;
+    csc_enc10_y_row_fn   enc10_y_row;
+    csc_enc10_sp_row_fn  enc10_sp_row;
+    csc_enc10_p_row_fn   enc10_p_row;
+    csc_dec10_sp_rows48_fn dec10_sp_rows48;
+    csc_dec10_p_rows48_fn  dec10_p_rows48;
+    csc_enc10_y_row48_fn   enc10_y_row48;
+    csc_enc10_sp_row48_fn  enc10_sp_row48;
+    csc_enc10_p_row48_fn   enc10_p_row48;
+    csc_narrow_row_fn   narrow_row;
+    csc_widen_row_fn    widen_row;
+    csc_swap_row_fn     swap_rgb_row;
+    csc_swap_row_fn     swap_pairs_row;
+    csc_swap_rows_fn    swap_rows;
+    csc_stream_row_fn   stream_row;
+    csc_lerp_row_fn     lerp_row;
+};
+
+extern const struct csc_simd_kernels csc_simd_kernels_sse41;
+extern const struct csc_simd_kernels csc_simd_kernels_avx2;
+
+/* NULL when the scalar code should be used */
+extern const struct csc_simd_kernels *csc_simd_kernels(void);
+
+/*
+ * pshufb masks splitting 16 packed pixels (three 16-byte vectors) into
+ * one vector per byte position: csc_deint_mask[position][vector].
+ */
+static const signed char csc_deint_mask[3][3][16] = {
+    {
+        { 0, 3, 6, 9, 12, 15, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+        { -128, -128, -128, -128, -128, -128, 2, 5, 8, 11, 14, -128, -128, -128, -128, -128 },
+        { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 1, 4, 7, 10, 13 },
+    },
+    {
+        { 1, 4, 7, 10, 13, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+        { -128, -128, -128, -128, -128, 0, 3, 6, 9, 12, 15, -128, -128, -128, -128, -128 },
+        { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 2, 5, 8, 11, 14 },
+    },
+    {
+        { 2, 5, 8, 11, 14, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+        { -128, -128, -128, -128, -128, 1, 4, 7, 10, 13, -128, -128, -128, -128, -128, -128 },
+        { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 0, 3, 6, 9, 12, 15 },
+    },
+};
+
+/* pshufb masks for the reverse: csc_int_mask[position][output vector] */
+static const signed char csc_int_mask[3][3][16] = {
+    {
+        { 0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128, -128, 5 },
+        { -128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128, 10, -128 },
+        { -128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15, -128, -128 },
+    },
+    {
+        { -128, 0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128, -128 },
+        { 5, -128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128, 10 },
+        { -128, -128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15, -128 },
+    },
+    {
+        { -128, -128, 0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128 },
+        { -128, 5, -128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128 },
+        { 10, -128, -128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15 },
+    },
+};
+
+/*
+ * The same for 8 RGB48 pixels, moving 16-bit channels:
+ * csc_deint16_mask[channel][vector] and csc_int16_mask[channel][vector].
+ */
+static const signed char csc_deint16_mask[3][3][16] = {
+    {
+        { 0, 1, 6, 7, 12, 13, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+        { -128, -128, -128, -128, -128, -128, 2, 3, 8, 9, 14, 15, -128, -128, -128, -128 },
+        { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 4, 5, 10, 11 },
+    },
+    {
+        { 2, 3, 8, 9, 14, 15, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+        { -128, -128, -128, -128, -128, -128, 4, 5, 10, 11, -128, -128, -128, -128, -128, -128 },
+        { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 0, 1, 6, 7, 12, 13 },
+    },
+    {
+        { 4, 5, 10, 11, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+        { -128, -128, -128, -128, 0, 1, 6, 7, 12, 13, -128, -128, -128, -128, -128, -128 },
+        { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 2, 3, 8, 9, 14, 15 },
+    },
+};
+
+static const signed char csc_int16_mask[3][3][16] = {
+    {
+        { 0, 1, -128, -128, -128, -128, 2, 3, -128, -128, -128, -128, 4, 5, -128, -128 },
+        { -128, -128, 6, 7, -128, -128, -128, -128, 8, 9, -128, -128, -128, -128, 10, 11 },
+        { -128, -128, -128, -128, 12, 13, -128, -128, -128, -128, 14, 15, -128, -128, -128, -128 },
+    },
+    {
+        { -128, -128, 0, 1, -128, -128, -128, -128, 2, 3, -128, -128, -128, -128, 4, 5 },
+        { -128, -128, -128, -128, 6, 7, -128, -128, -128, -128, 8, 9, -128, -128, -128, -128 },
+        { 10, 11, -128, -128, -128, -128, 12, 13, -128, -128, -128, -128, 14, 15, -128, -128 },
+    },
+    {
+        { -128, -128, -128, -128, 0, 1, -128, -128, -128, -128, 2, 3, -128, -128, -128, -128 },
+        { 4, 5, -128, -128, -128, -128, 6, 7, -128, -128, -128, -128, 8, 9, -128, -128 },
+        { -128, -128, 10, 11, -128, -128, -128, -128, 12, 13, -128, -128, -128, -128, 14, 15 },
+    },
+};
+
+/*
+ * pshufb mask gathering byte n of the four 4-byte pixels in a vector into
+ * dword n, the first step of splitting them by byte position.
+ */
+static const signed char csc_deint4_mask[16] = {
+    0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+};
+
+/*
+ * pshufb masks swapping bytes 0 and 2 of the 16 pixels in three 16-byte
+ * vectors: csc_swap_mask[output vector][input vector].
+ */
+static const signed char csc_swap_mask[3][3][16] = {
+    {
+        { 2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, -128 },
+        { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 1 },
+        { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+    },
+    {
+        { -128, 15, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+        { 0, -128, 4, 3, 2, 7, 6, 5, 10, 9, 8, 13, 12, 11, -128, 15 },
+        { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 0, -128 },
+    },
+    {
+        { -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+        { 14, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128 },
+        { -128, 3, 2, 1, 6, 5, 4, 9, 8, 7, 12, 11, 10, 15, 14, 13 },
+    },
+};
+
+static inline unsigned char csc_clip_u8(int value) {
+    return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+/* Scalar tails for the SIMD kernels, same arithmetic as the C code */
+static inline unsigned char csc_enc_y(const struct csc_enc_coefs *k,
+        const unsigned char *p) {
+    return csc_clip_u8(((k->y[0] * p[0] + k->y[1] * p[1] +
+            k->y[2] * p[2]) >> 8) + k->y_off);
+}
+
+static inline unsigned char csc_enc_c(const struct csc_enc_coefs *k, int n,
+        const unsigned char *p) {
+    return csc_clip_u8(((k->c[n][0] * p[0] + k->c[n][1] * p[1] +
+            k->c[n][2] * p[2]) >> 8) + 128);
+}
+
+static inline void csc_dec_pixel(const struct csc_dec_coefs *k,
+        int y, int c0, int c1, unsigned char *d) {
+    for (int n = 0; n < 3; ++n)
+        d[n] = csc_clip_u8((k->y * y + k->c[0][n] * c0 + k->c[1][n] * c1 +
+                k->off[n]) >> 8);
+}
+
+/* Scalar tail of the SIMD decoders, cstep is 2 for interleaved chroma */
+static inline void csc_dec_rows_tail(const struct csc_dec_coefs *k,
+        const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c0, const unsigned char *c1, unsigned int cstep,
+        unsigned char *d0, unsigned char *d1,
+        unsigned int x, unsigned int width) {
+    for (; x < width; x += 2) {
+        int u = c0[x / 2 * cstep], v = c1[x / 2 * cstep];
+        csc_dec_pixel(k, y0[x], u, v, d0 + x * 3);
+        csc_dec_pixel(k, y0[x + 1], u, v, d0 + x * 3 + 3);
+        if (y1 != NULL) {
+            csc_dec_pixel(k, y1[x], u, v, d1 + x * 3);
+            csc_dec_pixel(k, y1[x + 1], u, v, d1 + x * 3 + 3);
+        }
+    }
+}
+
+static inline void csc_dec_rows4_tail(const struct csc_dec_coefs *k,
+        unsigned int first, const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c0, const unsigned char *c1, unsigned int cstep,
+        unsigned char *d0, unsigned char *d1,
+        unsigned int x, unsigned int width) {
+    unsigned int alpha = first == 0 ? 3 : 0;
+    for (; x < width; x += 2) {
+        int u = c0[x / 2 * cstep], v = c1[x / 2 * cstep];
+        for (unsigned int i = 0; i < 2; ++i) {
+            csc_dec_pixel(k, y0[x + i], u, v, d0 + (x + i) * 4 + first);
+            d0[(x + i) * 4 + alpha] = 255;
+            if (y1 != NULL) {
+                csc_dec_pixel(k, y1[x + i], u, v, d1 + (x + i) * 4 + first);
+                d1[(x + i) * 4 + alpha] = 255;
+            }
+        }
+    }
+}
+
+/* 10-bit variants of the above, k the same 8-bit tables */
+static inline unsigned short csc_enc10_y(const struct csc_enc_coefs *k,
+        const unsigned char *p) {
+    int y = ((k->y[0] * p[0] + k->y[1] * p[1] + k->y[2] * p[2]) >> 6) +
+            k->y_off * 4;
+    return y < 0 ? 0 : y > 1023 ? 1023 : y;
+}
+
+static inline unsigned short csc_enc10_c(const struct csc_enc_coefs *k,
+        int n, const unsigned char *p) {
+    int c = ((k->c[n][0] * p[0] + k->c[n][1] * p[1] + k->c[n][2] * p[2]) >>
+            6) + 512;
+    return c < 0 ? 0 : c > 1023 ? 1023 : c;
+}
+
+static inline void csc_dec10_pixel(const struct csc_dec_coefs *k,
+        int y, int c0, int c1, unsigned char *d) {
+    for (int n = 0; n < 3; ++n)
+        d[n] = csc_clip_u8((k->y * y + k->c[0][n] * c0 + k->c[1][n] * c1 +
+                k->off[n] * 4) >> 10);
+}
+
+static inline void csc_dec10_rows_tail(const struct csc_dec_coefs *k,
+        unsigned int shift, const unsigned short *y0,
+        const unsigned short *y1, const unsigned short *c0,
+        const unsigned short *c1, unsigned int cstep,
+        unsigned char *d0, unsigned char *d1,
+        unsigned int x, unsigned int width) {
+    for (; x < width; x += 2) {
+        int u = c0[x / 2 * cstep] >> shift & 0x3ff;
+        int v = c1[x / 2 * cstep] >> shift & 0x3ff;
+        csc_dec10_pixel(k, y0[x] >> shift & 0x3ff, u, v, d0 + x * 3);
+        csc_dec10_pixel(k, y0[x + 1] >> shift & 0x3ff, u, v, d0 + x * 3 + 3);
+        if (y1 != NULL) {
+            csc_dec10_pixel(k, y1[x] >> shift & 0x3ff, u, v, d1 + x * 3);
+            csc_dec10_pixel(k, y1[x + 1] >> shift & 0x3ff, u, v,
+                    d1 + x * 3 + 3);
+        }
+    }
+}
+
+static inline void csc_enc10_row_tail(const struct csc_enc_coefs *k,
+        unsigned int shift, const unsigned char *src, unsigned short *y,
+        unsigned short *c0, unsigned short *c1, unsigned int cstep,
+        unsigned int x, unsigned int width) {
+    for (; x < width; x += 2) {
+        const unsigned char *p = src + x * 3;
+        y[x]     = csc_enc10_y(k, p) << shift;
+        y[x + 1] = csc_enc10_y(k, p + 3) << shift;
+        c0[x / 2 * cstep] = csc_enc10_c(k, 0, p) << shift;
+        c1[x / 2 * cstep] = csc_enc10_c(k, 1, p) << shift;
+    }
+}
+
+/* RGB48 variants of the 10-bit ones */
+static inline unsigned short csc_enc10_y48(const struct csc_enc_coefs *k,
+        const unsigned short *p) {
+    int y = ((k->y[0] * p[0] + k->y[1] * p[1] + k->y[2] * p[2]) >> 14) +
+            k->y_off * 4;
+    return y < 0 ? 0 : y > 1023 ? 1023 : y;
+}
+
+static inline unsigned short csc_enc10_c48(const struct csc_enc_coefs *k,
+        int n, const unsigned short *p) {
+    int c = ((k->c[n][0] * p[0] + k->c[n][1] * p[1] + k->c[n][2] * p[2]) >>
+            14) + 512;
+    return c < 0 ? 0 : c > 1023 ? 1023 : c;
+}
+
+static inline void csc_dec10_pixel48(const struct csc_dec_coefs *k,
+        int y, int c0, int c1, unsigned short *d) {
+    for (int n = 0; n < 3; ++n) {
+        int s = k->y * y + k->c[0][n] * c0 + k->c[1][n] * c1 + k->off[n] * 4;
+        s = (s >> 2) + (s >> 10);
+        d[n] = s < 0 ? 0 : s > 65535 ? 65535 : s;
+    }
+}
+
+static inline void csc_dec10_rows48_tail(const struct csc_dec_coefs *k,
+        unsigned int shift, const unsigned short *y0,
+        const unsigned short *y1, const unsigned short *c0,
+        const unsigned short *c1, unsigned int cstep,
+        unsigned short *d0, unsigned short *d1,
+        unsigned int x, unsigned int width) {
+    for (; x < width; x += 2) {
+        int u = c0[x / 2 * cstep] >> shift & 0x3ff;
+        int v = c1[x / 2 * cstep] >> shift & 0x3ff;
+        csc_dec10_pixel48(k, y0[x] >> shift & 0x3ff, u, v, d0 + x * 3);
+        csc_dec10_pixel48(k, y0[x + 1] >> shift & 0x3ff, u, v,
+                d0 + x * 3 + 3);
+        if (y1 != NULL) {
+            csc_dec10_pixel48(k, y1[x] >> shift & 0x3ff, u, v, d1 + x * 3);
+            csc_dec10_pixel48(k, y1[x + 1] >> shift & 0x3ff, u, v,
+                    d1 + x * 3 + 3);
+        }
+    }
+}
+
+static inline void csc_enc10_row48_tail(const struct csc_enc_coefs *k,
+        unsigned int shift, const unsigned short *src, unsigned short *y,
+        unsigned short *c0, unsigned short *c1, unsigned int cstep,
+        unsigned int x, unsigned int width) {
+    for (; x < width; x += 2) {
+        const unsigned short *p = src + x * 3;
+        y[x]     = csc_enc10_y48(k, p) << shift;
+        y[x + 1] = csc_enc10_y48(k, p + 3) << shift;
+        c0[x / 2 * cstep] = csc_enc10_c48(k, 0, p) << shift;
+        c1[x / 2 * cstep] = csc_enc10_c48(k, 1, p) << shift;
+    }
+}
+
+static inline unsigned char csc_narrow(unsigned int s, unsigned int drop) {
+    s = (s + (1u << (drop - 1))) >> drop;
+    return s > 255 ? 255 : s;
+}
+
+static inline void csc_narrow_tail(const unsigned short *src,
+        unsigned char *dst, unsigned int x, unsigned int count,
+        unsigned int drop) {
+    for (; x < count; ++x)
+        dst[x] = csc_narrow(src[x], drop);
+}
+
+static inline void csc_widen_tail(const unsigned char *src,
+        unsigned short *dst, unsigned int x, unsigned int count,
+        unsigned int shift) {
+    for (; x < count; ++x)
+        dst[x] = src[x] << shift;
+}
+
+static inline unsigned char csc_lerp(unsigned int a, unsigned int b,
+        unsigned int f) {
+    return (a * (256 - f) + b * f + 128) >> 8;
+}
+
+static inline void csc_lerp_tail(const unsigned char *a,
+        const unsigned char *b, unsigned int f, unsigned char *dst,
+        unsigned int x, unsigned int count) {
+    for (; x < count; ++x)
+        dst[x] = csc_lerp(a[x], b[x], f);
+}
+
+/* Scalar tail of the 4:2:2 unpackers, cstep is 2 for interleaved chroma */
+static inline void csc_unpack422_tail(unsigned int first,
+        const unsigned char *s0, const unsigned char *s1,
+        unsigned char *y0, unsigned char *y1,
+        unsigned char *c0, unsigned char *c1, unsigned int cstep,
+        unsigned int x, unsigned int width) {
+    unsigned int c = 1 - first;
+    for (; x < width; x += 2) {
+        const unsigned char *a = s0 + x * 2;
+        const unsigned char *b = s1 != NULL ? s1 + x * 2 : a;
+        y0[x]     = a[first];
+        y0[x + 1] = a[first + 2];
+        if (y1 != NULL) {
+            y1[x]     = b[first];
+            y1[x + 1] = b[first + 2];
+        }
+        c0[x / 2 * cstep] = (a[c] + b[c] + 1) >> 1;
+        c1[x / 2 * cstep] = (a[c + 2] + b[c + 2] + 1) >> 1;
+    }
+}
+
+/* Scalar tails of the swap kernels, from pixel, pair or byte x on */
+static inline void csc_swap_rgb_tail(unsigned char *row,
+        unsigned int x, unsigned int width) {
+    for (; x < width; ++x) {
+        unsigned char c = row[x * 3];
+        row[x * 3] = row[x * 3 + 2];
+        row[x * 3 + 2] = c;
+    }
+}
+
+static inline void csc_swap_pairs_tail(unsigned char *row,
+        unsigned int x, unsigned int count) {
+    for (; x < count; ++x) {
+        unsigned char c = row[x * 2];
+        row[x * 2] = row[x * 2 + 1];
+        row[x * 2 + 1] = c;
+    }
+}
+
+static inline void csc_swap_rows_tail(unsigned char *a, unsigned char *b,
+        unsigned int x, unsigned int count) {
+    for (; x < count; ++x) {
+        unsigned char c = a[x];
+        a[x] = b[x];
+        b[x] = c;
+    }
+}
+
+#endif // CONV_RGB_YUV_SIMD_H_
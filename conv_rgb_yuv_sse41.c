@@ -0,0 +1,1194 @@
+/*
+ * conv_rgb_yuv_sse41.c
+ *
+ * SSE4.1 row kernels, 16 pixels per iteration.
+ */
+
+#include "conv_rgb_yuv_simd.h"
+
+#ifdef __SSE4_1__
+
+#include <smmintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+struct enc_consts {
+    __m128i mask[3][3], mask4;
+    __m128i ky[3], kc[2][3], y_off;
+};
+
+static void load_enc_consts(struct enc_consts *e,
+        const struct csc_enc_coefs *k) {
+    for (int p = 0; p < 3; ++p) {
+        for (int v = 0; v < 3; ++v)
+            e->mask[p][v] = _mm_loadu_si128(
+                    (const __m128i *) csc_deint_mask[p][v]);
+        e->ky[p] = _mm_set1_epi16(k->y[p]);
+        e->kc[0][p] = _mm_set1_epi16(k->c[0][p]);
+        e->kc[1][p] = _mm_set1_epi16(k->c[1][p]);
+    }
+    e->y_off = _mm_set1_epi16(k->y_off);
+    e->mask4 = _mm_loadu_si128((const __m128i *) csc_deint4_mask);
+}
+
+static inline void deinterleave(const struct enc_consts *e,
+        const unsigned char *src, __m128i p[3]) {
+    __m128i a = _mm_loadu_si128((const __m128i *) src);
+    __m128i b = _mm_loadu_si128((const __m128i *) (src + 16));
+    __m128i c = _mm_loadu_si128((const __m128i *) (src + 32));
+    for (int i = 0; i < 3; ++i)
+        p[i] = _mm_or_si128(_mm_or_si128(
+                _mm_shuffle_epi8(a, e->mask[i][0]),
+                _mm_shuffle_epi8(b, e->mask[i][1])),
+                _mm_shuffle_epi8(c, e->mask[i][2]));
+}
+
+/* 16 4-byte pixels: transpose 4x4 dwords of gathered bytes */
+static inline __attribute__((always_inline)) void deinterleave4(
+        const struct enc_consts *e, const unsigned char *src,
+        unsigned int first, __m128i p[3]) {
+    __m128i v[4];
+    for (int i = 0; i < 4; ++i)
+        v[i] = _mm_shuffle_epi8(_mm_loadu_si128(
+                (const __m128i *) (src + i * 16)), e->mask4);
+
+    __m128i t0 = _mm_unpacklo_epi32(v[0], v[1]);
+    __m128i t1 = _mm_unpackhi_epi32(v[0], v[1]);
+    __m128i t2 = _mm_unpacklo_epi32(v[2], v[3]);
+    __m128i t3 = _mm_unpackhi_epi32(v[2], v[3]);
+    __m128i q[4] = {
+        _mm_unpacklo_epi64(t0, t2), _mm_unpackhi_epi64(t0, t2),
+        _mm_unpacklo_epi64(t1, t3), _mm_unpackhi_epi64(t1, t3),
+    };
+    for (int i = 0; i < 3; ++i)
+        p[i] = q[first + i];
+}
+
+/* 8 Y values in 16-bit lanes; the weighted sum fits in 16 unsigned bits */
+static inline __m128i y8(const struct enc_consts *e,
+        __m128i p0, __m128i p1, __m128i p2) {
+    __m128i sum = _mm_add_epi16(_mm_add_epi16(
+            _mm_mullo_epi16(p0, e->ky[0]),
+            _mm_mullo_epi16(p1, e->ky[1])),
+            _mm_mullo_epi16(p2, e->ky[2]));
+    return _mm_add_epi16(_mm_srli_epi16(sum, 8), e->y_off);
+}
+
+static inline __m128i y16(const struct enc_consts *e, const __m128i p[3]) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = y8(e, _mm_unpacklo_epi8(p[0], zero),
+            _mm_unpacklo_epi8(p[1], zero), _mm_unpacklo_epi8(p[2], zero));
+    __m128i hi = y8(e, _mm_unpackhi_epi8(p[0], zero),
+            _mm_unpackhi_epi8(p[1], zero), _mm_unpackhi_epi8(p[2], zero));
+    return _mm_packus_epi16(lo, hi);
+}
+
+/* 8 chroma values of the even pixels, signed 16-bit sum */
+static inline __m128i c8(const __m128i k[3],
+        __m128i p0, __m128i p1, __m128i p2) {
+    __m128i sum = _mm_add_epi16(_mm_add_epi16(
+            _mm_mullo_epi16(p0, k[0]),
+            _mm_mullo_epi16(p1, k[1])),
+            _mm_mullo_epi16(p2, k[2]));
+    return _mm_add_epi16(_mm_srai_epi16(sum, 8), _mm_set1_epi16(128));
+}
+
+/* [c0 x 8, c1 x 8] for the 8 even pixels of p */
+static inline __m128i chroma16(const struct enc_consts *e, const __m128i p[3]) {
+    __m128i even = _mm_set1_epi16(0x00ff);
+    __m128i p0 = _mm_and_si128(p[0], even);
+    __m128i p1 = _mm_and_si128(p[1], even);
+    __m128i p2 = _mm_and_si128(p[2], even);
+    return _mm_packus_epi16(c8(e->kc[0], p0, p1, p2),
+            c8(e->kc[1], p0, p1, p2));
+}
+
+static void enc_y_row(const struct csc_enc_coefs *k,
+        const unsigned char *src, unsigned char *y, unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i p[3];
+        deinterleave(&e, src + x * 3, p);
+        _mm_storeu_si128((__m128i *) (y + x), y16(&e, p));
+    }
+
+    for (; x < width; ++x)
+        y[x] = csc_enc_y(k, src + x * 3);
+}
+
+static void enc_sp_row(const struct csc_enc_coefs *k,
+        const unsigned char *src, unsigned char *y, unsigned char *c,
+        unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i p[3];
+        deinterleave(&e, src + x * 3, p);
+        _mm_storeu_si128((__m128i *) (y + x), y16(&e, p));
+
+        __m128i cc = chroma16(&e, p);
+        _mm_storeu_si128((__m128i *) (c + x),
+                _mm_unpacklo_epi8(cc, _mm_srli_si128(cc, 8)));
+    }
+
+    for (; x < width; x += 2) {
+        y[x]        = csc_enc_y(k, src + x * 3);
+        y[x + 1]    = csc_enc_y(k, src + x * 3 + 3);
+        c[x]        = csc_enc_c(k, 0, src + x * 3);
+        c[x + 1]    = csc_enc_c(k, 1, src + x * 3);
+    }
+}
+
+static void enc_p_row(const struct csc_enc_coefs *k,
+        const unsigned char *src, unsigned char *y,
+        unsigned char *c0, unsigned char *c1, unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i p[3];
+        deinterleave(&e, src + x * 3, p);
+        _mm_storeu_si128((__m128i *) (y + x), y16(&e, p));
+
+        __m128i cc = chroma16(&e, p);
+        _mm_storel_epi64((__m128i *) (c0 + x / 2), cc);
+        _mm_storel_epi64((__m128i *) (c1 + x / 2), _mm_srli_si128(cc, 8));
+    }
+
+    for (; x < width; x += 2) {
+        y[x]        = csc_enc_y(k, src + x * 3);
+        y[x + 1]    = csc_enc_y(k, src + x * 3 + 3);
+        c0[x / 2]   = csc_enc_c(k, 0, src + x * 3);
+        c1[x / 2]   = csc_enc_c(k, 1, src + x * 3);
+    }
+}
+
+/* first is a constant in each expansion, so q[] stays in registers */
+static inline __attribute__((always_inline)) void enc_y_row4_n(
+        const struct csc_enc_coefs *k, unsigned int first,
+        const unsigned char *src, unsigned char *y, unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i p[3];
+        deinterleave4(&e, src + x * 4, first, p);
+        _mm_storeu_si128((__m128i *) (y + x), y16(&e, p));
+    }
+
+    for (; x < width; ++x)
+        y[x] = csc_enc_y(k, src + x * 4 + first);
+}
+
+static void enc_y_row4(const struct csc_enc_coefs *k, unsigned int first,
+        const unsigned char *src, unsigned char *y, unsigned int width) {
+    if (first == 0)
+        enc_y_row4_n(k, 0, src, y, width);
+    else
+        enc_y_row4_n(k, 1, src, y, width);
+}
+
+static inline __attribute__((always_inline)) void enc_sp_row4_n(
+        const struct csc_enc_coefs *k, unsigned int first,
+        const unsigned char *src, unsigned char *y, unsigned char *c,
+        unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i p[3];
+        deinterleave4(&e, src + x * 4, first, p);
+        _mm_storeu_si128((__m128i *) (y + x), y16(&e, p));
+
+        __m128i cc = chroma16(&e, p);
+        _mm_storeu_si128((__m128i *) (c + x),
+                _mm_unpacklo_epi8(cc, _mm_srli_si128(cc, 8)));
+    }
+
+    for (; x < width; x += 2) {
+        const unsigned char *s = src + x * 4 + first;
+        y[x]        = csc_enc_y(k, s);
+        y[x + 1]    = csc_enc_y(k, s + 4);
+        c[x]        = csc_enc_c(k, 0, s);
+        c[x + 1]    = csc_enc_c(k, 1, s);
+    }
+}
+
+static void enc_sp_row4(const struct csc_enc_coefs *k, unsigned int first,
+        const unsigned char *src, unsigned char *y, unsigned char *c,
+        unsigned int width) {
+    if (first == 0)
+        enc_sp_row4_n(k, 0, src, y, c, width);
+    else
+        enc_sp_row4_n(k, 1, src, y, c, width);
+}
+
+static inline __attribute__((always_inline)) void enc_p_row4_n(
+        const struct csc_enc_coefs *k, unsigned int first,
+        const unsigned char *src, unsigned char *y,
+        unsigned char *c0, unsigned char *c1, unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i p[3];
+        deinterleave4(&e, src + x * 4, first, p);
+        _mm_storeu_si128((__m128i *) (y + x), y16(&e, p));
+
+        __m128i cc = chroma16(&e, p);
+        _mm_storel_epi64((__m128i *) (c0 + x / 2), cc);
+        _mm_storel_epi64((__m128i *) (c1 + x / 2), _mm_srli_si128(cc, 8));
+    }
+
+    for (; x < width; x += 2) {
+        const unsigned char *s = src + x * 4 + first;
+        y[x]        = csc_enc_y(k, s);
+        y[x + 1]    = csc_enc_y(k, s + 4);
+        c0[x / 2]   = csc_enc_c(k, 0, s);
+        c1[x / 2]   = csc_enc_c(k, 1, s);
+    }
+}
+
+static void enc_p_row4(const struct csc_enc_coefs *k, unsigned int first,
+        const unsigned char *src, unsigned char *y,
+        unsigned char *c0, unsigned char *c1, unsigned int width) {
+    if (first == 0)
+        enc_p_row4_n(k, 0, src, y, c0, c1, width);
+    else
+        enc_p_row4_n(k, 1, src, y, c0, c1, width);
+}
+
+struct dec_consts {
+    __m128i mask[3][3];
+    __m128i ky, kc[3], off[3];
+};
+
+static void load_dec_consts(struct dec_consts *d,
+        const struct csc_dec_coefs *k) {
+    for (int n = 0; n < 3; ++n) {
+        for (int v = 0; v < 3; ++v)
+            d->mask[n][v] = _mm_loadu_si128(
+                    (const __m128i *) csc_int_mask[n][v]);
+        /* (C0, C1) 16-bit pairs for pmaddwd */
+        d->kc[n] = _mm_set1_epi32((int) ((unsigned short) k->c[0][n] |
+                (unsigned int) (unsigned short) k->c[1][n] << 16));
+        d->off[n] = _mm_set1_epi32(k->off[n]);
+    }
+    d->ky = _mm_set1_epi32(k->y);
+}
+
+/*
+ * pairs holds 8 interleaved (C0, C1) samples. The chroma part of each
+ * output byte is computed once per sample and duplicated for both
+ * pixels, t[n][i] covering pixels 4i..4i+3.
+ */
+static inline void chroma_terms16(const struct dec_consts *d,
+        __m128i lo, __m128i hi, __m128i t[3][4]) {
+    for (int n = 0; n < 3; ++n) {
+        __m128i a = _mm_add_epi32(_mm_madd_epi16(lo, d->kc[n]), d->off[n]);
+        __m128i b = _mm_add_epi32(_mm_madd_epi16(hi, d->kc[n]), d->off[n]);
+        t[n][0] = _mm_unpacklo_epi32(a, a);
+        t[n][1] = _mm_unpackhi_epi32(a, a);
+        t[n][2] = _mm_unpacklo_epi32(b, b);
+        t[n][3] = _mm_unpackhi_epi32(b, b);
+    }
+}
+
+static inline void chroma_terms(const struct dec_consts *d, __m128i pairs,
+        __m128i t[3][4]) {
+    __m128i zero = _mm_setzero_si128();
+    chroma_terms16(d, _mm_unpacklo_epi8(pairs, zero),
+            _mm_unpackhi_epi8(pairs, zero), t);
+}
+
+/*
+ * 16 output bytes per byte position in o[] from 16 Y samples in 16-bit
+ * lanes, the sums scaled by 1 << bits
+ */
+static inline __attribute__((always_inline)) void y_terms(
+        const struct dec_consts *d, __m128i lo, __m128i hi, __m128i ys[4]) {
+    __m128i zero = _mm_setzero_si128();
+    ys[0] = _mm_madd_epi16(_mm_unpacklo_epi16(lo, zero), d->ky);
+    ys[1] = _mm_madd_epi16(_mm_unpackhi_epi16(lo, zero), d->ky);
+    ys[2] = _mm_madd_epi16(_mm_unpacklo_epi16(hi, zero), d->ky);
+    ys[3] = _mm_madd_epi16(_mm_unpackhi_epi16(hi, zero), d->ky);
+}
+
+static inline __attribute__((always_inline)) void dec_planes(
+        const struct dec_consts *d, __m128i lo, __m128i hi,
+        const __m128i t[3][4], int bits, __m128i o[3]) {
+    __m128i ys[4];
+    y_terms(d, lo, hi, ys);
+
+    for (int n = 0; n < 3; ++n) {
+        __m128i a = _mm_packs_epi32(
+                _mm_srai_epi32(_mm_add_epi32(ys[0], t[n][0]), bits),
+                _mm_srai_epi32(_mm_add_epi32(ys[1], t[n][1]), bits));
+        __m128i b = _mm_packs_epi32(
+                _mm_srai_epi32(_mm_add_epi32(ys[2], t[n][2]), bits),
+                _mm_srai_epi32(_mm_add_epi32(ys[3], t[n][3]), bits));
+        o[n] = _mm_packus_epi16(a, b);
+    }
+}
+
+static inline void dec_planes16(const struct dec_consts *d,
+        const unsigned char *y, const __m128i t[3][4], __m128i o[3]) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i yy = _mm_loadu_si128((const __m128i *) y);
+    dec_planes(d, _mm_unpacklo_epi8(yy, zero), _mm_unpackhi_epi8(yy, zero),
+            t, 8, o);
+}
+
+static inline void store_rgb16(const struct dec_consts *d, const __m128i o[3],
+        unsigned char *dst) {
+    for (int v = 0; v < 3; ++v)
+        _mm_storeu_si128((__m128i *) (dst + v * 16), _mm_or_si128(
+                _mm_or_si128(_mm_shuffle_epi8(o[0], d->mask[0][v]),
+                        _mm_shuffle_epi8(o[1], d->mask[1][v])),
+                _mm_shuffle_epi8(o[2], d->mask[2][v])));
+}
+
+static inline void dec_row16(const struct dec_consts *d,
+        const unsigned char *y, const __m128i t[3][4], unsigned char *dst) {
+    __m128i o[3];
+    dec_planes16(d, y, t, o);
+    store_rgb16(d, o, dst);
+}
+
+/* No shuffles for 4-byte pixels: two rounds of unpacking interleave them */
+static inline __attribute__((always_inline)) void dec_row16_4(
+        const struct dec_consts *d, const unsigned char *y,
+        const __m128i t[3][4], unsigned int first, unsigned char *dst) {
+    __m128i q[4];
+    dec_planes16(d, y, t, q + first);
+    q[first == 0 ? 3 : 0] = _mm_set1_epi8(-1);
+
+    __m128i lo01 = _mm_unpacklo_epi8(q[0], q[1]);
+    __m128i hi01 = _mm_unpackhi_epi8(q[0], q[1]);
+    __m128i lo23 = _mm_unpacklo_epi8(q[2], q[3]);
+    __m128i hi23 = _mm_unpackhi_epi8(q[2], q[3]);
+    _mm_storeu_si128((__m128i *) dst, _mm_unpacklo_epi16(lo01, lo23));
+    _mm_storeu_si128((__m128i *) (dst + 16), _mm_unpackhi_epi16(lo01, lo23));
+    _mm_storeu_si128((__m128i *) (dst + 32), _mm_unpacklo_epi16(hi01, hi23));
+    _mm_storeu_si128((__m128i *) (dst + 48), _mm_unpackhi_epi16(hi01, hi23));
+}
+
+static void dec_sp_rows(const struct csc_dec_coefs *k,
+        const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c, unsigned char *d0, unsigned char *d1,
+        unsigned int width) {
+    struct dec_consts d;
+    load_dec_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i t[3][4];
+        chroma_terms(&d, _mm_loadu_si128((const __m128i *) (c + x)), t);
+        dec_row16(&d, y0 + x, t, d0 + x * 3);
+        if (y1 != NULL)
+            dec_row16(&d, y1 + x, t, d1 + x * 3);
+    }
+
+    csc_dec_rows_tail(k, y0, y1, c, c + 1, 2, d0, d1, x, width);
+}
+
+static void dec_p_rows(const struct csc_dec_coefs *k,
+        const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c0, const unsigned char *c1,
+        unsigned char *d0, unsigned char *d1, unsigned int width) {
+    struct dec_consts d;
+    load_dec_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i pairs = _mm_unpacklo_epi8(
+                _mm_loadl_epi64((const __m128i *) (c0 + x / 2)),
+                _mm_loadl_epi64((const __m128i *) (c1 + x / 2)));
+        __m128i t[3][4];
+        chroma_terms(&d, pairs, t);
+        dec_row16(&d, y0 + x, t, d0 + x * 3);
+        if (y1 != NULL)
+            dec_row16(&d, y1 + x, t, d1 + x * 3);
+    }
+
+    csc_dec_rows_tail(k, y0, y1, c0, c1, 1, d0, d1, x, width);
+}
+
+static inline __attribute__((always_inline)) void dec_sp_rows4_n(
+        const struct csc_dec_coefs *k, unsigned int first,
+        const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c, unsigned char *d0, unsigned char *d1,
+        unsigned int width) {
+    struct dec_consts d;
+    load_dec_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i t[3][4];
+        chroma_terms(&d, _mm_loadu_si128((const __m128i *) (c + x)), t);
+        dec_row16_4(&d, y0 + x, t, first, d0 + x * 4);
+        if (y1 != NULL)
+            dec_row16_4(&d, y1 + x, t, first, d1 + x * 4);
+    }
+
+    csc_dec_rows4_tail(k, first, y0, y1, c, c + 1, 2, d0, d1, x, width);
+}
+
+static void dec_sp_rows4(const struct csc_dec_coefs *k, unsigned int first,
+        const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c, unsigned char *d0, unsigned char *d1,
+        unsigned int width) {
+    if (first == 0)
+        dec_sp_rows4_n(k, 0, y0, y1, c, d0, d1, width);
+    else
+        dec_sp_rows4_n(k, 1, y0, y1, c, d0, d1, width);
+}
+
+static inline __attribute__((always_inline)) void dec_p_rows4_n(
+        const struct csc_dec_coefs *k, unsigned int first,
+        const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c0, const unsigned char *c1,
+        unsigned char *d0, unsigned char *d1, unsigned int width) {
+    struct dec_consts d;
+    load_dec_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i pairs = _mm_unpacklo_epi8(
+                _mm_loadl_epi64((const __m128i *) (c0 + x / 2)),
+                _mm_loadl_epi64((const __m128i *) (c1 + x / 2)));
+        __m128i t[3][4];
+        chroma_terms(&d, pairs, t);
+        dec_row16_4(&d, y0 + x, t, first, d0 + x * 4);
+        if (y1 != NULL)
+            dec_row16_4(&d, y1 + x, t, first, d1 + x * 4);
+    }
+
+    csc_dec_rows4_tail(k, first, y0, y1, c0, c1, 1, d0, d1, x, width);
+}
+
+static void dec_p_rows4(const struct csc_dec_coefs *k, unsigned int first,
+        const unsigned char *y0, const unsigned char *y1,
+        const unsigned char *c0, const unsigned char *c1,
+        unsigned char *d0, unsigned char *d1, unsigned int width) {
+    if (first == 0)
+        dec_p_rows4_n(k, 0, y0, y1, c0, c1, d0, d1, width);
+    else
+        dec_p_rows4_n(k, 1, y0, y1, c0, c1, d0, d1, width);
+}
+
+/*
+ * 16 pixels of a 4:2:2 row: Y is in the even bytes for first 0 and the
+ * odd ones for first 1, the chroma pairs in the others.
+ */
+static inline __attribute__((always_inline)) void split422(unsigned int first,
+        const unsigned char *src, __m128i *y, __m128i *c) {
+    const __m128i lo = _mm_set1_epi16(0xff);
+    __m128i a = _mm_loadu_si128((const __m128i *) src);
+    __m128i b = _mm_loadu_si128((const __m128i *) (src + 16));
+    __m128i even = _mm_packus_epi16(_mm_and_si128(a, lo),
+            _mm_and_si128(b, lo));
+    __m128i odd = _mm_packus_epi16(_mm_srli_epi16(a, 8),
+            _mm_srli_epi16(b, 8));
+    *y = first == 0 ? even : odd;
+    *c = first == 0 ? odd : even;
+}
+
+static inline __attribute__((always_inline)) void unpack422_sp_rows_n(
+        unsigned int first, const unsigned char *s0, const unsigned char *s1,
+        unsigned char *y0, unsigned char *y1, unsigned char *c,
+        unsigned int width) {
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i ya, yb, ca, cb;
+        split422(first, s0 + x * 2, &ya, &ca);
+        _mm_storeu_si128((__m128i *) (y0 + x), ya);
+        if (s1 != NULL) {
+            split422(first, s1 + x * 2, &yb, &cb);
+            _mm_storeu_si128((__m128i *) (y1 + x), yb);
+            ca = _mm_avg_epu8(ca, cb);
+        }
+        _mm_storeu_si128((__m128i *) (c + x), ca);
+    }
+
+    csc_unpack422_tail(first, s0, s1, y0, y1, c, c + 1, 2, x, width);
+}
+
+static void unpack422_sp_rows(unsigned int first,
+        const unsigned char *s0, const unsigned char *s1,
+        unsigned char *y0, unsigned char *y1, unsigned char *c,
+        unsigned int width) {
+    if (first == 0)
+        unpack422_sp_rows_n(0, s0, s1, y0, y1, c, width);
+    else
+        unpack422_sp_rows_n(1, s0, s1, y0, y1, c, width);
+}
+
+static inline __attribute__((always_inline)) void unpack422_p_rows_n(
+        unsigned int first, const unsigned char *s0, const unsigned char *s1,
+        unsigned char *y0, unsigned char *y1,
+        unsigned char *c0, unsigned char *c1, unsigned int width) {
+    const __m128i lo = _mm_set1_epi16(0xff);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i ya, yb, ca, cb;
+        split422(first, s0 + x * 2, &ya, &ca);
+        split422(first, s1 + x * 2, &yb, &cb);
+        _mm_storeu_si128((__m128i *) (y0 + x), ya);
+        _mm_storeu_si128((__m128i *) (y1 + x), yb);
+
+        __m128i cc = _mm_avg_epu8(ca, cb);
+        __m128i uv = _mm_packus_epi16(_mm_and_si128(cc, lo),
+                _mm_srli_epi16(cc, 8));
+        _mm_storel_epi64((__m128i *) (c0 + x / 2), uv);
+        _mm_storel_epi64((__m128i *) (c1 + x / 2), _mm_srli_si128(uv, 8));
+    }
+
+    csc_unpack422_tail(first, s0, s1, y0, y1, c0, c1, 1, x, width);
+}
+
+static void unpack422_p_rows(unsigned int first,
+        const unsigned char *s0, const unsigned char *s1,
+        unsigned char *y0, unsigned char *y1,
+        unsigned char *c0, unsigned char *c1, unsigned int width) {
+    if (first == 0)
+        unpack422_p_rows_n(0, s0, s1, y0, y1, c0, c1, width);
+    else
+        unpack422_p_rows_n(1, s0, s1, y0, y1, c0, c1, width);
+}
+
+/* The offsets in 1/1024ths for 10-bit samples */
+static void load_dec10_consts(struct dec_consts *d,
+        const struct csc_dec_coefs *k) {
+    load_dec_consts(d, k);
+    for (int n = 0; n < 3; ++n)
+        d->off[n] = _mm_slli_epi32(d->off[n], 2);
+}
+
+/* 10-bit samples at bit shift, anything above them ignored */
+static inline __attribute__((always_inline)) __m128i load10(
+        const unsigned short *p, unsigned int shift) {
+    return _mm_and_si128(_mm_srli_epi16(
+            _mm_loadu_si128((const __m128i *) p), shift),
+            _mm_set1_epi16(0x3ff));
+}
+
+static inline __attribute__((always_inline)) void dec10_row16(
+        const struct dec_consts *d, const unsigned short *y,
+        unsigned int shift, const __m128i t[3][4], unsigned char *dst) {
+    __m128i o[3];
+    dec_planes(d, load10(y, shift), load10(y + 8, shift), t, 10, o);
+    store_rgb16(d, o, dst);
+}
+
+/* shift is a constant in each expansion, as first is for the row4 kernels */
+static inline __attribute__((always_inline)) void dec10_sp_rows_n(
+        const struct csc_dec_coefs *k, unsigned int shift,
+        const unsigned short *y0, const unsigned short *y1,
+        const unsigned short *c, unsigned char *d0, unsigned char *d1,
+        unsigned int width) {
+    struct dec_consts d;
+    load_dec10_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i t[3][4];
+        chroma_terms16(&d, load10(c + x, shift), load10(c + x + 8, shift), t);
+        dec10_row16(&d, y0 + x, shift, t, d0 + x * 3);
+        if (y1 != NULL)
+            dec10_row16(&d, y1 + x, shift, t, d1 + x * 3);
+    }
+
+    csc_dec10_rows_tail(k, shift, y0, y1, c, c + 1, 2, d0, d1, x, width);
+}
+
+static void dec10_sp_rows(const struct csc_dec_coefs *k, unsigned int shift,
+        const unsigned short *y0, const unsigned short *y1,
+        const unsigned short *c, unsigned char *d0, unsigned char *d1,
+        unsigned int width) {
+    if (shift == 0)
+        dec10_sp_rows_n(k, 0, y0, y1, c, d0, d1, width);
+    else
+        dec10_sp_rows_n(k, 6, y0, y1, c, d0, d1, width);
+}
+
+static inline __attribute__((always_inline)) void dec10_p_rows_n(
+        const struct csc_dec_coefs *k, unsigned int shift,
+        const unsigned short *y0, const unsigned short *y1,
+        const unsigned short *c0, const unsigned short *c1,
+        unsigned char *d0, unsigned char *d1, unsigned int width) {
+    struct dec_consts d;
+    load_dec10_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i u = load10(c0 + x / 2, shift), v = load10(c1 + x / 2, shift);
+        __m128i t[3][4];
+        chroma_terms16(&d, _mm_unpacklo_epi16(u, v),
+                _mm_unpackhi_epi16(u, v), t);
+        dec10_row16(&d, y0 + x, shift, t, d0 + x * 3);
+        if (y1 != NULL)
+            dec10_row16(&d, y1 + x, shift, t, d1 + x * 3);
+    }
+
+    csc_dec10_rows_tail(k, shift, y0, y1, c0, c1, 1, d0, d1, x, width);
+}
+
+static void dec10_p_rows(const struct csc_dec_coefs *k, unsigned int shift,
+        const unsigned short *y0, const unsigned short *y1,
+        const unsigned short *c0, const unsigned short *c1,
+        unsigned char *d0, unsigned char *d1, unsigned int width) {
+    if (shift == 0)
+        dec10_p_rows_n(k, 0, y0, y1, c0, c1, d0, d1, width);
+    else
+        dec10_p_rows_n(k, 6, y0, y1, c0, c1, d0, d1, width);
+}
+
+/* Weighted sum of 8 pixels in 16-bit lanes, as in y8() and c8() */
+static inline __m128i sum8(const __m128i k[3],
+        __m128i p0, __m128i p1, __m128i p2) {
+    return _mm_add_epi16(_mm_add_epi16(
+            _mm_mullo_epi16(p0, k[0]),
+            _mm_mullo_epi16(p1, k[1])),
+            _mm_mullo_epi16(p2, k[2]));
+}
+
+/* 16 pixels to 10-bit Y, the 8-bit sums shifted down by 6 rather than 8 */
+static inline __attribute__((always_inline)) void enc10_y16(
+        const struct enc_consts *e, const __m128i p[3], unsigned int shift,
+        __m128i y[2]) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i y_off = _mm_slli_epi16(e->y_off, 2);
+
+    y[0] = _mm_add_epi16(_mm_srli_epi16(sum8(e->ky,
+            _mm_unpacklo_epi8(p[0], zero), _mm_unpacklo_epi8(p[1], zero),
+            _mm_unpacklo_epi8(p[2], zero)), 6), y_off);
+    y[1] = _mm_add_epi16(_mm_srli_epi16(sum8(e->ky,
+            _mm_unpackhi_epi8(p[0], zero), _mm_unpackhi_epi8(p[1], zero),
+            _mm_unpackhi_epi8(p[2], zero)), 6), y_off);
+    y[0] = _mm_slli_epi16(y[0], shift);
+    y[1] = _mm_slli_epi16(y[1], shift);
+}
+
+/* The 10-bit chroma of the 8 even pixels of 16 */
+static inline __attribute__((always_inline)) void enc10_c16(
+        const struct enc_consts *e, const __m128i p[3], unsigned int shift,
+        __m128i *u, __m128i *v) {
+    __m128i c_off = _mm_set1_epi16(512);
+    __m128i even = _mm_set1_epi16(0x00ff);
+    __m128i p0 = _mm_and_si128(p[0], even);
+    __m128i p1 = _mm_and_si128(p[1], even);
+    __m128i p2 = _mm_and_si128(p[2], even);
+    *u = _mm_slli_epi16(_mm_add_epi16(_mm_srai_epi16(
+            sum8(e->kc[0], p0, p1, p2), 6), c_off), shift);
+    *v = _mm_slli_epi16(_mm_add_epi16(_mm_srai_epi16(
+            sum8(e->kc[1], p0, p1, p2), 6), c_off), shift);
+}
+
+static inline __attribute__((always_inline)) void enc10_y_row_n(
+        const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned char *src, unsigned short *y, unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i p[3], yy[2];
+        deinterleave(&e, src + x * 3, p);
+        enc10_y16(&e, p, shift, yy);
+        _mm_storeu_si128((__m128i *) (y + x), yy[0]);
+        _mm_storeu_si128((__m128i *) (y + x + 8), yy[1]);
+    }
+
+    for (; x < width; ++x)
+        y[x] = csc_enc10_y(k, src + x * 3) << shift;
+}
+
+static void enc10_y_row(const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned char *src, unsigned short *y, unsigned int width) {
+    if (shift == 0)
+        enc10_y_row_n(k, 0, src, y, width);
+    else
+        enc10_y_row_n(k, 6, src, y, width);
+}
+
+static inline __attribute__((always_inline)) void enc10_sp_row_n(
+        const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned char *src, unsigned short *y, unsigned short *c,
+        unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i p[3], yy[2], u, v;
+        deinterleave(&e, src + x * 3, p);
+        enc10_y16(&e, p, shift, yy);
+        enc10_c16(&e, p, shift, &u, &v);
+        _mm_storeu_si128((__m128i *) (y + x), yy[0]);
+        _mm_storeu_si128((__m128i *) (y + x + 8), yy[1]);
+        _mm_storeu_si128((__m128i *) (c + x), _mm_unpacklo_epi16(u, v));
+        _mm_storeu_si128((__m128i *) (c + x + 8), _mm_unpackhi_epi16(u, v));
+    }
+
+    csc_enc10_row_tail(k, shift, src, y, c, c + 1, 2, x, width);
+}
+
+static void enc10_sp_row(const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned char *src, unsigned short *y, unsigned short *c,
+        unsigned int width) {
+    if (shift == 0)
+        enc10_sp_row_n(k, 0, src, y, c, width);
+    else
+        enc10_sp_row_n(k, 6, src, y, c, width);
+}
+
+static inline __attribute__((always_inline)) void enc10_p_row_n(
+        const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned char *src, unsigned short *y,
+        unsigned short *c0, unsigned short *c1, unsigned int width) {
+    struct enc_consts e;
+    load_enc_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i p[3], yy[2], u, v;
+        deinterleave(&e, src + x * 3, p);
+        enc10_y16(&e, p, shift, yy);
+        enc10_c16(&e, p, shift, &u, &v);
+        _mm_storeu_si128((__m128i *) (y + x), yy[0]);
+        _mm_storeu_si128((__m128i *) (y + x + 8), yy[1]);
+        _mm_storeu_si128((__m128i *) (c0 + x / 2), u);
+        _mm_storeu_si128((__m128i *) (c1 + x / 2), v);
+    }
+
+    csc_enc10_row_tail(k, shift, src, y, c0, c1, 1, x, width);
+}
+
+static void enc10_p_row(const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned char *src, unsigned short *y,
+        unsigned short *c0, unsigned short *c1, unsigned int width) {
+    if (shift == 0)
+        enc10_p_row_n(k, 0, src, y, c0, c1, width);
+    else
+        enc10_p_row_n(k, 6, src, y, c0, c1, width);
+}
+
+/* The RGB48 interleave in place of the 8-bit one */
+static void load_dec48_consts(struct dec_consts *d,
+        const struct csc_dec_coefs *k) {
+    load_dec10_consts(d, k);
+    for (int n = 0; n < 3; ++n)
+        for (int v = 0; v < 3; ++v)
+            d->mask[n][v] = _mm_loadu_si128(
+                    (const __m128i *) csc_int16_mask[n][v]);
+}
+
+static inline __m128i wide48(__m128i s) {
+    return _mm_add_epi32(_mm_srai_epi32(s, 2), _mm_srai_epi32(s, 10));
+}
+
+/* 16 RGB48 pixels: o[0] holds the channels of 0-7, o[1] those of 8-15 */
+static inline __attribute__((always_inline)) void dec10_row48(
+        const struct dec_consts *d, const unsigned short *y,
+        unsigned int shift, const __m128i t[3][4], unsigned short *dst) {
+    __m128i ys[4], o[2][3];
+    y_terms(d, load10(y, shift), load10(y + 8, shift), ys);
+    for (int i = 0; i < 2; ++i)
+        for (int n = 0; n < 3; ++n)
+            o[i][n] = _mm_packus_epi32(
+                    wide48(_mm_add_epi32(ys[i * 2], t[n][i * 2])),
+                    wide48(_mm_add_epi32(ys[i * 2 + 1], t[n][i * 2 + 1])));
+    store_rgb16(d, o[0], (unsigned char *) dst);
+    store_rgb16(d, o[1], (unsigned char *) (dst + 24));
+}
+
+static inline __attribute__((always_inline)) void dec10_sp_rows48_n(
+        const struct csc_dec_coefs *k, unsigned int shift,
+        const unsigned short *y0, const unsigned short *y1,
+        const unsigned short *c, unsigned short *d0, unsigned short *d1,
+        unsigned int width) {
+    struct dec_consts d;
+    load_dec48_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i t[3][4];
+        chroma_terms16(&d, load10(c + x, shift), load10(c + x + 8, shift), t);
+        dec10_row48(&d, y0 + x, shift, t, d0 + x * 3);
+        if (y1 != NULL)
+            dec10_row48(&d, y1 + x, shift, t, d1 + x * 3);
+    }
+
+    csc_dec10_rows48_tail(k, shift, y0, y1, c, c + 1, 2, d0, d1, x, width);
+}
+
+static void dec10_sp_rows48(const struct csc_dec_coefs *k,
+        unsigned int shift, const unsigned short *y0,
+        const unsigned short *y1, const unsigned short *c,
+        unsigned short *d0, unsigned short *d1, unsigned int width) {
+    if (shift == 0)
+        dec10_sp_rows48_n(k, 0, y0, y1, c, d0, d1, width);
+    else
+        dec10_sp_rows48_n(k, 6, y0, y1, c, d0, d1, width);
+}
+
+static inline __attribute__((always_inline)) void dec10_p_rows48_n(
+        const struct csc_dec_coefs *k, unsigned int shift,
+        const unsigned short *y0, const unsigned short *y1,
+        const unsigned short *c0, const unsigned short *c1,
+        unsigned short *d0, unsigned short *d1, unsigned int width) {
+    struct dec_consts d;
+    load_dec48_consts(&d, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i u = load10(c0 + x / 2, shift), v = load10(c1 + x / 2, shift);
+        __m128i t[3][4];
+        chroma_terms16(&d, _mm_unpacklo_epi16(u, v),
+                _mm_unpackhi_epi16(u, v), t);
+        dec10_row48(&d, y0 + x, shift, t, d0 + x * 3);
+        if (y1 != NULL)
+            dec10_row48(&d, y1 + x, shift, t, d1 + x * 3);
+    }
+
+    csc_dec10_rows48_tail(k, shift, y0, y1, c0, c1, 1, d0, d1, x, width);
+}
+
+static void dec10_p_rows48(const struct csc_dec_coefs *k,
+        unsigned int shift, const unsigned short *y0,
+        const unsigned short *y1, const unsigned short *c0,
+        const unsigned short *c1, unsigned short *d0, unsigned short *d1,
+        unsigned int width) {
+    if (shift == 0)
+        dec10_p_rows48_n(k, 0, y0, y1, c0, c1, d0, d1, width);
+    else
+        dec10_p_rows48_n(k, 6, y0, y1, c0, c1, d0, d1, width);
+}
+
+/*
+ * The 16-bit channels go through pmaddwd as signed words less 32768, the
+ * bias putting it back along with the offset. kp and kb hold the (w0, w1)
+ * and (w2, 0) pairs of Y, C0 and C1.
+ */
+struct enc48_consts {
+    __m128i mask[3][3];
+    __m128i kp[3], kb[3], bias[3];
+};
+
+static void load_enc48_consts(struct enc48_consts *e,
+        const struct csc_enc_coefs *k) {
+    const short *w[3] = { k->y, k->c[0], k->c[1] };
+    const int off[3] = { k->y_off * 4, 512, 512 };
+    for (int n = 0; n < 3; ++n) {
+        for (int v = 0; v < 3; ++v)
+            e->mask[n][v] = _mm_loadu_si128(
+                    (const __m128i *) csc_deint16_mask[n][v]);
+        e->kp[n] = _mm_set1_epi32((int) ((unsigned short) w[n][0] |
+                (unsigned int) (unsigned short) w[n][1] << 16));
+        e->kb[n] = _mm_set1_epi32((unsigned short) w[n][2]);
+        e->bias[n] = _mm_set1_epi32(32768 * (w[n][0] + w[n][1] + w[n][2]) +
+                (off[n] << 14));
+    }
+}
+
+/* 8 RGB48 pixels split by channel and made signed */
+static inline void deinterleave48(const struct enc48_consts *e,
+        const unsigned short *src, __m128i p[3]) {
+    __m128i a = _mm_loadu_si128((const __m128i *) src);
+    __m128i b = _mm_loadu_si128((const __m128i *) (src + 8));
+    __m128i c = _mm_loadu_si128((const __m128i *) (src + 16));
+    __m128i sign = _mm_set1_epi16(-32768);
+    for (int i = 0; i < 3; ++i)
+        p[i] = _mm_xor_si128(_mm_or_si128(_mm_or_si128(
+                _mm_shuffle_epi8(a, e->mask[i][0]),
+                _mm_shuffle_epi8(b, e->mask[i][1])),
+                _mm_shuffle_epi8(c, e->mask[i][2])), sign);
+}
+
+/* The sums of 4 pixels from (R, G) pairs and (B, 0), offset and shifted */
+static inline __m128i sum48(const struct enc48_consts *e, int n,
+        __m128i rg, __m128i b) {
+    return _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(
+            _mm_madd_epi16(rg, e->kp[n]), _mm_madd_epi16(b, e->kb[n])),
+            e->bias[n]), 14);
+}
+
+static inline __attribute__((always_inline)) __m128i pack10(__m128i lo,
+        __m128i hi, unsigned int shift) {
+    return _mm_slli_epi16(_mm_min_epu16(_mm_packus_epi32(lo, hi),
+            _mm_set1_epi16(1023)), shift);
+}
+
+static inline __attribute__((always_inline)) __m128i enc10_y8(
+        const struct enc48_consts *e, const __m128i p[3],
+        unsigned int shift) {
+    __m128i zero = _mm_setzero_si128();
+    return pack10(sum48(e, 0, _mm_unpacklo_epi16(p[0], p[1]),
+            _mm_unpacklo_epi16(p[2], zero)),
+            sum48(e, 0, _mm_unpackhi_epi16(p[0], p[1]),
+            _mm_unpackhi_epi16(p[2], zero)), shift);
+}
+
+/* The chroma of the 8 even pixels of 16, B taken with the zero weight */
+static inline __attribute__((always_inline)) void enc10_c48(
+        const struct enc48_consts *e, const __m128i p[2][3],
+        unsigned int shift, __m128i *u, __m128i *v) {
+    __m128i rg[2];
+    for (int i = 0; i < 2; ++i)
+        rg[i] = _mm_blend_epi16(p[i][0], _mm_slli_epi32(p[i][1], 16), 0xaa);
+    *u = pack10(sum48(e, 1, rg[0], p[0][2]), sum48(e, 1, rg[1], p[1][2]),
+            shift);
+    *v = pack10(sum48(e, 2, rg[0], p[0][2]), sum48(e, 2, rg[1], p[1][2]),
+            shift);
+}
+
+static inline __attribute__((always_inline)) void enc10_y_row48_n(
+        const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned short *src, unsigned short *y, unsigned int width) {
+    struct enc48_consts e;
+    load_enc48_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i p[3];
+        deinterleave48(&e, src + x * 3, p);
+        _mm_storeu_si128((__m128i *) (y + x), enc10_y8(&e, p, shift));
+    }
+
+    for (; x < width; ++x)
+        y[x] = csc_enc10_y48(k, src + x * 3) << shift;
+}
+
+static void enc10_y_row48(const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned short *src, unsigned short *y, unsigned int width) {
+    if (shift == 0)
+        enc10_y_row48_n(k, 0, src, y, width);
+    else
+        enc10_y_row48_n(k, 6, src, y, width);
+}
+
+static inline __attribute__((always_inline)) void enc10_sp_row48_n(
+        const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned short *src, unsigned short *y, unsigned short *c,
+        unsigned int width) {
+    struct enc48_consts e;
+    load_enc48_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i p[2][3], u, v;
+        deinterleave48(&e, src + x * 3, p[0]);
+        deinterleave48(&e, src + x * 3 + 24, p[1]);
+        enc10_c48(&e, p, shift, &u, &v);
+        _mm_storeu_si128((__m128i *) (y + x), enc10_y8(&e, p[0], shift));
+        _mm_storeu_si128((__m128i *) (y + x + 8), enc10_y8(&e, p[1], shift));
+        _mm_storeu_si128((__m128i *) (c + x), _mm_unpacklo_epi16(u, v));
+        _mm_storeu_si128((__m128i *) (c + x + 8), _mm_unpackhi_epi16(u, v));
+    }
+
+    csc_enc10_row48_tail(k, shift, src, y, c, c + 1, 2, x, width);
+}
+
+static void enc10_sp_row48(const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned short *src, unsigned short *y, unsigned short *c,
+        unsigned int width) {
+    if (shift == 0)
+        enc10_sp_row48_n(k, 0, src, y, c, width);
+    else
+        enc10_sp_row48_n(k, 6, src, y, c, width);
+}
+
+static inline __attribute__((always_inline)) void enc10_p_row48_n(
+        const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned short *src, unsigned short *y,
+        unsigned short *c0, unsigned short *c1, unsigned int width) {
+    struct enc48_consts e;
+    load_enc48_consts(&e, k);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i p[2][3], u, v;
+        deinterleave48(&e, src + x * 3, p[0]);
+        deinterleave48(&e, src + x * 3 + 24, p[1]);
+        enc10_c48(&e, p, shift, &u, &v);
+        _mm_storeu_si128((__m128i *) (y + x), enc10_y8(&e, p[0], shift));
+        _mm_storeu_si128((__m128i *) (y + x + 8), enc10_y8(&e, p[1], shift));
+        _mm_storeu_si128((__m128i *) (c0 + x / 2), u);
+        _mm_storeu_si128((__m128i *) (c1 + x / 2), v);
+    }
+
+    csc_enc10_row48_tail(k, shift, src, y, c0, c1, 1, x, width);
+}
+
+static void enc10_p_row48(const struct csc_enc_coefs *k, unsigned int shift,
+        const unsigned short *src, unsigned short *y,
+        unsigned short *c0, unsigned short *c1, unsigned int width) {
+    if (shift == 0)
+        enc10_p_row48_n(k, 0, src, y, c0, c1, width);
+    else
+        enc10_p_row48_n(k, 6, src, y, c0, c1, width);
+}
+
+/* adds_epu16 keeps the rounding from wrapping, packus saturates */
+static void narrow_row(const unsigned short *src, unsigned char *dst,
+        unsigned int count, unsigned int drop) {
+    const __m128i round = _mm_set1_epi16(1 << (drop - 1));
+
+    unsigned int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src + x));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + x + 8));
+        a = _mm_srli_epi16(_mm_adds_epu16(a, round), drop);
+        b = _mm_srli_epi16(_mm_adds_epu16(b, round), drop);
+        _mm_storeu_si128((__m128i *) (dst + x), _mm_packus_epi16(a, b));
+    }
+
+    csc_narrow_tail(src, dst, x, count, drop);
+}
+
+static void widen_row(const unsigned char *src, unsigned short *dst,
+        unsigned int count, unsigned int shift) {
+    unsigned int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + x));
+        _mm_storeu_si128((__m128i *) (dst + x),
+                _mm_slli_epi16(_mm_cvtepu8_epi16(v), shift));
+        _mm_storeu_si128((__m128i *) (dst + x + 8),
+                _mm_slli_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(v, 8)),
+                shift));
+    }
+
+    csc_widen_tail(src, dst, x, count, shift);
+}
+
+static void swap_rgb_row(unsigned char *row, unsigned int width) {
+    __m128i m[3][3];
+    for (int o = 0; o < 3; ++o)
+        for (int i = 0; i < 3; ++i)
+            m[o][i] = _mm_loadu_si128((const __m128i *) csc_swap_mask[o][i]);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        unsigned char *p = row + x * 3;
+        __m128i a = _mm_loadu_si128((const __m128i *) p);
+        __m128i b = _mm_loadu_si128((const __m128i *) (p + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *) (p + 32));
+        _mm_storeu_si128((__m128i *) p, _mm_or_si128(
+                _mm_shuffle_epi8(a, m[0][0]), _mm_shuffle_epi8(b, m[0][1])));
+        _mm_storeu_si128((__m128i *) (p + 16), _mm_or_si128(_mm_or_si128(
+                _mm_shuffle_epi8(a, m[1][0]), _mm_shuffle_epi8(b, m[1][1])),
+                _mm_shuffle_epi8(c, m[1][2])));
+        _mm_storeu_si128((__m128i *) (p + 32), _mm_or_si128(
+                _mm_shuffle_epi8(b, m[2][1]), _mm_shuffle_epi8(c, m[2][2])));
+    }
+
+    csc_swap_rgb_tail(row, x, width);
+}
+
+static void swap_pairs_row(unsigned char *row, unsigned int count) {
+    const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+            9, 8, 11, 10, 13, 12, 15, 14);
+
+    unsigned int x = 0;
+    for (; x + 8 <= count; x += 8) {
+        __m128i *p = (__m128i *) (row + x * 2);
+        _mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), mask));
+    }
+
+    csc_swap_pairs_tail(row, x, count);
+}
+
+static void swap_rows(unsigned char *a, unsigned char *b, unsigned int count) {
+    unsigned int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i *) (a + x));
+        __m128i vb = _mm_loadu_si128((const __m128i *) (b + x));
+        _mm_storeu_si128((__m128i *) (a + x), vb);
+        _mm_storeu_si128((__m128i *) (b + x), va);
+    }
+
+    csc_swap_rows_tail(a, b, x, count);
+}
+
+static void stream_row(unsigned char *dst, const unsigned char *src,
+        size_t size) {
+    size_t x = -(uintptr_t) dst & 15;
+    if (x > size)
+        x = size;
+    memcpy(dst, src, x);
+
+    for (; x + 16 <= size; x += 16)
+        _mm_stream_si128((__m128i *) (dst + x),
+                _mm_loadu_si128((const __m128i *) (src + x)));
+
+    memcpy(dst + x, src + x, size - x);
+    _mm_sfence();
+}
+
+/* The 16-bit sums stay below 2^16, so the logical shift is exact */
+static void lerp_row(const unsigned char *a, const unsigned char *b,
+        unsigned int f, unsigned char *dst, unsigned int count) {
+    const __m128i wa = _mm_set1_epi16(256 - f), wb = _mm_set1_epi16(f);
+    const __m128i round = _mm_set1_epi16(128), zero = _mm_setzero_si128();
+
+    unsigned int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i *) (a + x));
+        __m128i vb = _mm_loadu_si128((const __m128i *) (b + x));
+        __m128i lo = _mm_add_epi16(_mm_add_epi16(
+                _mm_mullo_epi16(_mm_cvtepu8_epi16(va), wa),
+                _mm_mullo_epi16(_mm_cvtepu8_epi16(vb), wb)), round);
+        __m128i hi = _mm_add_epi16(_mm_add_epi16(
+                _mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb)), round);
+        _mm_storeu_si128((__m128i *) (dst + x), _mm_packus_epi16(
+                _mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+
+    csc_lerp_tail(a, b, f, dst, x, count);
+}
+
+const struct csc_simd_kernels csc_simd_kernels_sse41 = {
+    .enc_y_row      = enc_y_row,
+    .enc_sp_row     = enc_sp_row,
+    .enc_p_row      = enc_p_row,
+    .dec_sp_rows    = dec_sp_rows,
+    .dec_p_rows     = dec_p_rows,
+    .enc_y_row4     = enc_y_row4,
+    .enc_sp_row4    = enc_sp_row4,
+    .enc_p_row4     = enc_p_row4,
+    .dec_sp_rows4   = dec_sp_rows4,
+    .dec_p_rows4    = dec_p_rows4,
+    .unpack422_sp_rows = unpack422_sp_rows,
+    .unpack422_p_rows  = unpack422_p_rows,
+    .dec10_sp_rows  = dec10_sp_rows,
+    .dec10_p_rows   = dec10_p_rows,
+    .enc10_y_row    = enc10_y_row,
+    .enc10_sp_row   = enc10_sp_row,
+    .enc10_p_row    = enc10_p_row,
+    .dec10_sp_rows48 = dec10_sp_rows48,
+    .dec10_p_rows48  = dec10_p_rows48,
+    .enc10_y_row48   = enc10_y_row48,
+    .enc10_sp_row48  = enc10_sp_row48,
+    .enc10_p_row48   = enc10_p_row48,
+    .narrow_row     = narrow_row,
+    .widen_row      = widen_row,
+    .swap_rgb_row   = swap_rgb_row,
+    .swap_pairs_row = swap_pairs_row,
+    .swap_rows      = swap_rows,
+    .stream_row     = stream_row,
+    .lerp_row       = lerp_row,
+};
+
+#endif // __SSE4_1__
@@ -0,0 +1,281 @@
+/*
+ * conv_rgb_yuv_stats.c
+ *
+ * Per-thread conversion counters behind csc_stats_snapshot(), compiled
+ * in with -DCSC_STATS.
+ */
+
+#define _GNU_SOURCE
+
+#include "conv_rgb_yuv_mt.h"
+
+#ifdef CSC_STATS
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* a slot per format pair and one for the _tensor functions */
+#define N_KEYS  (CSC_FORMAT_COUNT * CSC_FORMAT_COUNT + 1)
+
+static const char *format_names[CSC_FORMAT_COUNT] = {
+    [CSC_FORMAT_RGB24]  = "rgb24",
+    [CSC_FORMAT_BGR24]  = "bgr24",
+    [CSC_FORMAT_NV12]   = "nv12",
+    [CSC_FORMAT_NV21]   = "nv21",
+    [CSC_FORMAT_I420]   = "i420",
+    [CSC_FORMAT_YV12]   = "yv12",
+    [CSC_FORMAT_RGBA32] = "rgba32",
+    [CSC_FORMAT_BGRA32] = "bgra32",
+    [CSC_FORMAT_ARGB32] = "argb32",
+    [CSC_FORMAT_ABGR32] = "abgr32",
+    [CSC_FORMAT_YUYV]   = "yuyv",
+    [CSC_FORMAT_UYVY]   = "uyvy",
+    [CSC_FORMAT_P010]   = "p010",
+    [CSC_FORMAT_I010]   = "i010",
+    [CSC_FORMAT_RGB48]  = "rgb48",
+};
+
+struct counters {
+    atomic_ullong calls, pixels, bytes, ns;
+    atomic_ullong hist[CSC_STATS_BUCKETS];
+};
+
+/*
+ * Written only by its thread, read by csc_stats_snapshot(). Never freed,
+ * so the counts of a thread that has exited still add up.
+ */
+struct thread_stats {
+    struct thread_stats *next;
+    csc_rows_fn last_rows, last_inner;      /* of the last job counted */
+    unsigned int last_key;                  /* and its slot */
+    struct counters c[N_KEYS];
+};
+
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct thread_stats *threads;
+static _Thread_local struct thread_stats *self;
+
+/*
+ * The trace hook, published as one pair so a thread never calls fn with
+ * the user of another. Pairs are kept for reuse and never freed, as a
+ * converting thread may still be reading a replaced one.
+ */
+struct trace_hook {
+    csc_trace_fn fn;
+    void *user;
+    struct trace_hook *next;
+};
+
+static pthread_mutex_t hooks_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_hook *hooks;
+static const struct trace_hook *_Atomic trace_hook;
+
+unsigned long long csc_stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static struct thread_stats *thread_stats(void) {
+    if (self == NULL) {
+        self = calloc(1, sizeof(*self));
+        if (self == NULL)
+            return NULL;
+
+        pthread_mutex_lock(&threads_lock);
+        self->next = threads;
+        threads = self;
+        pthread_mutex_unlock(&threads_lock);
+    }
+
+    return self;
+}
+
+/* Only this thread writes c, so a plain add is enough */
+static inline void count(atomic_ullong *c, unsigned long long n) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) +
+            n, memory_order_relaxed);
+}
+
+static unsigned int bucket(unsigned long long ns) {
+    unsigned int b = ns != 0 ? 63 - __builtin_clzll(ns) : 0;
+    return b < CSC_STATS_BUCKETS ? b : CSC_STATS_BUCKETS - 1;
+}
+
+static void key_formats(unsigned int key, int *src, int *dst) {
+    *src = key < N_KEYS - 1 ? (int) (key / CSC_FORMAT_COUNT) : -1;
+    *dst = key < N_KEYS - 1 ? (int) (key % CSC_FORMAT_COUNT) : -1;
+}
+
+static size_t frame_bytes(int format, size_t width, size_t height) {
+    return format >= 0 ?
+            csc_frame_init_large(NULL, format, NULL, width, height) : 0;
+}
+
+void csc_stats_record(const struct csc_job *job,
+        unsigned long long start, unsigned long long ns) {
+    struct thread_stats *t = thread_stats();
+    if (t == NULL)
+        return;
+
+    int src, dst;
+    if (job->rows != t->last_rows || job->inner != t->last_inner) {
+        csc_job_formats(job, &src, &dst);
+        t->last_rows = job->rows;
+        t->last_inner = job->inner;
+        t->last_key = src >= 0 ? src * CSC_FORMAT_COUNT + dst : N_KEYS - 1;
+    }
+    unsigned int key = t->last_key;
+    key_formats(key, &src, &dst);
+
+    /* the source of a downscale is 2^shift times the output each way */
+    size_t pixels = (size_t) job->width * job->height;
+    size_t bytes = frame_bytes(dst, job->width, job->height);
+    if (job->in_width != 0)
+        bytes += frame_bytes(src, job->in_width, job->in_height);
+    else
+        bytes += frame_bytes(src, (size_t) job->width << job->shift,
+                (size_t) job->height << job->shift);
+
+    struct counters *c = &t->c[key];
+    count(&c->calls, 1);
+    count(&c->pixels, pixels);
+    count(&c->bytes, bytes);
+    count(&c->ns, ns);
+    count(&c->hist[bucket(ns)], 1);
+
+    const struct trace_hook *hook = atomic_load_explicit(&trace_hook,
+            memory_order_acquire);
+    if (hook != NULL) {
+        csc_trace_event event = { src, dst, job->width, job->height,
+                start, ns };
+        hook->fn(hook->user, &event);
+    }
+}
+
+int csc_stats_snapshot(csc_stats_entry *entries, unsigned int max) {
+    static csc_stats_entry sum[N_KEYS];
+    static pthread_mutex_t sum_lock = PTHREAD_MUTEX_INITIALIZER;
+
+    pthread_mutex_lock(&sum_lock);
+    memset(sum, 0, sizeof(sum));
+
+    pthread_mutex_lock(&threads_lock);
+    for (const struct thread_stats *t = threads; t != NULL; t = t->next) {
+        for (unsigned int k = 0; k < N_KEYS; ++k) {
+            const struct counters *c = &t->c[k];
+            sum[k].calls += atomic_load_explicit(&c->calls,
+                    memory_order_relaxed);
+            sum[k].pixels += atomic_load_explicit(&c->pixels,
+                    memory_order_relaxed);
+            sum[k].bytes += atomic_load_explicit(&c->bytes,
+                    memory_order_relaxed);
+            sum[k].ns += atomic_load_explicit(&c->ns, memory_order_relaxed);
+            for (unsigned int b = 0; b < CSC_STATS_BUCKETS; ++b)
+                sum[k].hist[b] += atomic_load_explicit(&c->hist[b],
+                        memory_order_relaxed);
+        }
+    }
+    pthread_mutex_unlock(&threads_lock);
+
+    unsigned int n = 0;
+    for (unsigned int k = 0; k < N_KEYS; ++k) {
+        if (sum[k].calls == 0)
+            continue;
+        key_formats(k, &sum[k].src_format, &sum[k].dst_format);
+        if (n < max)
+            entries[n] = sum[k];
+        ++n;
+    }
+    pthread_mutex_unlock(&sum_lock);
+
+    return n;
+}
+
+/* the _tensor functions go from 4:2:0 */
+static const char *format_name(int format, const char *unknown) {
+    return format >= 0 ? format_names[format] : unknown;
+}
+
+size_t csc_stats_dump(char *buf, size_t size) {
+    size_t len = 0;
+    if (size != 0)
+        buf[0] = '\0';
+
+    csc_stats_entry *entries = malloc(N_KEYS * sizeof(*entries));
+    if (entries == NULL)
+        return 0;
+    int n = csc_stats_snapshot(entries, N_KEYS);
+
+/* append to buf as far as it goes, counting the whole length */
+#define APPEND(...) do { \
+        int w = snprintf(len < size ? buf + len : NULL, \
+                len < size ? size - len : 0, __VA_ARGS__); \
+        len += w > 0 ? (size_t) w : 0; \
+    } while (0)
+
+    for (int i = 0; i < n; ++i) {
+        const csc_stats_entry *e = &entries[i];
+        APPEND("%s:%s calls %llu pixels %llu bytes %llu ns %llu hist",
+                format_name(e->src_format, "yuv420"),
+                format_name(e->dst_format, "tensor"),
+                e->calls, e->pixels, e->bytes, e->ns);
+        for (unsigned int b = 0; b < CSC_STATS_BUCKETS; ++b)
+            if (e->hist[b] != 0)
+                APPEND(" %u:%llu", b, e->hist[b]);
+        APPEND("\n");
+    }
+
+#undef APPEND
+
+    free(entries);
+
+    return len;
+}
+
+int csc_stats_set_trace(csc_trace_fn fn, void *user) {
+    if (fn == NULL) {
+        atomic_store_explicit(&trace_hook, NULL, memory_order_release);
+        return 0;
+    }
+
+    pthread_mutex_lock(&hooks_lock);
+    struct trace_hook *hook = hooks;
+    while (hook != NULL && (hook->fn != fn || hook->user != user))
+        hook = hook->next;
+    if (hook == NULL && (hook = malloc(sizeof(*hook))) != NULL) {
+        *hook = (struct trace_hook) { fn, user, hooks };
+        hooks = hook;
+    }
+    if (hook != NULL)
+        atomic_store_explicit(&trace_hook, hook, memory_order_release);
+    pthread_mutex_unlock(&hooks_lock);
+
+    return hook != NULL ? 0 : -1;
+}
+
+#else
+
+int csc_stats_snapshot(csc_stats_entry *entries, unsigned int max) {
+    (void) entries;
+    (void) max;
+    return -1;
+}
+
+size_t csc_stats_dump(char *buf, size_t size) {
+    if (size != 0)
+        buf[0] = '\0';
+    return 0;
+}
+
+int csc_stats_set_trace(csc_trace_fn fn, void *user) {
+    (void) fn;
+    (void) user;
+    return -1;
+}
+
+#endif // CSC_STATS
@@ -5,114 +5,493 @@
  *      Author: ljm
  */
 
+#define _GNU_SOURCE
+
 #include "conv_rgb_yuv.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *format_names[CSC_FORMAT_COUNT] = {
+    [CSC_FORMAT_RGB24]  = "rgb24",
+    [CSC_FORMAT_BGR24]  = "bgr24",
+    [CSC_FORMAT_NV12]   = "nv12",
+    [CSC_FORMAT_NV21]   = "nv21",
+    [CSC_FORMAT_I420]   = "i420",
+    [CSC_FORMAT_YV12]   = "yv12",
+    [CSC_FORMAT_RGBA32] = "rgba32",
+    [CSC_FORMAT_BGRA32] = "bgra32",
+    [CSC_FORMAT_ARGB32] = "argb32",
+    [CSC_FORMAT_ABGR32] = "abgr32",
+    [CSC_FORMAT_YUYV]   = "yuyv",
+    [CSC_FORMAT_UYVY]   = "uyvy",
+    [CSC_FORMAT_P010]   = "p010",
+    [CSC_FORMAT_I010]   = "i010",
+    [CSC_FORMAT_RGB48]  = "rgb48",
+};
+
+/* The numbered conversions of the original command line */
+static const struct {
+    int src, dst;
+} cscs[] = {
+    [1]  = { CSC_FORMAT_RGB24, CSC_FORMAT_NV12 },
+    [2]  = { CSC_FORMAT_BGR24, CSC_FORMAT_NV21 },
+    [3]  = { CSC_FORMAT_NV12, CSC_FORMAT_RGB24 },
+    [4]  = { CSC_FORMAT_NV21, CSC_FORMAT_BGR24 },
+    [5]  = { CSC_FORMAT_RGB24, CSC_FORMAT_I420 },
+    [6]  = { CSC_FORMAT_BGR24, CSC_FORMAT_YV12 },
+    [7]  = { CSC_FORMAT_I420, CSC_FORMAT_RGB24 },
+    [8]  = { CSC_FORMAT_YV12, CSC_FORMAT_BGR24 },
+    [9]  = { CSC_FORMAT_NV12, CSC_FORMAT_NV21 },
+    [10] = { CSC_FORMAT_RGB24, CSC_FORMAT_BGR24 },
+    [11] = { CSC_FORMAT_I420, CSC_FORMAT_YV12 },
+    [12] = { CSC_FORMAT_I420, CSC_FORMAT_NV12 },
+    [13] = { CSC_FORMAT_YV12, CSC_FORMAT_NV21 },
+    [14] = { CSC_FORMAT_NV12, CSC_FORMAT_I420 },
+    [15] = { CSC_FORMAT_NV21, CSC_FORMAT_YV12 },
+};
+
+#define N_CSCS  (int) (sizeof(cscs) / sizeof(cscs[0]))
+
+/* A conversion resolved once and run on every frame */
+struct conversion {
+    csc_plan *plan;
+    int src_format, dst_format;
+    int width, height;
+};
+
+static int parse_format(const char *name, size_t len) {
+    for (int i = 0; i < CSC_FORMAT_COUNT; ++i)
+        if (strlen(format_names[i]) == len &&
+                strncmp(name, format_names[i], len) == 0)
+            return i;
+    return -1;
+}
+
+/* csc is a number from the table above or src:dst by format name */
+static int parse_csc(const char *csc, int *src, int *dst) {
+    const char *colon = strchr(csc, ':');
+    if (colon != NULL) {
+        *src = parse_format(csc, colon - csc);
+        *dst = parse_format(colon + 1, strlen(colon + 1));
+        return *src >= 0 && *dst >= 0 ? 0 : -1;
+    }
+
+    int n = atoi(csc);
+    if (n < 1 || n >= N_CSCS)
+        return -1;
+    *src = cscs[n].src;
+    *dst = cscs[n].dst;
+    return 0;
+}
+
+/* Convert one frame into buf, returning the bytes written or 0 */
+static unsigned int convert_frame(const struct conversion *conv,
+        const unsigned char *in, unsigned char *buf) {
+    csc_frame src, dst;
+    csc_frame_init(&src, conv->src_format, (unsigned char *) in,
+            conv->width, conv->height);
+    size_t size = csc_frame_init(&dst, conv->dst_format, buf,
+            conv->width, conv->height);
+
+    return csc_plan_execute(conv->plan, &src, &dst) == 0 ? size : 0;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(unsigned long frames, size_t in_size, size_t out_size,
+        double seconds) {
+    double mb_in = (double) frames * in_size / 1e6;
+    double mb_out = (double) frames * out_size / 1e6;
+    if (seconds <= 0)
+        seconds = 1e-9;
+
+    fprintf(stderr, "%lu frames, %.1f MB in, %.1f MB out, %.3f s, "
+            "%.1f fps, %.1f MB/s\n", frames, mb_in, mb_out, seconds,
+            frames / seconds, (mb_in + mb_out) / seconds);
+
+    /* empty unless built with make STATS=1 */
+    char stats[1024];
+    if (csc_stats_dump(stats, sizeof(stats)) != 0)
+        fputs(stats, stderr);
+}
+
+/*
+ * Walk a mapped raw video file frame by frame. Pages of frames already
+ * converted are dropped from the mapping and the output is streamed, so
+ * memory stays at about one frame whatever the file size.
+ */
+static int convert_file(const struct conversion *conv,
+        const char *in_file, const char *out_file,
+        size_t in_size, size_t out_size) {
+    int fd = open(in_file, O_RDONLY);
+    if (fd < 0) {
+        perror(in_file);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < in_size) {
+        fprintf(stderr, "%s: shorter than one %dx%d frame\n",
+                in_file, conv->width, conv->height);
+        close(fd);
+        return -1;
+    }
+
+    size_t file_size = st.st_size;
+    unsigned char *file_data = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE,
+            fd, 0);
+    close(fd);
+    if (file_data == MAP_FAILED) {
+        perror(in_file);
+        return -1;
+    }
+    madvise(file_data, file_size, MADV_SEQUENTIAL);
+
+    FILE *file = fopen(out_file, "wb");
+    if (file == NULL) {
+        perror(out_file);
+        munmap(file_data, file_size);
+        return -1;
+    }
+
+    unsigned char *buf = (unsigned char *) malloc(out_size);
+    if (buf == NULL) {
+        fclose(file);
+        munmap(file_data, file_size);
+        return -1;
+    }
+
+    long page = sysconf(_SC_PAGESIZE);
+    size_t frames = file_size / in_size, dropped = 0;
+    int ret = 0;
+
+    double start = now_seconds();
+    for (size_t i = 0; i < frames; ++i) {
+        const unsigned char *in = file_data + i * in_size;
+        unsigned int size = convert_frame(conv, in, buf);
+        if (size == 0 || fwrite(buf, 1, size, file) != size) {
+            perror(out_file);
+            ret = -1;
+            break;
+        }
+
+        size_t done = (i + 1) * in_size / page * page;
+        if (done > dropped) {
+            madvise(file_data + dropped, done - dropped, MADV_DONTNEED);
+            dropped = done;
+        }
+    }
+
+    if (fclose(file) != 0 && ret == 0) {
+        perror(out_file);
+        ret = -1;
+    }
+    double seconds = now_seconds() - start;
+
+    if (ret == 0) {
+        if (file_size % in_size != 0)
+            fprintf(stderr, "%s: ignoring %zu trailing bytes\n",
+                    in_file, file_size % in_size);
+        report(frames, in_size, out_size, seconds);
+    }
+
+    free(buf);
+    buf = NULL;
+
+    munmap(file_data, file_size);
+
+    return ret;
+}
+
+/* frames in flight between the reader, converter and writer */
+#define RING_SLOTS  4
+
+struct stream {
+    const struct conversion *conv;
+    int in_fd, out_fd;
+    size_t in_size, out_size;
+    unsigned char *in[RING_SLOTS], *out[RING_SLOTS];
+    unsigned int out_len[RING_SLOTS];
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    /* frames read, converted and written so far; slot = count % RING_SLOTS */
+    unsigned long n_read, n_converted, n_written;
+    int eof, error;
+    size_t trailing;
+};
+
+/* Read up to size bytes, stopping early only at EOF */
+static ssize_t read_full(int fd, unsigned char *buf, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, buf + done, size - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return -1;
+        if (n == 0)
+            break;
+        done += n;
+    }
+    return done;
+}
+
+static int write_full(int fd, const unsigned char *buf, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, buf, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return -1;
+        buf += n;
+        size -= n;
+    }
+    return 0;
+}
+
+static void stream_fail(struct stream *s, const char *what) {
+    perror(what);
+    pthread_mutex_lock(&s->lock);
+    s->error = 1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void *stream_reader(void *arg) {
+    struct stream *s = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        while (s->n_read - s->n_written == RING_SLOTS && !s->error)
+            pthread_cond_wait(&s->cond, &s->lock);
+        int stop = s->error;
+        unsigned int slot = s->n_read % RING_SLOTS;
+        pthread_mutex_unlock(&s->lock);
+        if (stop)
+            break;
+
+        ssize_t n = read_full(s->in_fd, s->in[slot], s->in_size);
+        if (n < 0) {
+            stream_fail(s, "read");
+            break;
+        }
+
+        pthread_mutex_lock(&s->lock);
+        if ((size_t) n == s->in_size) {
+            ++s->n_read;
+        } else {
+            s->trailing = n;
+            s->eof = 1;
+        }
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+        if ((size_t) n != s->in_size)
+            break;
+    }
+
+    return NULL;
+}
+
+static void *stream_writer(void *arg) {
+    struct stream *s = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        while (s->n_written == s->n_converted && !s->error &&
+                !(s->eof && s->n_converted == s->n_read))
+            pthread_cond_wait(&s->cond, &s->lock);
+        int stop = s->error || s->n_written == s->n_converted;
+        unsigned int slot = s->n_written % RING_SLOTS;
+        pthread_mutex_unlock(&s->lock);
+        if (stop)
+            break;
+
+        if (write_full(s->out_fd, s->out[slot], s->out_len[slot]) != 0) {
+            stream_fail(s, "write");
+            break;
+        }
+
+        pthread_mutex_lock(&s->lock);
+        ++s->n_written;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+    }
+
+    return NULL;
+}
+
+/*
+ * Convert fixed-size frames from in_fd to out_fd, either of which may be a
+ * pipe. A reader and a writer thread keep a ring of RING_SLOTS frames
+ * moving while the calling thread converts, so I/O overlaps conversion and
+ * a slow consumer stalls the reader instead of growing memory.
+ */
+static int convert_stream(const struct conversion *conv, int in_fd,
+        int out_fd, size_t in_size, size_t out_size) {
+    struct stream s = {
+        .conv = conv,
+        .in_fd = in_fd, .out_fd = out_fd,
+        .in_size = in_size, .out_size = out_size,
+    };
+    int ret = -1;
+
+    /* the ring's buffers, faulted in before the clock starts */
+    csc_pool *in_pool = csc_pool_create(conv->src_format, conv->width,
+            conv->height, RING_SLOTS, CSC_POOL_PREFAULT);
+    csc_pool *out_pool = csc_pool_create(conv->dst_format, conv->width,
+            conv->height, RING_SLOTS, CSC_POOL_PREFAULT);
+    for (int i = 0; i < RING_SLOTS; ++i) {
+        s.in[i] = csc_pool_get(in_pool, NULL);
+        s.out[i] = csc_pool_get(out_pool, NULL);
+        if (s.in[i] == NULL || s.out[i] == NULL)
+            goto out;
+    }
+
+    /* a closed downstream pipe is a write error, not a signal */
+    signal(SIGPIPE, SIG_IGN);
+
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.cond, NULL);
+
+    double start = now_seconds();
+
+    pthread_t reader, writer;
+    if (pthread_create(&reader, NULL, stream_reader, &s) != 0)
+        goto destroy;
+    if (pthread_create(&writer, NULL, stream_writer, &s) != 0) {
+        stream_fail(&s, "pthread_create");
+        pthread_join(reader, NULL);
+        goto destroy;
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&s.lock);
+        while (s.n_converted == s.n_read && !s.eof && !s.error)
+            pthread_cond_wait(&s.cond, &s.lock);
+        int stop = s.error || s.n_converted == s.n_read;
+        unsigned int slot = s.n_converted % RING_SLOTS;
+        pthread_mutex_unlock(&s.lock);
+        if (stop)
+            break;
+
+        s.out_len[slot] = convert_frame(conv, s.in[slot], s.out[slot]);
+
+        pthread_mutex_lock(&s.lock);
+        ++s.n_converted;
+        pthread_cond_broadcast(&s.cond);
+        pthread_mutex_unlock(&s.lock);
+    }
+
+    pthread_join(reader, NULL);
+    pthread_join(writer, NULL);
+
+    if (!s.error) {
+        if (s.trailing != 0)
+            fprintf(stderr, "ignoring %zu trailing bytes\n", s.trailing);
+        report(s.n_written, in_size, out_size, now_seconds() - start);
+        ret = 0;
+    }
+
+destroy:
+    pthread_cond_destroy(&s.cond);
+    pthread_mutex_destroy(&s.lock);
+
+out:
+    csc_pool_destroy(in_pool);
+    csc_pool_destroy(out_pool);
+
+    return ret;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s csc in_file out_file width height\n"
+           "csc:\n", prog);
+    for (int i = 1; i < N_CSCS; ++i)
+        printf("\t%d. %s --> %s\n", i, format_names[cscs[i].src],
+                format_names[cscs[i].dst]);
+    printf("\tor src:dst for any pair of");
+    for (int i = 0; i < CSC_FORMAT_COUNT; ++i)
+        printf(" %s", format_names[i]);
+    printf("\n"
+           "in_file may hold any number of frames, all are converted.\n"
+           "Use - for in_file/out_file to stream from stdin/to stdout.\n");
+}
 
 int main(int argc, char *argv[]) {
     if (argc < 6) {
-        printf("Usage: %s csc in_file out_file width height\n"
-               "csc:\n"
-               "\t1. rgb24 --> yuv420sp/nv12\n"
-               "\t2. bgr24 --> yvu420sp/nv21\n"
-               "\t3. yuv420sp/nv12 --> rgb24\n"
-               "\t4. yvu420sp/nv21 --> bgr24\n"
-               "\t5. rgb24 --> yuv420p\n"
-               "\t6. bgr24 --> yvu420p\n"
-               "\t7. yuv420p --> rgb24\n"
-               "\t8. yvu420p --> bgr24\n"
-               "\t9. yuv420sp/nv12 <-> yvu420sp/nv21\n"
-               "\t10. rgb24 <-> bgr24\n"
-               "\t11. yuv420p <-> yvu420p\n"
-               "\t12. yuv420p --> yuv420sp/nv12\n"
-               "\t13. yvu420p --> yvu420sp/nv21\n"
-               "\t14. yuv420sp/nv12 --> yuv420p\n"
-               "\t15. yvu420sp/nv21 --> yvu420p\n", argv[0]);
+        usage(argv[0]);
         return EXIT_FAILURE;
     }
 
-    int csc = atoi(argv[1]);
+    struct conversion conv;
+    if (parse_csc(argv[1], &conv.src_format, &conv.dst_format) != 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
 
     const char *in_file = argv[2];
     const char *out_file = argv[3];
     int width = atoi(argv[4]);
     int height = atoi(argv[5]);
 
-    FILE *file = fopen(in_file, "rb");
-    if (file != NULL) {
-        fseek(file, 0, SEEK_END);
-        long file_size = ftell(file);
-        fseek(file, 0, SEEK_SET);
+    if (width <= 0 || height <= 0 || width > 0xffff || height > 0xffff)
+        return -1;
 
-        unsigned char *file_data = (unsigned char *) malloc(file_size);
-        fread(file_data, 1, file_size, file);
-        fclose(file);
-
-        unsigned int buf_size = width * height * 3;
-        unsigned char *buf = (unsigned char *) malloc(buf_size);
-
-        int out_size = 0;
-        if (1 == csc)
-            out_size = rgb_to_yuv420sp(file_data, width, height, buf, buf_size);
-        else if (2 == csc)
-            out_size = bgr_to_yvu420sp(file_data, width, height, buf, buf_size);
-        else if (3 == csc)
-            out_size = yuv420sp_to_rgb(file_data, width, height, buf, buf_size);
-        else if (4 == csc)
-            out_size = yvu420sp_to_bgr(file_data, width, height, buf, buf_size);
-        else if (5 == csc)
-            out_size = rgb_to_yuv420p(file_data, width, height, buf, buf_size);
-        else if (6 == csc)
-            out_size = bgr_to_yvu420p(file_data, width, height, buf, buf_size);
-        else if (7 == csc)
-            out_size = yuv420p_to_rgb(file_data, width, height, buf, buf_size);
-        else if (8 == csc)
-            out_size = yvu420p_to_bgr(file_data, width, height, buf, buf_size);
-        else if (9 == csc)
-            out_size = convert_yuv420sp_yvu420sp(file_data, width, height);
-        else if (10 == csc)
-            out_size = convert_rgb_bgr(file_data, width, height);
-        else if (11 == csc)
-            out_size = convert_yuv420p_yvu420p(file_data, width, height);
-        else if (12 == csc)
-            out_size = yuv420p_to_yuv420sp(file_data, width, height,
-                buf, buf_size);
-        else if (13 == csc)
-            out_size = yvu420p_to_yvu420sp(file_data, width, height,
-                buf, buf_size);
-        else if (14 == csc)
-            out_size = yuv420sp_to_yuv420p(file_data, width, height,
-                buf, buf_size);
-        else if (15 == csc)
-            out_size = yvu420sp_to_yvu420p(file_data, width, height,
-                buf, buf_size);
-        else {
-            free(buf);
-            buf = NULL;
-
-            free(file_data);
-            file_data = NULL;
-            return -1;
-        }
+    conv.width = width;
+    conv.height = height;
+    conv.plan = csc_plan_create(conv.src_format, conv.dst_format,
+            width, height, NULL);
+    if (conv.plan == NULL)
+        return -1;
 
-        file = fopen(out_file, "wb");
-        if (file != NULL) {
-            if (9 == csc || 10 == csc || 11 == csc)
-                fwrite(file_data, 1, out_size, file);
-            else
-                fwrite(buf, 1, out_size, file);
+    size_t in_size = csc_frame_init(NULL, conv.src_format, NULL,
+            width, height);
+    size_t out_size = csc_frame_init(NULL, conv.dst_format, NULL,
+            width, height);
 
-            fflush(file);
-            fclose(file);
-        }
+    int ret;
+    if (strcmp(in_file, "-") != 0 && strcmp(out_file, "-") != 0) {
+        ret = convert_file(&conv, in_file, out_file, in_size, out_size);
+        csc_plan_destroy(conv.plan);
+        return ret != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
 
-        free(buf);
-        buf = NULL;
+    int in_fd = STDIN_FILENO, out_fd = STDOUT_FILENO;
+    if (strcmp(in_file, "-") != 0 && (in_fd = open(in_file, O_RDONLY)) < 0) {
+        perror(in_file);
+        return EXIT_FAILURE;
+    }
+    if (strcmp(out_file, "-") != 0 && (out_fd = open(out_file,
+            O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        perror(out_file);
+        return EXIT_FAILURE;
+    }
 
-        free(file_data);
-        file_data = NULL;
+    ret = convert_stream(&conv, in_fd, out_fd, in_size, out_size);
+    if (out_fd != STDOUT_FILENO && close(out_fd) != 0) {
+        perror(out_file);
+        ret = -1;
     }
+    if (in_fd != STDIN_FILENO)
+        close(in_fd);
+    csc_plan_destroy(conv.plan);
+    if (ret != 0)
+        return EXIT_FAILURE;
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,274 @@
+/*
+ * simd_test.c
+ *
+ * Every conversion of csc_convert(), plain, downscaled, resized, on an
+ * ROI and in place, and the _tensor functions give the same bytes at
+ * each SIMD level the CPU has as with the scalar code.
+ */
+
+#include "conv_rgb_yuv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* largest frame tested, 8 bytes a pixel */
+#define BUF_SIZE    (256 * 32 * 8)
+
+static const char *format_names[CSC_FORMAT_COUNT] = {
+    "RGB24", "BGR24", "NV12", "NV21", "I420", "YV12", "RGBA32", "BGRA32",
+    "ARGB32", "ABGR32", "YUYV", "UYVY", "P010", "I010", "RGB48",
+};
+
+enum {
+    VARIANT_PLAIN,
+    VARIANT_FACTOR2,
+    VARIANT_FACTOR4,
+    VARIANT_FACTOR8,
+    VARIANT_ROI_ODD,
+    VARIANT_ROI_EVEN,
+    VARIANT_UPSIZE,
+    VARIANT_DOWNSIZE,
+    VARIANT_IN_PLACE,
+    VARIANT_IN_PLACE_ROI,
+    VARIANT_COUNT,
+};
+
+static const char *variant_names[VARIANT_COUNT] = {
+    "plain", "factor 2", "factor 4", "factor 8", "odd roi", "even roi",
+    "upsize", "downsize", "in place", "in place roi",
+};
+
+/* widths cover every SIMD tail length, heights a few row pairs */
+static const unsigned int widths[] = { 6, 14, 34, 62, 98, 130, 250 };
+static const unsigned int heights[] = { 4, 10, 18 };
+
+static const char *level_names[] = { "scalar", "sse41", "avx2" };
+
+static unsigned char src_buf[BUF_SIZE], ref_buf[BUF_SIZE],
+        out_buf[BUF_SIZE];
+
+static unsigned int failures, checks;
+
+static void fill_random(unsigned char *buf, size_t size) {
+    unsigned int x = 2463534242u;
+    for (size_t i = 0; i < size; ++i) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = x;
+    }
+}
+
+/* Formats that swap into each other in place share a group */
+static int swap_group(int format) {
+    switch (format) {
+    case CSC_FORMAT_RGB24: case CSC_FORMAT_BGR24:
+        return 1;
+    case CSC_FORMAT_NV12: case CSC_FORMAT_NV21:
+        return 2;
+    case CSC_FORMAT_I420: case CSC_FORMAT_YV12:
+        return 3;
+    case CSC_FORMAT_RGBA32: case CSC_FORMAT_BGRA32:
+    case CSC_FORMAT_ARGB32: case CSC_FORMAT_ABGR32:
+        return 4;
+    case CSC_FORMAT_YUYV: case CSC_FORMAT_UYVY:
+        return 5;
+    }
+
+    return 0;
+}
+
+/* bytes past the output checked for stray writes */
+#define GUARD_SIZE  64
+
+/*
+ * Run one case into out_buf, 0 or -1 as csc_convert() returns, with the
+ * bytes of out_buf to compare in size
+ */
+static int run_case(int src_format, int dst_format, int variant,
+        unsigned int width, unsigned int height, int matrix, int range,
+        size_t *size) {
+    csc_opts opts = { 0 };
+    csc_rect roi;
+    unsigned int out_width = width, out_height = height;
+    int in_place = 0;
+
+    switch (variant) {
+    case VARIANT_FACTOR2:
+    case VARIANT_FACTOR4:
+    case VARIANT_FACTOR8:
+        opts.factor = 1 << (variant - VARIANT_FACTOR2 + 1);
+        out_width = (width / opts.factor) & ~1u;
+        out_height = (height / opts.factor) & ~1u;
+        break;
+    case VARIANT_IN_PLACE_ROI:
+        in_place = 1;
+        /* fall through */
+    case VARIANT_ROI_ODD:
+        roi = (csc_rect) { 1, 1, width - 3, height - 3 };
+        opts.roi = &roi;
+        break;
+    case VARIANT_ROI_EVEN:
+        roi = (csc_rect) { 2, 2, width - 4, height - 2 };
+        opts.roi = &roi;
+        break;
+    case VARIANT_UPSIZE:
+        opts.out_width = out_width = width * 3 / 2 & ~1u;
+        opts.out_height = out_height = height * 3 / 2 & ~1u;
+        break;
+    case VARIANT_DOWNSIZE:
+        opts.out_width = out_width = (width / 3 + 2) & ~1u;
+        opts.out_height = out_height = (height / 3 + 2) & ~1u;
+        break;
+    case VARIANT_IN_PLACE:
+        in_place = 1;
+        break;
+    }
+    if (opts.roi != NULL && !in_place) {
+        out_width = roi.width;
+        out_height = roi.height;
+    }
+
+    csc_frame src, dst;
+    if (in_place) {
+        *size = csc_frame_init(&src, src_format, out_buf, width, height);
+        csc_frame_init(&dst, dst_format, out_buf, width, height);
+        memcpy(out_buf, src_buf, *size);
+    } else {
+        csc_frame_init(&src, src_format, src_buf, width, height);
+        *size = csc_frame_init(&dst, dst_format, out_buf, out_width,
+                out_height);
+        memset(out_buf, 0xa5, *size);
+    }
+    *size += GUARD_SIZE;
+    memset(out_buf + *size - GUARD_SIZE, 0xa5, GUARD_SIZE);
+    src.matrix = dst.matrix = matrix;
+    src.range = dst.range = range;
+
+    return csc_convert(src_format, dst_format, &src, &dst, width, height,
+            &opts);
+}
+
+static void check_case(int src_format, int dst_format, int variant,
+        unsigned int width, unsigned int height, int max_level) {
+    int in_place = variant == VARIANT_IN_PLACE ||
+            variant == VARIANT_IN_PLACE_ROI;
+    if (in_place && (src_format == dst_format ||
+            swap_group(src_format) == 0 ||
+            swap_group(src_format) != swap_group(dst_format)))
+        return;
+
+    for (int matrix = CSC_MATRIX_BT601; matrix <= CSC_MATRIX_BT2020;
+            ++matrix) {
+        for (int range = CSC_RANGE_LIMITED; range <= CSC_RANGE_FULL;
+                ++range) {
+            size_t size;
+            csc_set_simd_level(CSC_SIMD_NONE);
+            int ret = run_case(src_format, dst_format, variant, width,
+                    height, matrix, range, &size);
+            if (ret != 0)
+                return;
+            memcpy(ref_buf, out_buf, size);
+
+            for (int level = CSC_SIMD_NONE + 1; level <= max_level;
+                    ++level) {
+                csc_set_simd_level(level);
+                ret = run_case(src_format, dst_format, variant, width,
+                        height, matrix, range, &size);
+                ++checks;
+                if (ret == 0 && memcmp(ref_buf, out_buf, size) == 0)
+                    continue;
+
+                size_t at = 0;
+                while (at < size && ref_buf[at] == out_buf[at])
+                    ++at;
+                fprintf(stderr, "%s -> %s %s %ux%u matrix %d range %d: "
+                        "%s differs from scalar at byte %zu\n",
+                        format_names[src_format], format_names[dst_format],
+                        variant_names[variant], width, height, matrix,
+                        range, level_names[level], at);
+                ++failures;
+            }
+        }
+    }
+}
+
+typedef int (*tensor_fn)(csc_ctx *ctx, const csc_frame *src,
+        const csc_tensor *dst, unsigned short width, unsigned short height);
+
+static void check_tensor(const char *name, tensor_fn fn, int src_format,
+        int type, unsigned int width, unsigned int height, int max_level) {
+    static const size_t sizes[] = { 4, 2, 1 };
+    size_t stride = width * sizes[type];
+    size_t size = stride * height * 3;
+    csc_frame src;
+    csc_frame_init(&src, src_format, src_buf, width, height);
+
+    csc_tensor dst = { .type = type,
+            .scale = { 1 / 255.0f, 1 / 255.0f, 1 / 255.0f },
+            .bias = { -0.5f, -0.25f, 0.0f } };
+    for (int c = 0; c < 3; ++c) {
+        dst.data[c] = out_buf + stride * height * c;
+        dst.stride[c] = stride;
+    }
+
+    csc_set_simd_level(CSC_SIMD_NONE);
+    memset(out_buf, 0xa5, size);
+    if (fn(NULL, &src, &dst, width, height) != 0) {
+        fprintf(stderr, "%s type %d %ux%u failed\n", name, type, width,
+                height);
+        ++failures;
+        return;
+    }
+    memcpy(ref_buf, out_buf, size);
+
+    for (int level = CSC_SIMD_NONE + 1; level <= max_level; ++level) {
+        csc_set_simd_level(level);
+        memset(out_buf, 0xa5, size);
+        ++checks;
+        if (fn(NULL, &src, &dst, width, height) == 0 &&
+                memcmp(ref_buf, out_buf, size) == 0)
+            continue;
+
+        fprintf(stderr, "%s type %d %ux%u: %s differs from scalar\n", name,
+                type, width, height, level_names[level]);
+        ++failures;
+    }
+}
+
+int main(void) {
+    int max_level = csc_set_simd_level(CSC_SIMD_AVX2);
+    fill_random(src_buf, sizeof(src_buf));
+
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+        for (size_t h = 0; h < sizeof(heights) / sizeof(heights[0]); ++h) {
+            for (int s = 0; s < CSC_FORMAT_COUNT; ++s)
+                for (int d = 0; d < CSC_FORMAT_COUNT; ++d)
+                    for (int v = 0; v < VARIANT_COUNT; ++v)
+                        check_case(s, d, v, widths[w], heights[h],
+                                max_level);
+
+            for (int type = CSC_TENSOR_F32; type <= CSC_TENSOR_S8; ++type) {
+                check_tensor("yuv420sp_to_tensor", yuv420sp_to_tensor,
+                        CSC_FORMAT_NV12, type, widths[w], heights[h],
+                        max_level);
+                check_tensor("yvu420sp_to_tensor", yvu420sp_to_tensor,
+                        CSC_FORMAT_NV21, type, widths[w], heights[h],
+                        max_level);
+                check_tensor("yuv420p_to_tensor", yuv420p_to_tensor,
+                        CSC_FORMAT_I420, type, widths[w], heights[h],
+                        max_level);
+                check_tensor("yvu420p_to_tensor", yvu420p_to_tensor,
+                        CSC_FORMAT_YV12, type, widths[w], heights[h],
+                        max_level);
+            }
+        }
+    }
+
+    csc_set_simd_level(max_level);
+    printf("simd_test: %u checks up to %s, %u failed\n", checks,
+            level_names[max_level], failures);
+
+    return failures == 0 ? 0 : 1;
+}
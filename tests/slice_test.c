@@ -0,0 +1,160 @@
+/*
+ * slice_test.c
+ *
+ * Converting a frame through a csc_slice, its rows pushed a few at a
+ * time, gives the same bytes as converting it whole with the plan, for
+ * every conversion plain, downscaled, resized and on an ROI.
+ */
+
+#include "conv_rgb_yuv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* largest frame tested, the upsized one, 8 bytes a pixel */
+#define BUF_SIZE    (196 * 60 * 8)
+
+/* bytes past the output checked for stray writes */
+#define GUARD_SIZE  64
+
+enum {
+    VARIANT_PLAIN,
+    VARIANT_FACTOR2,
+    VARIANT_FACTOR4,
+    VARIANT_ROI,
+    VARIANT_UPSIZE,
+    VARIANT_DOWNSIZE,
+    VARIANT_COUNT,
+};
+
+static const char *variant_names[VARIANT_COUNT] = {
+    "plain", "factor 2", "factor 4", "roi", "upsize", "downsize",
+};
+
+static const unsigned int widths[] = { 34, 130 };
+static const unsigned int heights[] = { 18, 40 };
+
+/* rows per push, the last pushes whatever is left */
+static const unsigned int pushes[] = { 1, 2, 3, 8, 5, 40 };
+
+static unsigned char src_buf[BUF_SIZE], ref_buf[BUF_SIZE],
+        out_buf[BUF_SIZE];
+
+static unsigned int failures, checks;
+
+static void fill_random(unsigned char *buf, size_t size) {
+    unsigned int x = 2463534242u;
+    for (size_t i = 0; i < size; ++i) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = x;
+    }
+}
+
+/* The plan for variant and the size of its output, NULL if it has none */
+static csc_plan *make_plan(int src_format, int dst_format, int variant,
+        unsigned int width, unsigned int height, csc_rect *roi,
+        unsigned int *out_width, unsigned int *out_height) {
+    csc_opts opts = { 0 };
+    *out_width = width;
+    *out_height = height;
+
+    switch (variant) {
+    case VARIANT_FACTOR2:
+    case VARIANT_FACTOR4:
+        opts.factor = variant == VARIANT_FACTOR2 ? 2 : 4;
+        *out_width = (width / opts.factor) & ~1u;
+        *out_height = (height / opts.factor) & ~1u;
+        break;
+    case VARIANT_ROI:
+        /* an odd top row, packed 4:2:2 needs an even left column */
+        *roi = (csc_rect) { 2, 5, width - 6, height - 8 };
+        opts.roi = roi;
+        *out_width = roi->width;
+        *out_height = roi->height;
+        break;
+    case VARIANT_UPSIZE:
+        opts.out_width = *out_width = width * 3 / 2 & ~1u;
+        opts.out_height = *out_height = height * 3 / 2 & ~1u;
+        break;
+    case VARIANT_DOWNSIZE:
+        opts.out_width = *out_width = (width / 3 + 2) & ~1u;
+        opts.out_height = *out_height = (height / 3 + 2) & ~1u;
+        break;
+    }
+
+    return csc_plan_create(src_format, dst_format, width, height, &opts);
+}
+
+static void check_case(int src_format, int dst_format, int variant,
+        unsigned int width, unsigned int height) {
+    csc_rect roi;
+    unsigned int out_width, out_height;
+    csc_plan *plan = make_plan(src_format, dst_format, variant, width,
+            height, &roi, &out_width, &out_height);
+    if (plan == NULL)
+        return;
+
+    csc_frame src, dst;
+    csc_frame_init(&src, src_format, src_buf, width, height);
+    size_t size = csc_frame_init(&dst, dst_format, out_buf, out_width,
+            out_height) + GUARD_SIZE;
+
+    memset(out_buf, 0xa5, size);
+    if (csc_plan_execute(plan, &src, &dst) != 0) {
+        fprintf(stderr, "%d -> %d %s %ux%u: plan failed\n", src_format,
+                dst_format, variant_names[variant], width, height);
+        ++failures;
+        csc_plan_destroy(plan);
+        return;
+    }
+    memcpy(ref_buf, out_buf, size);
+
+    csc_slice *slice = csc_slice_create(plan);
+    memset(out_buf, 0xa5, size);
+    int done = -1;
+    if (slice != NULL && csc_slice_begin(slice, &src, &dst) == 0) {
+        unsigned int arrived = 0;
+        for (unsigned int i = 0; arrived < height; ++i) {
+            unsigned int rows = pushes[i % (sizeof(pushes) /
+                    sizeof(pushes[0]))];
+            if (rows > height - arrived)
+                rows = height - arrived;
+            done = csc_slice_push(slice, rows);
+            if (done < 0)
+                break;
+            arrived += rows;
+        }
+    }
+
+    ++checks;
+    if (done != (int) out_height || memcmp(ref_buf, out_buf, size) != 0) {
+        size_t at = 0;
+        while (at < size && ref_buf[at] == out_buf[at])
+            ++at;
+        fprintf(stderr, "%d -> %d %s %ux%u: %d rows done, differs from "
+                "the whole frame at byte %zu\n", src_format, dst_format,
+                variant_names[variant], width, height, done, at);
+        ++failures;
+    }
+
+    csc_slice_destroy(slice);
+    csc_plan_destroy(plan);
+}
+
+int main(void) {
+    fill_random(src_buf, sizeof(src_buf));
+
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w)
+        for (size_t h = 0; h < sizeof(heights) / sizeof(heights[0]); ++h)
+            for (int s = 0; s < CSC_FORMAT_COUNT; ++s)
+                for (int d = 0; d < CSC_FORMAT_COUNT; ++d)
+                    for (int v = 0; v < VARIANT_COUNT; ++v)
+                        check_case(s, d, v, widths[w], heights[h]);
+
+    printf("slice_test: %u checks, %u failed\n", checks, failures);
+
+    return failures == 0 ? 0 : 1;
+}
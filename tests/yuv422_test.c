@@ -0,0 +1,160 @@
+/*
+ * yuv422_test.c
+ *
+ * YUYV and UYVY decode to every RGB format within a few steps of the
+ * matrix worked out in floating point, each row with its own chroma, at
+ * each SIMD level the CPU has. Random samples give every row of a pair
+ * different chroma, which averaging over the pair would lose.
+ */
+
+#include "conv_rgb_yuv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_WIDTH   130
+#define HEIGHT      6
+
+/*
+ * the fixed-point tables round their coefficients to 1/256ths, which
+ * costs up to 4 steps at the edges of the gamut
+ */
+#define TOLERANCE   4
+
+static const unsigned int widths[] = { 6, 34, 130 };
+
+/* Kr and Kb of each csc_matrix */
+static const double kr_kb[3][2] = {
+    { 0.299, 0.114 }, { 0.2126, 0.0722 }, { 0.2627, 0.0593 },
+};
+
+/* each RGB format: pixel size, offsets of R, G, B and A (-1 for none) */
+static const struct {
+    int format;
+    const char *name;
+    int bpp, r, g, b, a;
+} rgb_formats[] = {
+    { CSC_FORMAT_RGB24, "RGB24", 3, 0, 1, 2, -1 },
+    { CSC_FORMAT_BGR24, "BGR24", 3, 2, 1, 0, -1 },
+    { CSC_FORMAT_RGBA32, "RGBA32", 4, 0, 1, 2, 3 },
+    { CSC_FORMAT_BGRA32, "BGRA32", 4, 2, 1, 0, 3 },
+    { CSC_FORMAT_ARGB32, "ARGB32", 4, 1, 2, 3, 0 },
+    { CSC_FORMAT_ABGR32, "ABGR32", 4, 3, 2, 1, 0 },
+};
+
+static const char *level_names[] = { "scalar", "sse41", "avx2" };
+
+static unsigned char src_buf[MAX_WIDTH * HEIGHT * 2],
+        out_buf[MAX_WIDTH * HEIGHT * 4];
+
+static unsigned int failures, checks, worst;
+
+static void fill_random(unsigned char *buf, size_t size) {
+    unsigned int x = 2463534242u;
+    for (size_t i = 0; i < size; ++i) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = x;
+    }
+}
+
+static int clip(double value) {
+    return value < 0 ? 0 : value > 255 ? 255 : (int) (value + 0.5);
+}
+
+static void reference_pixel(int matrix, int range, int y, int u, int v,
+        int rgb[3]) {
+    double kr = kr_kb[matrix][0], kb = kr_kb[matrix][1];
+    double kg = 1 - kr - kb;
+    double luma = y, cb = u - 128, cr = v - 128;
+    if (range == CSC_RANGE_LIMITED) {
+        luma = (y - 16) * 255.0 / 219;
+        cb *= 255.0 / 224;
+        cr *= 255.0 / 224;
+    }
+
+    double r = luma + 2 * (1 - kr) * cr;
+    double b = luma + 2 * (1 - kb) * cb;
+    rgb[0] = clip(r);
+    rgb[1] = clip((luma - kr * r - kb * b) / kg);
+    rgb[2] = clip(b);
+}
+
+static void check_case(int src_format, int first, int dst, int matrix,
+        int range, unsigned int width, int level) {
+    int bpp = rgb_formats[dst].bpp;
+    csc_frame src, out;
+    csc_frame_init(&src, src_format, src_buf, width, HEIGHT);
+    csc_frame_init(&out, rgb_formats[dst].format, out_buf, width, HEIGHT);
+    src.matrix = matrix;
+    src.range = range;
+
+    ++checks;
+    memset(out_buf, 0xa5, sizeof(out_buf));
+    if (csc_convert(src_format, rgb_formats[dst].format, &src, &out, width,
+            HEIGHT, NULL) != 0) {
+        fprintf(stderr, "%s -> %s: convert failed\n",
+                first == 0 ? "YUYV" : "UYVY", rgb_formats[dst].name);
+        ++failures;
+        return;
+    }
+
+    int c = 1 - first;
+    for (unsigned int h = 0; h < HEIGHT; ++h) {
+        for (unsigned int x = 0; x < width; ++x) {
+            const unsigned char *s = src_buf + (h * width + x / 2 * 2) * 2;
+            const unsigned char *d = out_buf + (h * width + x) * bpp;
+            int rgb[3];
+            reference_pixel(matrix, range, s[first + x % 2 * 2], s[c],
+                    s[c + 2], rgb);
+
+            unsigned int error = 0;
+            const int at[3] = { rgb_formats[dst].r, rgb_formats[dst].g,
+                    rgb_formats[dst].b };
+            for (int n = 0; n < 3; ++n) {
+                unsigned int e = abs(d[at[n]] - rgb[n]);
+                error = e > error ? e : error;
+            }
+            worst = error > worst ? error : worst;
+            if (error <= TOLERANCE &&
+                    (rgb_formats[dst].a < 0 || d[rgb_formats[dst].a] == 255))
+                continue;
+
+            fprintf(stderr, "%s -> %s %ux%u matrix %d range %d %s: pixel "
+                    "%u,%u is %d,%d,%d, expected %d,%d,%d\n",
+                    first == 0 ? "YUYV" : "UYVY", rgb_formats[dst].name,
+                    width, HEIGHT, matrix, range, level_names[level], x, h,
+                    d[at[0]], d[at[1]], d[at[2]], rgb[0], rgb[1], rgb[2]);
+            ++failures;
+            return;
+        }
+    }
+}
+
+int main(void) {
+    int max_level = csc_set_simd_level(CSC_SIMD_AVX2);
+    fill_random(src_buf, sizeof(src_buf));
+
+    for (int level = CSC_SIMD_NONE; level <= max_level; ++level) {
+        csc_set_simd_level(level);
+        for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w)
+            for (int dst = 0; dst < 6; ++dst)
+                for (int matrix = CSC_MATRIX_BT601;
+                        matrix <= CSC_MATRIX_BT2020; ++matrix)
+                    for (int range = CSC_RANGE_LIMITED;
+                            range <= CSC_RANGE_FULL; ++range) {
+                        check_case(CSC_FORMAT_YUYV, 0, dst, matrix, range,
+                                widths[w], level);
+                        check_case(CSC_FORMAT_UYVY, 1, dst, matrix, range,
+                                widths[w], level);
+                    }
+    }
+
+    csc_set_simd_level(max_level);
+    printf("yuv422_test: %u checks up to %s, %u failed, worst error %u\n",
+            checks, level_names[max_level], failures, worst);
+
+    return failures == 0 ? 0 : 1;
+}